@@ -23,7 +23,7 @@ extern "C" {
 #endif
 #endif
 
-#define CENV_VERSION 1
+#define CENV_VERSION 2
 
 // Poissible value types
 typedef enum {
@@ -118,19 +118,36 @@ typedef struct {
     cenv_value_buffer value_buffer; // Size height * width * channels, addressed like: channel_index + channels * (x + width * y)
 } cenv_render_data;
 
-// C ENV DEVELOPERS: USE THESE IN YOUR ENV!
-CENV_API extern cenv_make_data make_data;
-CENV_API extern cenv_reset_data reset_data;
-CENV_API extern cenv_step_data step_data;
-CENV_API extern cenv_render_data render_data;
+// Opaque environment instance. Each environment defines its own struct cenv_context, so that many independent instances can live in one process
+typedef struct cenv_context cenv_context;
 
 // C ENV DEVELOPERS: IMPLEMENT THESE IN YOUR ENV!
 CENV_API int32_t cenv_get_env_version(); // Version of environment
-CENV_API int32_t cenv_make(const char* render_mode, cenv_option* options, int32_t options_size); // Make the environment
-CENV_API int32_t cenv_reset(cenv_option* options, int32_t options_size); // Reset the environment
-CENV_API int32_t cenv_step(cenv_key_value* actions, int32_t actions_size); // Step (update) the environment
-CENV_API int32_t cenv_render(); // Render the environment to a frame
-CENV_API void cenv_close(); // Close (delete) the environment (shutdown)
+CENV_API cenv_context* cenv_make(const char* render_mode, cenv_option* options, int32_t options_size); // Make an environment instance, NULL on error
+CENV_API cenv_make_data* cenv_get_make_data(cenv_context* context); // Data for the instance, valid until cenv_close
+CENV_API cenv_reset_data* cenv_get_reset_data(cenv_context* context);
+CENV_API cenv_step_data* cenv_get_step_data(cenv_context* context);
+CENV_API cenv_render_data* cenv_get_render_data(cenv_context* context);
+CENV_API int32_t cenv_reset(cenv_context* context, cenv_option* options, int32_t options_size); // Reset the environment
+CENV_API int32_t cenv_step(cenv_context* context, cenv_key_value* actions, int32_t actions_size); // Step (update) the environment
+CENV_API int32_t cenv_render(cenv_context* context); // Render the environment to a frame
+CENV_API void cenv_close(cenv_context* context); // Close (delete) the environment instance. With the batched interface, first waits for a started cenv_step_async batch it is in (whose result is then lost)
+
+// OPTIONAL: batched interface (used by CEnvVector) for environments with a single discrete action and a single byte observation.
+// All buffers are caller-owned and hold num_envs entries, observations as num_envs consecutive observation buffers.
+CENV_API int32_t cenv_reset_batch(cenv_context** contexts, int32_t num_envs, int32_t* seeds, uint8_t* observations); // Reset all environments, seeds may be NULL. Returns 3 if an environment failed
+CENV_API int32_t cenv_step_batch(cenv_context** contexts, int32_t num_envs, int32_t* actions, uint8_t* observations, float* rewards, bool* terminated, bool* truncated, uint8_t* final_observations); // Step all environments, auto-resetting finished ones. Their last observations go to final_observations (at their index) unless it is NULL. Returns 3 if an environment failed (the others are still stepped)
+CENV_API int32_t cenv_step_async(cenv_context** contexts, int32_t num_envs, int32_t* actions, uint8_t* observations, float* rewards, bool* terminated, bool* truncated, uint8_t* final_observations); // Start cenv_step_batch on the library's background thread, the buffers (and the contexts array) belong to the library until cenv_step_wait. num_envs must be > 0, and none of the contexts may be in another started step
+CENV_API int32_t cenv_step_wait(cenv_context** contexts); // Wait for the step started by cenv_step_async with the same contexts, returns its error code
+CENV_API int32_t cenv_set_threads(int32_t num_threads, bool pin_threads); // Threads (including the caller) the batched calls spread environments over, <= 0 for one per core. Optionally pins them to cores. Returns 1 if batched calls are using a pool set up differently
+
+// OPTIONAL: state snapshots, for restoring an environment to an earlier point (e.g. tree search). A state can only be loaded into the instance that saved it
+CENV_API int32_t cenv_get_state_size(cenv_context* context); // Buffer size that any saved state of the instance fits in, fixed for the instance
+CENV_API int32_t cenv_save_state(cenv_context* context, uint8_t* buffer, int32_t buffer_size); // Save the full state, returns the number of bytes written, negative on error
+CENV_API int32_t cenv_load_state(cenv_context* context, const uint8_t* buffer, int32_t buffer_size); // Restore a saved state, returns 0 on success
+
+// OPTIONAL: copy the full state of one instance into another of the same library (made with the same options) directly, faster than saving and loading
+CENV_API int32_t cenv_clone(cenv_context* src, cenv_context* dst); // Returns 0 on success, dst is left unchanged on error
 
 #ifdef __cplusplus
 }
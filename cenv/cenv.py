@@ -1,5 +1,7 @@
 import gymnasium as gym
 from gymnasium import Env
+from gymnasium.vector import VectorEnv, AutoresetMode
+from gymnasium.vector.utils import batch_space
 import collections
 import copy
 import sys
@@ -131,6 +133,21 @@ def _make_nd_array(c_pointer, shape, dtype=np.float32, order='C', own_data=True)
 
     return arr
 
+# Arrays for an array of key-values, by key. Without owning data they are views that follow the C buffers
+def _make_key_value_dict(c_key_values, size, own_data=True):
+    key_values = {}
+
+    for i in range(size):
+        value_type = int(c_key_values[i].value_type)
+        value_buffer_size = int(c_key_values[i].value_buffer_size)
+        c_buffer_p = c_key_values[i].value_buffer.b
+
+        arr = _make_nd_array(c_buffer_p, (value_buffer_size,), dtype=CENV_VALUE_TYPE_TO_NUMPY_DTYPE[value_type], own_data=own_data)
+
+        key_values[c_key_values[i].key.decode()] = arr
+
+    return key_values
+
 def _put_value_buffer(arr):
     type_index = CENV_NUMPY_DTYPE_TO_VALUE_TYPE[arr.dtype]
 
@@ -152,7 +169,9 @@ def _put_value_buffer(arr):
 class CEnv(Env):
     metadata = {"render_modes": ["human", "single_rgb_array"]}
 
-    def __init__(self, lib_file_path: str, render_mode: Optional[str] = None, options: Optional[Dict[str, Any]] = None):
+    # With zero_copy, observations and infos are views onto the library's buffers, created once here.
+    # They are overwritten by the next step/reset, and rely on the library re-using its buffers (as all procgen2 games do)
+    def __init__(self, lib_file_path: str, render_mode: Optional[str] = None, options: Optional[Dict[str, Any]] = None, zero_copy: bool = False):
         # Load library
         self.lib = CDLL(lib_file_path)
 
@@ -161,27 +180,48 @@ class CEnv(Env):
         self.lib.cenv_get_env_version.restype = c_int32
 
         self.lib.cenv_make.argtypes = [c_char_p, POINTER(CEnv_Option), c_int32]
-        self.lib.cenv_make.restype = c_int32
+        self.lib.cenv_make.restype = c_void_p
+
+        self.lib.cenv_get_make_data.argtypes = [c_void_p]
+        self.lib.cenv_get_make_data.restype = POINTER(CEnv_Make_Data)
+
+        self.lib.cenv_get_reset_data.argtypes = [c_void_p]
+        self.lib.cenv_get_reset_data.restype = POINTER(CEnv_Reset_Data)
+
+        self.lib.cenv_get_step_data.argtypes = [c_void_p]
+        self.lib.cenv_get_step_data.restype = POINTER(CEnv_Step_Data)
 
-        self.lib.cenv_reset.argtypes = [POINTER(CEnv_Option), c_int32]
+        self.lib.cenv_get_render_data.argtypes = [c_void_p]
+        self.lib.cenv_get_render_data.restype = POINTER(CEnv_Render_Data)
+
+        self.lib.cenv_reset.argtypes = [c_void_p, POINTER(CEnv_Option), c_int32]
         self.lib.cenv_reset.restype = c_int32
 
-        self.lib.cenv_step.argtypes = [POINTER(CEnv_Key_Value), c_int32]
+        self.lib.cenv_step.argtypes = [c_void_p, POINTER(CEnv_Key_Value), c_int32]
         self.lib.cenv_step.restype = c_int32
 
-        self.lib.cenv_render.argtypes = []
+        self.lib.cenv_render.argtypes = [c_void_p]
         self.lib.cenv_render.restype = c_int32
 
-        self.lib.cenv_close.argtypes = []
+        self.lib.cenv_close.argtypes = [c_void_p]
         self.lib.cenv_close.restype = None
 
-        # Get pointers to globals
-        self.c_make_data = CEnv_Make_Data.in_dll(self.lib, "make_data")
-        self.c_reset_data = CEnv_Reset_Data.in_dll(self.lib, "reset_data")
-        self.c_step_data = CEnv_Step_Data.in_dll(self.lib, "step_data")
-        self.c_render_data = CEnv_Render_Data.in_dll(self.lib, "render_data")
+        # Optional state snapshots
+        if hasattr(self.lib, "cenv_save_state"):
+            self.lib.cenv_get_state_size.argtypes = [c_void_p]
+            self.lib.cenv_get_state_size.restype = c_int32
+
+            self.lib.cenv_save_state.argtypes = [c_void_p, c_void_p, c_int32]
+            self.lib.cenv_save_state.restype = c_int32
+
+            self.lib.cenv_load_state.argtypes = [c_void_p, c_void_p, c_int32]
+            self.lib.cenv_load_state.restype = c_int32
+
+            self.c_state_buffer = None
 
-        ret = 0
+        if hasattr(self.lib, "cenv_clone"):
+            self.lib.cenv_clone.argtypes = [c_void_p, c_void_p]
+            self.lib.cenv_clone.restype = c_int32
 
         c_options = None
         num_options = 0
@@ -203,10 +243,16 @@ class CEnv(Env):
 
                 i += 1
 
-        ret = self.lib.cenv_make(bytes("" if render_mode == None else render_mode, "ascii"), c_options, c_int32(num_options))
+        self.ctx = self.lib.cenv_make(bytes("" if render_mode == None else render_mode, "ascii"), c_options, c_int32(num_options))
 
-        if ret != 0:
-            raise(Exception("Non-zero error code!"))
+        if self.ctx == None:
+            raise(Exception("Could not make environment!"))
+
+        # Get pointers to the data of this instance
+        self.c_make_data = self.lib.cenv_get_make_data(self.ctx).contents
+        self.c_reset_data = self.lib.cenv_get_reset_data(self.ctx).contents
+        self.c_step_data = self.lib.cenv_get_step_data(self.ctx).contents
+        self.c_render_data = self.lib.cenv_get_render_data(self.ctx).contents
 
         self.observation_space = {}
 
@@ -244,7 +290,35 @@ class CEnv(Env):
 
             self.action_space[self.c_make_data.action_spaces[i].key.decode()] = space
 
+        self.zero_copy = zero_copy
+
+        if zero_copy:
+            self.reset_observation = _make_key_value_dict(self.c_reset_data.observations, self.c_reset_data.observations_size, own_data=False)
+            self.reset_info = _make_key_value_dict(self.c_reset_data.infos, self.c_reset_data.infos_size, own_data=False)
+            self.step_observation = _make_key_value_dict(self.c_step_data.observations, self.c_step_data.observations_size, own_data=False)
+            self.step_info = _make_key_value_dict(self.c_step_data.infos, self.c_step_data.infos_size, own_data=False)
+
+            # Re-used action for int actions
+            self.c_action = c_int32(0)
+
+            c_value_buffer = CEnv_Value_Buffer()
+            c_value_buffer.i = pointer(self.c_action)
+
+            self.c_action_key_value = CEnv_Key_Value(b"action", c_int32(CENV_VALUE_TYPE_INT), c_int32(1), c_value_buffer)
+
     def step(self, action: gym.core.ActType) -> Tuple[gym.core.ObsType, float, bool, bool, dict]:
+        if self.zero_copy and type(action) is int:
+            self.c_action.value = action
+
+            ret = self.lib.cenv_step(self.ctx, pointer(self.c_action_key_value), 1)
+
+            if ret != 0:
+                raise(Exception("Non-zero error code!"))
+
+            c_step_data = self.c_step_data
+
+            return (self.step_observation, c_step_data.reward.f, c_step_data.terminated, c_step_data.truncated, self.step_info)
+
         c_actions = None
         num_actions = 1
 
@@ -280,33 +354,17 @@ class CEnv(Env):
         else:
             raise(Exception("Unrecognized action type! Supported are: int, np.array, Dict[np.array]"))
             
-        ret = self.lib.cenv_step(c_actions, c_int32(num_actions))
+        ret = self.lib.cenv_step(self.ctx, c_actions, c_int32(num_actions))
 
         if ret != 0:
             raise(Exception("Non-zero error code!"))
 
-        # Create observation
-        observation = {}
-
-        for i in range(self.c_step_data.observations_size):
-            value_type = int(self.c_step_data.observations[i].value_type)
-            value_buffer_size = int(self.c_step_data.observations[i].value_buffer_size)
-            c_buffer_p = self.c_step_data.observations[i].value_buffer.b
-
-            arr = _make_nd_array(c_buffer_p, (value_buffer_size,), dtype=CENV_VALUE_TYPE_TO_NUMPY_DTYPE[value_type])
-
-            observation[self.c_step_data.observations[i].key.decode()] = arr
-        
-        info = {}
-
-        for i in range(self.c_step_data.infos_size):
-            value_type = int(self.c_step_data.infos[i].value_type)
-            value_buffer_size = int(self.c_step_data.infos[i].value_buffer_size)
-            c_buffer_p = self.c_step_data.infos[i].value_buffer.b
-
-            arr = _make_nd_array(c_buffer_p, (value_buffer_size,), dtype=CENV_VALUE_TYPE_TO_NUMPY_DTYPE[value_type])
-
-            info[self.c_step_data.infos[i].key.decode()] = arr
+        if self.zero_copy:
+            observation = self.step_observation
+            info = self.step_info
+        else:
+            observation = _make_key_value_dict(self.c_step_data.observations, self.c_step_data.observations_size)
+            info = _make_key_value_dict(self.c_step_data.infos, self.c_step_data.infos_size)
 
         reward = float(self.c_step_data.reward.f)
         terminated = bool(self.c_step_data.terminated)
@@ -335,38 +393,21 @@ class CEnv(Env):
 
                 i += 1
 
-        ret = self.lib.cenv_reset(c_options, c_int32(num_options))
+        ret = self.lib.cenv_reset(self.ctx, c_options, c_int32(num_options))
         
         if ret != 0:
             raise(Exception("Non-zero error code!"))
 
-        # Create observation
-        observation = {}
-
-        for i in range(self.c_reset_data.observations_size):
-            value_type = int(self.c_reset_data.observations[i].value_type)
-            value_buffer_size = int(self.c_reset_data.observations[i].value_buffer_size)
-            c_buffer_p = self.c_reset_data.observations[i].value_buffer.b
-
-            arr = _make_nd_array(c_buffer_p, (value_buffer_size,), dtype=CENV_VALUE_TYPE_TO_NUMPY_DTYPE[value_type])
-
-            observation[self.c_reset_data.observations[i].key.decode()] = arr
-        
-        info = {}
-
-        for i in range(self.c_reset_data.infos_size):
-            value_type = int(self.c_reset_data.infos[i].value_type)
-            value_buffer_size = int(self.c_reset_data.infos[i].value_buffer_size)
-            c_buffer_p = self.c_reset_data.infos[i].value_buffer.b
-
-            arr = _make_nd_array(c_buffer_p, (value_buffer_size,), dtype=CENV_VALUE_TYPE_TO_NUMPY_DTYPE[value_type])
+        if self.zero_copy:
+            return (self.reset_observation, self.reset_info)
 
-            info[self.c_reset_data.infos[i].key.decode()] = arr
+        observation = _make_key_value_dict(self.c_reset_data.observations, self.c_reset_data.observations_size)
+        info = _make_key_value_dict(self.c_reset_data.infos, self.c_reset_data.infos_size)
 
         return (observation, info)
 
     def render(self) -> gym.core.RenderFrame:
-        self.lib.cenv_render()
+        self.lib.cenv_render(self.ctx)
 
         value_type = self.c_render_data.value_type
         value_buffer_size = self.c_render_data.value_buffer_height * self.c_render_data.value_buffer_width * self.c_render_data.value_buffer_channels
@@ -376,5 +417,209 @@ class CEnv(Env):
 
         return arr.reshape(self.c_render_data.value_buffer_height, self.c_render_data.value_buffer_width, self.c_render_data.value_buffer_channels)
 
+    # Saves the full state of the environment, can only be loaded back into this instance
+    def save_state(self) -> bytes:
+        if self.c_state_buffer == None:
+            self.c_state_buffer = (c_uint8 * self.lib.cenv_get_state_size(self.ctx))()
+
+        size = self.lib.cenv_save_state(self.ctx, self.c_state_buffer, c_int32(len(self.c_state_buffer)))
+
+        if size < 0:
+            raise(Exception("Could not save state!"))
+
+        return bytes(self.c_state_buffer[:size])
+
+    def load_state(self, state: bytes):
+        if self.lib.cenv_load_state(self.ctx, state, c_int32(len(state))) != 0:
+            raise(Exception("Could not load state!"))
+
+    # Copies the full state of other (an environment of the same library made with the same options) into this one
+    def clone_from(self, other: "CEnv"):
+        if self.lib.cenv_clone(other.ctx, self.ctx) != 0:
+            raise(Exception("Could not clone environment!"))
+
     def close(self):
-        self.lib.cenv_close()
+        if self.ctx != None:
+            self.lib.cenv_close(self.ctx)
+
+            self.ctx = None
+
+# Buffers the library fills in a batched step
+class CEnv_Batch_Buffers:
+    def __init__(self, num_envs: int, obs_shape: Tuple[int, ...]):
+        self.actions = np.zeros(num_envs, dtype=np.int32)
+        self.observations = np.zeros((num_envs,) + tuple(obs_shape), dtype=np.uint8)
+        self.rewards = np.zeros(num_envs, dtype=np.float32)
+        self.terminated = np.zeros(num_envs, dtype=np.bool_)
+        self.truncated = np.zeros(num_envs, dtype=np.bool_)
+        self.final_observations = np.zeros((num_envs,) + tuple(obs_shape), dtype=np.uint8) # Of the environments that finished (and were reset)
+
+        self.c_actions = self.actions.ctypes.data_as(POINTER(c_int32))
+        self.c_observations = self.observations.ctypes.data_as(POINTER(c_uint8))
+        self.c_rewards = self.rewards.ctypes.data_as(POINTER(c_float))
+        self.c_terminated = self.terminated.ctypes.data_as(POINTER(c_bool))
+        self.c_truncated = self.truncated.ctypes.data_as(POINTER(c_bool))
+        self.c_final_observations = self.final_observations.ctypes.data_as(POINTER(c_uint8))
+
+class CEnvVector(VectorEnv):
+    metadata = {"render_modes": ["human", "single_rgb_array"], "autoreset_mode": AutoresetMode.SAME_STEP}
+
+    def __init__(self, lib_file_path: str, num_envs: int, render_mode: Optional[str] = None, options: Optional[Dict[str, Any]] = None, obs_shape: Tuple[int, ...] = (64, 64, 3), num_threads: Optional[int] = None, pin_threads: bool = False, zero_copy: bool = False):
+        if num_envs <= 0:
+            raise(Exception("A vector environment needs at least one environment!"))
+
+        # One instance per environment, all from the same library
+        self.envs = [CEnv(lib_file_path, render_mode, options) for _ in range(num_envs)]
+
+        self.lib = self.envs[0].lib
+
+        self.lib.cenv_reset_batch.argtypes = [POINTER(c_void_p), c_int32, POINTER(c_int32), POINTER(c_uint8)]
+        self.lib.cenv_reset_batch.restype = c_int32
+
+        self.lib.cenv_step_batch.argtypes = [POINTER(c_void_p), c_int32, POINTER(c_int32), POINTER(c_uint8), POINTER(c_float), POINTER(c_bool), POINTER(c_bool), POINTER(c_uint8)]
+        self.lib.cenv_step_batch.restype = c_int32
+
+        self.lib.cenv_step_async.argtypes = [POINTER(c_void_p), c_int32, POINTER(c_int32), POINTER(c_uint8), POINTER(c_float), POINTER(c_bool), POINTER(c_bool), POINTER(c_uint8)]
+        self.lib.cenv_step_async.restype = c_int32
+
+        self.lib.cenv_step_wait.argtypes = [POINTER(c_void_p)]
+        self.lib.cenv_step_wait.restype = c_int32
+
+        self.lib.cenv_set_threads.argtypes = [c_int32, c_bool]
+        self.lib.cenv_set_threads.restype = c_int32
+
+        # The thread pool is shared by all vector environments using this library. Without num_threads it is left as it is (single-threaded
+        # unless set up otherwise), 0 threads = one per core. It is only replaced if set up differently, which fails while another vector
+        # environment is stepping. Calls through CDLL release the GIL, so the whole batch runs without it
+        if num_threads is not None:
+            ret = self.lib.cenv_set_threads(c_int32(num_threads), c_bool(pin_threads))
+
+            if ret != 0:
+                raise(Exception("Could not change the thread pool while another vector environment is stepping!"))
+
+        self.c_contexts = (c_void_p * num_envs)(*[env.ctx for env in self.envs])
+
+        if self.envs[0].c_reset_data.observations[0].value_buffer_size != np.prod(obs_shape):
+            raise(Exception("Observation shape does not match the environment's observation size!"))
+
+        self.num_envs = num_envs
+        self.render_mode = render_mode
+
+        self.single_observation_space = gym.spaces.Box(0, 255, obs_shape, dtype=np.uint8)
+        self.single_action_space = gym.spaces.Discrete(int(self.envs[0].c_make_data.action_spaces[0].value_buffer.i[0]))
+
+        self.observation_space = batch_space(self.single_observation_space, num_envs)
+        self.action_space = batch_space(self.single_action_space, num_envs)
+
+        # Two sets of buffers filled by the library, allocated once and re-used. While the library steps into one,
+        # the results of the previous step stay valid in the other
+        self.buffers = [CEnv_Batch_Buffers(num_envs, obs_shape) for _ in range(2)]
+        self.buffer_index = 0
+
+        self.stepping = False
+
+        # Return the buffers themselves from step and reset (valid until the step after next) instead of copies
+        self.zero_copy = zero_copy
+
+    def reset(self, seed: Optional[Any] = None, options: Optional[Dict[str, Any]] = None) -> Tuple[gym.core.ObsType, dict]:
+        c_seeds = None
+
+        if seed != None:
+            if type(seed) is int:
+                seed = [seed + i for i in range(self.num_envs)]
+
+            seeds = np.ascontiguousarray(seed, dtype=np.int32)
+
+            c_seeds = seeds.ctypes.data_as(POINTER(c_int32))
+
+        if self.stepping:
+            self.step_wait()
+
+        buffers = self.buffers[self.buffer_index]
+
+        ret = self.lib.cenv_reset_batch(self.c_contexts, c_int32(self.num_envs), c_seeds, buffers.c_observations)
+
+        if ret != 0:
+            raise(Exception("Non-zero error code!"))
+
+        if self.zero_copy:
+            return (buffers.observations, {})
+
+        return (buffers.observations.copy(), {})
+
+    def step(self, actions: gym.core.ActType) -> Tuple[gym.core.ObsType, np.ndarray, np.ndarray, np.ndarray, dict]:
+        if self.stepping:
+            raise(Exception("Previous step_async was not waited for!"))
+
+        buffers = self.next_buffers(actions)
+
+        ret = self.lib.cenv_step_batch(self.c_contexts, c_int32(self.num_envs), buffers.c_actions, buffers.c_observations, buffers.c_rewards, buffers.c_terminated, buffers.c_truncated, buffers.c_final_observations)
+
+        if ret != 0:
+            raise(Exception("Non-zero error code!"))
+
+        info = self.get_final_info(buffers)
+
+        if self.zero_copy:
+            return (buffers.observations, buffers.rewards, buffers.terminated, buffers.truncated, info)
+
+        return (buffers.observations.copy(), buffers.rewards.copy(), buffers.terminated.copy(), buffers.truncated.copy(), info)
+
+    # Start stepping into the other set of buffers, returns immediately
+    def step_async(self, actions: gym.core.ActType):
+        if self.stepping:
+            raise(Exception("Previous step_async was not waited for!"))
+
+        buffers = self.next_buffers(actions)
+
+        ret = self.lib.cenv_step_async(self.c_contexts, c_int32(self.num_envs), buffers.c_actions, buffers.c_observations, buffers.c_rewards, buffers.c_terminated, buffers.c_truncated, buffers.c_final_observations)
+
+        if ret != 0:
+            raise(Exception("Non-zero error code!"))
+
+        self.stepping = True
+
+    # Switch to the other set of buffers for the next step, holding the actions
+    def next_buffers(self, actions: gym.core.ActType) -> CEnv_Batch_Buffers:
+        self.buffer_index = 1 - self.buffer_index
+
+        buffers = self.buffers[self.buffer_index]
+
+        buffers.actions[:] = actions
+
+        return buffers
+
+    # Wait for step_async. The returned arrays are the library's buffers (no copy) and stay valid until the step_wait after next
+    def step_wait(self) -> Tuple[gym.core.ObsType, np.ndarray, np.ndarray, np.ndarray, dict]:
+        if not self.stepping:
+            raise(Exception("No step_async to wait for!"))
+
+        self.stepping = False
+
+        ret = self.lib.cenv_step_wait(self.c_contexts)
+
+        if ret != 0:
+            raise(Exception("Non-zero error code!"))
+
+        buffers = self.buffers[self.buffer_index]
+
+        return (buffers.observations, buffers.rewards, buffers.terminated, buffers.truncated, self.get_final_info(buffers))
+
+    # Finished environments were reset within the step (same-step autoreset), their last observations go into the info as gymnasium expects
+    def get_final_info(self, buffers: CEnv_Batch_Buffers) -> dict:
+        info = {}
+
+        for i in np.flatnonzero(np.logical_or(buffers.terminated, buffers.truncated)):
+            info = self._add_info(info, {"final_obs": buffers.final_observations[i].copy(), "final_info": {}}, i)
+
+        return info
+
+    def render(self) -> Tuple[gym.core.RenderFrame, ...]:
+        return tuple(env.render() for env in self.envs)
+
+    def close_extras(self, **kwargs: Any):
+        if self.stepping:
+            self.step_wait()
+
+        for env in self.envs:
+            env.close()
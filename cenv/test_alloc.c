@@ -0,0 +1,133 @@
+// Checks that stepping an environment doesn't allocate once warmed up.
+// Usage: test_alloc <library> [steps]
+// Counts calls to malloc and friends (C++ new goes through malloc) while cenv_step runs, by overriding them with glibc's implementations.
+// Resets are not counted, level generation may allocate
+
+#include "cenv.h"
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* pointer, size_t size);
+extern void* __libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void* pointer);
+
+static int counting = 0;
+static long num_allocations = 0;
+
+void* malloc(size_t size) {
+    num_allocations += counting;
+
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    num_allocations += counting;
+
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size) {
+    num_allocations += counting;
+
+    return __libc_realloc(pointer, size);
+}
+
+void* memalign(size_t alignment, size_t size) {
+    num_allocations += counting;
+
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** pointer, size_t alignment, size_t size) {
+    num_allocations += counting;
+
+    *pointer = __libc_memalign(alignment, size);
+
+    return *pointer == NULL;
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    num_allocations += counting;
+
+    return __libc_memalign(alignment, size);
+}
+
+void free(void* pointer) {
+    __libc_free(pointer);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("Usage: test_alloc <library> [steps]\n");
+
+        return 2;
+    }
+
+    int num_steps = argc > 2 ? atoi(argv[2]) : 2000;
+
+    void* lib = dlopen(argv[1], RTLD_NOW);
+
+    if (lib == NULL) {
+        printf("%s\n", dlerror());
+
+        return 2;
+    }
+
+    cenv_context* (*make)(const char*, cenv_option*, int32_t) = dlsym(lib, "cenv_make");
+    int32_t (*reset)(cenv_context*, cenv_option*, int32_t) = dlsym(lib, "cenv_reset");
+    int32_t (*step)(cenv_context*, cenv_key_value*, int32_t) = dlsym(lib, "cenv_step");
+    cenv_step_data* (*get_step_data)(cenv_context*) = dlsym(lib, "cenv_get_step_data");
+    void (*close_env)(cenv_context*) = dlsym(lib, "cenv_close");
+
+    cenv_option seed = { "seed", CENV_VALUE_TYPE_INT, { .i = 1 } };
+
+    cenv_context* ctx = make("", &seed, 1);
+
+    if (ctx == NULL) {
+        printf("Could not make the environment!\n");
+
+        return 2;
+    }
+
+    int action = 0;
+    cenv_key_value actions = { "action", CENV_VALUE_TYPE_INT, 1, { .i = &action } };
+
+    long step_allocations = 0;
+
+    // Play the same episodes twice and count the second time, so that every sprite size (mip) and buffer capacity was already needed once
+    for (int pass = 0; pass < 2; pass++) {
+        seed.value.i = 1;
+
+        reset(ctx, &seed, 1);
+
+        for (int t = 0; t < num_steps; t++) {
+            action = (t * 7 + t / 5) % 9; // Moves around in all directions
+
+            long before = num_allocations;
+
+            counting = pass == 1;
+
+            step(ctx, &actions, 1);
+
+            counting = 0;
+
+            step_allocations += num_allocations - before;
+
+            if (get_step_data(ctx)->terminated || get_step_data(ctx)->truncated) {
+                seed.value.i++;
+
+                reset(ctx, &seed, 1);
+            }
+        }
+    }
+
+    close_env(ctx);
+
+    printf("%ld allocations in %d steps\n", step_allocations, num_steps);
+
+    return step_allocations != 0;
+}
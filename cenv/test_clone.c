@@ -0,0 +1,144 @@
+// Checks that a clone steps like the instance it was cloned from.
+// Usage: test_clone <library>
+// Clones mid-episode into an instance that was playing another level, then compares the observations right after cloning and steps both
+// with the same actions, comparing observations, rewards and episode ends byte for byte
+
+#include "cenv.h"
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int32_t (*reset)(cenv_context*, cenv_option*, int32_t);
+static int32_t (*step)(cenv_context*, cenv_key_value*, int32_t);
+static cenv_step_data* (*get_step_data)(cenv_context*);
+
+static int action = 0;
+static cenv_key_value actions = { "action", CENV_VALUE_TYPE_INT, 1, { .i = &action } };
+
+static void step_action(cenv_context* ctx, int t) {
+    action = (t * 7 + t / 5) % 9; // Moves around in all directions
+
+    step(ctx, &actions, 1);
+
+    if (get_step_data(ctx)->terminated || get_step_data(ctx)->truncated)
+        reset(ctx, NULL, 0); // Continues the rng of the state
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("Usage: test_clone <library>\n");
+
+        return 2;
+    }
+
+    void* lib = dlopen(argv[1], RTLD_NOW);
+
+    if (lib == NULL) {
+        printf("%s\n", dlerror());
+
+        return 2;
+    }
+
+    cenv_context* (*make)(const char*, cenv_option*, int32_t) = dlsym(lib, "cenv_make");
+    void (*close_env)(cenv_context*) = dlsym(lib, "cenv_close");
+    int32_t (*clone)(cenv_context*, cenv_context*) = dlsym(lib, "cenv_clone");
+
+    reset = dlsym(lib, "cenv_reset");
+    step = dlsym(lib, "cenv_step");
+    get_step_data = dlsym(lib, "cenv_get_step_data");
+
+    if (clone == NULL) {
+        printf("The library has no cloning!\n");
+
+        return 2;
+    }
+
+    cenv_option seeds[2] = {
+        { "seed", CENV_VALUE_TYPE_INT, { .i = 1 } },
+        { "seed", CENV_VALUE_TYPE_INT, { .i = 2 } }
+    };
+
+    cenv_context* src = make("", &seeds[0], 1);
+    cenv_context* dst = make("", &seeds[1], 1);
+
+    if (src == NULL || dst == NULL) {
+        printf("Could not make the environments!\n");
+
+        return 2;
+    }
+
+    reset(src, &seeds[0], 1);
+    reset(dst, &seeds[1], 1);
+
+    const int num_rounds = 6;
+    const int num_compared_steps = 150; // Long enough to cross episode ends
+
+    cenv_step_data* src_data = get_step_data(src);
+    cenv_step_data* dst_data = get_step_data(dst);
+
+    int observation_size = src_data->observations[0].value_buffer_size;
+
+    int num_failures = 0;
+    int t = 0;
+
+    for (int round = 0; round < num_rounds; round++) {
+        // Move both somewhere else, so that the clone has to overwrite a different episode
+        for (int i = 0; i < 50 + round * 37; i++, t++) {
+            step_action(src, t);
+            step_action(dst, t + 1000);
+        }
+
+        if (clone(src, dst) != 0) {
+            printf("Round %d: could not clone!\n", round);
+
+            return 1;
+        }
+
+        if (memcmp(src_data->observations[0].value_buffer.b, dst_data->observations[0].value_buffer.b, observation_size) != 0) {
+            printf("Round %d: the clone's observation differs from the source's!\n", round);
+            num_failures++;
+        }
+
+        int mismatch_step = -1;
+
+        for (int i = 0; i < num_compared_steps && mismatch_step == -1; i++, t++) {
+            // Compare before the auto-reset of step_action, the step data holds the last observation of an episode
+            action = (t * 7 + t / 5) % 9;
+
+            step(src, &actions, 1);
+            step(dst, &actions, 1);
+
+            if (memcmp(src_data->observations[0].value_buffer.b, dst_data->observations[0].value_buffer.b, observation_size) != 0 ||
+                memcmp(&src_data->reward, &dst_data->reward, sizeof(cenv_value)) != 0 ||
+                src_data->terminated != dst_data->terminated || src_data->truncated != dst_data->truncated)
+                mismatch_step = i;
+
+            if (src_data->terminated || src_data->truncated)
+                reset(src, NULL, 0);
+
+            if (dst_data->terminated || dst_data->truncated)
+                reset(dst, NULL, 0);
+        }
+
+        if (mismatch_step != -1) {
+            printf("Round %d: the clone differs %d steps after cloning!\n", round, mismatch_step);
+            num_failures++;
+        }
+    }
+
+    // The clone doesn't depend on the source once made
+    clone(src, dst);
+
+    close_env(src);
+
+    for (int i = 0; i < num_compared_steps; i++, t++)
+        step_action(dst, t);
+
+    close_env(dst);
+
+    printf("%d rounds of %d steps, %d failures\n", num_rounds, num_compared_steps, num_failures);
+
+    return num_failures != 0;
+}
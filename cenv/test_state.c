@@ -0,0 +1,194 @@
+// Checks that loading a saved state replays the same steps.
+// Usage: test_state <library>
+// Saves mid-episode, steps, loads and steps again with the same actions, comparing observations and rewards byte for byte.
+// Also checks that loading restores the observation (with and without frame stacking), and that a corrupted state is rejected and
+// leaves a freshly reset (and rendered) instance behind
+
+#include "cenv.h"
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static cenv_context* (*make)(const char*, cenv_option*, int32_t);
+static int32_t (*reset)(cenv_context*, cenv_option*, int32_t);
+static int32_t (*step)(cenv_context*, cenv_key_value*, int32_t);
+static cenv_step_data* (*get_step_data)(cenv_context*);
+static void (*close_env)(cenv_context*);
+static int32_t (*get_state_size)(cenv_context*);
+static int32_t (*save_state)(cenv_context*, uint8_t*, int32_t);
+static int32_t (*load_state)(cenv_context*, const uint8_t*, int32_t);
+
+// Steps from time t, recording the observation and reward of each step if the buffers aren't NULL
+static void run(cenv_context* ctx, int t, int num_steps, uint8_t* observations, float* rewards) {
+    int action = 0;
+    cenv_key_value actions = { "action", CENV_VALUE_TYPE_INT, 1, { .i = &action } };
+
+    cenv_step_data* step_data = get_step_data(ctx);
+
+    for (int i = 0; i < num_steps; i++) {
+        action = ((t + i) * 7 + (t + i) / 5) % 9; // Moves around in all directions
+
+        step(ctx, &actions, 1);
+
+        int observation_size = step_data->observations[0].value_buffer_size;
+
+        if (observations != NULL)
+            memcpy(observations + i * observation_size, step_data->observations[0].value_buffer.b, observation_size);
+
+        if (rewards != NULL)
+            rewards[i] = step_data->reward.f;
+
+        if (step_data->terminated || step_data->truncated)
+            reset(ctx, NULL, 0); // Continues the rng of the state
+    }
+}
+
+// Returns the number of failures
+static int test_instance(int frame_stack) {
+    cenv_option options[2] = {
+        { "seed", CENV_VALUE_TYPE_INT, { .i = 1 } },
+        { "frame_stack", CENV_VALUE_TYPE_INT, { .i = frame_stack } }
+    };
+
+    cenv_context* ctx = make("", options, 2);
+
+    if (ctx == NULL) {
+        printf("Could not make the environment!\n");
+
+        return 1;
+    }
+
+    reset(ctx, options, 1);
+
+    const int num_rounds = 6;
+    const int num_replayed_steps = 150; // Long enough to cross episode ends
+
+    uint8_t* observation = get_step_data(ctx)->observations[0].value_buffer.b;
+    int observation_size = get_step_data(ctx)->observations[0].value_buffer_size;
+
+    int state_size = get_state_size(ctx);
+    uint8_t* state = malloc(state_size);
+
+    uint8_t* saved_observation = malloc(observation_size);
+    uint8_t* observations[2] = { malloc(num_replayed_steps * observation_size), malloc(num_replayed_steps * observation_size) };
+    float rewards[2][num_replayed_steps];
+
+    int num_failures = 0;
+    int t = 0;
+
+    for (int round = 0; round < num_rounds && num_failures == 0; round++) {
+        int num_steps = 50 + round * 37;
+
+        run(ctx, t, num_steps, NULL, NULL);
+
+        t += num_steps;
+
+        int written = save_state(ctx, state, state_size);
+
+        memcpy(saved_observation, observation, observation_size);
+
+        if (written < 0) {
+            printf("Frame stack %d, round %d: could not save the state!\n", frame_stack, round);
+            num_failures++;
+
+            break;
+        }
+
+        run(ctx, t, num_replayed_steps, observations[0], rewards[0]);
+
+        if (load_state(ctx, state, written) != 0) {
+            printf("Frame stack %d, round %d: could not load the state!\n", frame_stack, round);
+            num_failures++;
+
+            break;
+        }
+
+        if (memcmp(saved_observation, observation, observation_size) != 0) {
+            printf("Frame stack %d, round %d: the observation isn't the saved one after loading!\n", frame_stack, round);
+            num_failures++;
+        }
+
+        run(ctx, t, num_replayed_steps, observations[1], rewards[1]);
+
+        t += num_replayed_steps;
+
+        if (memcmp(observations[0], observations[1], num_replayed_steps * observation_size) != 0) {
+            printf("Frame stack %d, round %d: observations differ after loading!\n", frame_stack, round);
+            num_failures++;
+        }
+
+        if (memcmp(rewards[0], rewards[1], sizeof(rewards[0])) != 0) {
+            printf("Frame stack %d, round %d: rewards differ after loading!\n", frame_stack, round);
+            num_failures++;
+        }
+    }
+
+    // A cut off state is corrupted, the observation must be that of the reset instance rather than left as it was
+    int written = save_state(ctx, state, state_size);
+
+    memset(observation, 0xab, observation_size);
+
+    if (load_state(ctx, state, written / 2) != 2) {
+        printf("Frame stack %d: a corrupted state was not rejected!\n", frame_stack);
+        num_failures++;
+    }
+    else {
+        int rendered = 0;
+
+        for (int i = 0; i < observation_size; i++)
+            rendered |= observation[i] != 0xab;
+
+        if (!rendered) {
+            printf("Frame stack %d: no observation after rejecting a corrupted state!\n", frame_stack);
+            num_failures++;
+        }
+    }
+
+    close_env(ctx);
+
+    free(state);
+    free(saved_observation);
+    free(observations[0]);
+    free(observations[1]);
+
+    return num_failures;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("Usage: test_state <library>\n");
+
+        return 2;
+    }
+
+    void* lib = dlopen(argv[1], RTLD_NOW);
+
+    if (lib == NULL) {
+        printf("%s\n", dlerror());
+
+        return 2;
+    }
+
+    make = dlsym(lib, "cenv_make");
+    reset = dlsym(lib, "cenv_reset");
+    step = dlsym(lib, "cenv_step");
+    get_step_data = dlsym(lib, "cenv_get_step_data");
+    close_env = dlsym(lib, "cenv_close");
+    get_state_size = dlsym(lib, "cenv_get_state_size");
+    save_state = dlsym(lib, "cenv_save_state");
+    load_state = dlsym(lib, "cenv_load_state");
+
+    if (save_state == NULL) {
+        printf("The library has no state snapshots!\n");
+
+        return 2;
+    }
+
+    int num_failures = test_instance(1) + test_instance(3);
+
+    printf("%d failures\n", num_failures);
+
+    return num_failures != 0;
+}
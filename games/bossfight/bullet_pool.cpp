@@ -0,0 +1,290 @@
+#include "bullet_pool.h"
+
+#include <algorithm>
+#include <cassert>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Rectangle as its edges, as check_collision compares them
+struct Bounds {
+    float left, top, right, bottom;
+
+    Bounds(const Rectangle &rectangle) {
+        left = rectangle.x;
+        top = rectangle.y;
+        right = rectangle.x + rectangle.width;
+        bottom = rectangle.y + rectangle.height;
+    }
+};
+
+// Half size of the box bullets collide with
+const float bullet_extent = 0.01f;
+
+void Bullet_Pool::init(int capacity, float first_animated_frame, float expired_frame) {
+    this->capacity = capacity;
+    this->first_animated_frame = first_animated_frame;
+    this->expired_frame = expired_frame;
+
+    pos_x.resize(capacity);
+    pos_y.resize(capacity);
+    vel_x.resize(capacity);
+    vel_y.resize(capacity);
+    rotation.resize(capacity);
+    frame.resize(capacity);
+    bounce_timer.resize(capacity);
+    bouncing.resize(capacity);
+    serial.resize(capacity);
+    status.resize(capacity);
+
+    clear();
+}
+
+void Bullet_Pool::clear() {
+    count = 0;
+    num_fired = 0;
+    window_size = 0;
+}
+
+int Bullet_Pool::add() {
+    assert(!full() && count < capacity);
+
+    int index = count;
+
+    pos_x[index] = 0.0f;
+    pos_y[index] = 0.0f;
+    vel_x[index] = 0.0f;
+    vel_y[index] = 0.0f;
+    rotation[index] = 0.0f;
+    frame[index] = 0.0f;
+    bounce_timer[index] = 0.0f;
+    bouncing[index] = false;
+    serial[index] = num_fired;
+
+    count++;
+    num_fired++;
+    window_size++;
+
+    return index;
+}
+
+static void classify_scalar(const float* pos_x, const float* pos_y, const float* frame, int32_t* status, int begin, int end, const Bounds &screen, const Bounds* target) {
+    for (int i = begin; i < end; i++) {
+        if (frame[i] != 0.0f) {
+            status[i] = Bullet_Pool::idle;
+
+            continue;
+        }
+
+        float left = pos_x[i] - bullet_extent;
+        float top = pos_y[i] - bullet_extent;
+        float right = left + bullet_extent * 2.0f;
+        float bottom = top + bullet_extent * 2.0f;
+
+        if (!(left < screen.right && right > screen.left && top < screen.bottom && bottom > screen.top))
+            status[i] = Bullet_Pool::left_screen;
+        else if (target != nullptr && left < target->right && right > target->left && top < target->bottom && bottom > target->top)
+            status[i] = Bullet_Pool::hit_target;
+        else
+            status[i] = Bullet_Pool::in_flight;
+    }
+}
+
+static void advance_scalar(float* pos_x, float* pos_y, const float* vel_x, const float* vel_y, float* frame, float* bounce_timer, const int32_t* bouncing, int begin, int end,
+    float dt, float frame_step, float first_animated_frame, float expired_frame)
+{
+    for (int i = begin; i < end; i++) {
+        pos_x[i] += vel_x[i] * dt;
+        pos_y[i] += vel_y[i] * dt;
+
+        bool destroy = false;
+
+        if (frame[i] >= expired_frame)
+            destroy = true;
+        else if (frame[i] >= first_animated_frame)
+            frame[i] += frame_step;
+
+        if (bouncing[i]) {
+            if (bounce_timer[i] > 0.0f)
+                bounce_timer[i] = std::max(0.0f, bounce_timer[i] - dt);
+            else
+                destroy = true;
+        }
+
+        if (destroy)
+            frame[i] = -1.0f;
+    }
+}
+
+#if defined(__SSE2__)
+static inline __m128 select_ps(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static inline __m128i select_si128(__m128i mask, __m128i a, __m128i b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static inline __m128 overlaps_sse2(__m128 left, __m128 top, __m128 right, __m128 bottom, const Bounds &bounds) {
+    return _mm_and_ps(_mm_and_ps(_mm_cmplt_ps(left, _mm_set1_ps(bounds.right)), _mm_cmpgt_ps(right, _mm_set1_ps(bounds.left))),
+        _mm_and_ps(_mm_cmplt_ps(top, _mm_set1_ps(bounds.bottom)), _mm_cmpgt_ps(bottom, _mm_set1_ps(bounds.top))));
+}
+
+static void classify_sse2(const float* pos_x, const float* pos_y, const float* frame, int32_t* status, int count, const Bounds &screen, const Bounds* target) {
+    const __m128 extent = _mm_set1_ps(bullet_extent);
+    const __m128 size = _mm_set1_ps(bullet_extent * 2.0f);
+
+    int i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 in_flight = _mm_cmpeq_ps(_mm_loadu_ps(frame + i), _mm_setzero_ps());
+
+        __m128 left = _mm_sub_ps(_mm_loadu_ps(pos_x + i), extent);
+        __m128 top = _mm_sub_ps(_mm_loadu_ps(pos_y + i), extent);
+        __m128 right = _mm_add_ps(left, size);
+        __m128 bottom = _mm_add_ps(top, size);
+
+        __m128 on_screen = overlaps_sse2(left, top, right, bottom, screen);
+        __m128 hit = target != nullptr ? _mm_and_ps(on_screen, overlaps_sse2(left, top, right, bottom, *target)) : _mm_setzero_ps();
+
+        __m128i s = select_si128(_mm_castps_si128(on_screen), _mm_set1_epi32(Bullet_Pool::in_flight), _mm_set1_epi32(Bullet_Pool::left_screen));
+
+        s = select_si128(_mm_castps_si128(hit), _mm_set1_epi32(Bullet_Pool::hit_target), s);
+        s = _mm_and_si128(_mm_castps_si128(in_flight), s); // idle is 0
+
+        _mm_storeu_si128((__m128i*)(status + i), s);
+    }
+
+    classify_scalar(pos_x, pos_y, frame, status, i, count, screen, target);
+}
+
+static void advance_sse2(float* pos_x, float* pos_y, const float* vel_x, const float* vel_y, float* frame, float* bounce_timer, const int32_t* bouncing, int begin, int end,
+    float dt, float frame_step, float first_animated_frame, float expired_frame)
+{
+    const __m128 dt4 = _mm_set1_ps(dt);
+    const __m128 zero = _mm_setzero_ps();
+
+    int i = begin;
+
+    for (; i + 4 <= end; i += 4) {
+        _mm_storeu_ps(pos_x + i, _mm_add_ps(_mm_loadu_ps(pos_x + i), _mm_mul_ps(_mm_loadu_ps(vel_x + i), dt4)));
+        _mm_storeu_ps(pos_y + i, _mm_add_ps(_mm_loadu_ps(pos_y + i), _mm_mul_ps(_mm_loadu_ps(vel_y + i), dt4)));
+
+        __m128 f = _mm_loadu_ps(frame + i);
+        __m128 destroy = _mm_cmpge_ps(f, _mm_set1_ps(expired_frame));
+
+        f = select_ps(_mm_cmpge_ps(f, _mm_set1_ps(first_animated_frame)), _mm_add_ps(f, _mm_set1_ps(frame_step)), f);
+
+        __m128 b = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(bouncing + i)), _mm_setzero_si128())); // Not bouncing
+        __m128 t = _mm_loadu_ps(bounce_timer + i);
+        __m128 counting = _mm_cmpgt_ps(t, zero);
+
+        _mm_storeu_ps(bounce_timer + i, select_ps(_mm_andnot_ps(b, counting), _mm_max_ps(_mm_sub_ps(t, dt4), zero), t));
+
+        destroy = _mm_or_ps(destroy, _mm_andnot_ps(_mm_or_ps(b, counting), _mm_castsi128_ps(_mm_set1_epi32(-1))));
+
+        _mm_storeu_ps(frame + i, select_ps(destroy, _mm_set1_ps(-1.0f), f));
+    }
+
+    advance_scalar(pos_x, pos_y, vel_x, vel_y, frame, bounce_timer, bouncing, i, end, dt, frame_step, first_animated_frame, expired_frame);
+}
+#endif
+
+void Bullet_Pool::classify(const Rectangle &screen_rect, const Rectangle* target_rect) {
+    Bounds screen(screen_rect);
+    Bounds target(target_rect != nullptr ? *target_rect : screen_rect);
+
+#if defined(__SSE2__)
+    classify_sse2(pos_x.data(), pos_y.data(), frame.data(), status.data(), count, screen, target_rect != nullptr ? &target : nullptr);
+#else
+    classify_scalar(pos_x.data(), pos_y.data(), frame.data(), status.data(), 0, count, screen, target_rect != nullptr ? &target : nullptr);
+#endif
+}
+
+void Bullet_Pool::advance(int first, float dt, float animation_rate) {
+#if defined(__SSE2__)
+    advance_sse2(pos_x.data(), pos_y.data(), vel_x.data(), vel_y.data(), frame.data(), bounce_timer.data(), bouncing.data(), first, count,
+        dt, animation_rate * dt, first_animated_frame, expired_frame);
+#else
+    advance_scalar(pos_x.data(), pos_y.data(), vel_x.data(), vel_y.data(), frame.data(), bounce_timer.data(), bouncing.data(), first, count,
+        dt, animation_rate * dt, first_animated_frame, expired_frame);
+#endif
+}
+
+void Bullet_Pool::remove_destroyed() {
+    int window_start = num_fired - window_size;
+
+    int kept = 0;
+
+    for (int i = 0; i < count; i++) {
+        if (frame[i] == -1.0f || serial[i] < window_start)
+            continue;
+
+        if (kept != i) {
+            pos_x[kept] = pos_x[i];
+            pos_y[kept] = pos_y[i];
+            vel_x[kept] = vel_x[i];
+            vel_y[kept] = vel_y[i];
+            rotation[kept] = rotation[i];
+            frame[kept] = frame[i];
+            bounce_timer[kept] = bounce_timer[i];
+            bouncing[kept] = bouncing[i];
+            serial[kept] = serial[i];
+        }
+
+        kept++;
+    }
+
+    count = kept;
+}
+
+void Bullet_Pool::save_state(State_Writer &writer) const {
+    writer.write(num_fired);
+    writer.write(window_size);
+
+    for (const std::vector<float>* values : { &pos_x, &pos_y, &vel_x, &vel_y, &rotation, &frame, &bounce_timer })
+        writer.write_array(values->data(), count, capacity);
+
+    writer.write_array(bouncing.data(), count, capacity);
+    writer.write_array(serial.data(), count, capacity);
+}
+
+void Bullet_Pool::load_state(State_Reader &reader) {
+    reader.read(num_fired);
+    reader.read(window_size);
+
+    count = reader.read_array(pos_x.data(), capacity);
+
+    for (std::vector<float>* values : { &pos_y, &vel_x, &vel_y, &rotation, &frame, &bounce_timer }) {
+        if (reader.read_array(values->data(), capacity) != count)
+            reader.fail();
+    }
+
+    if (reader.read_array(bouncing.data(), capacity) != count || reader.read_array(serial.data(), capacity) != count)
+        reader.fail();
+
+    if (window_size < count || window_size > capacity)
+        reader.fail();
+
+    if (reader.failed())
+        clear();
+}
+
+void Bullet_Pool::copy_state(const Bullet_Pool &other) {
+    assert(capacity == other.capacity);
+
+    count = other.count;
+    num_fired = other.num_fired;
+    window_size = other.window_size;
+
+    std::copy_n(other.pos_x.begin(), count, pos_x.begin());
+    std::copy_n(other.pos_y.begin(), count, pos_y.begin());
+    std::copy_n(other.vel_x.begin(), count, vel_x.begin());
+    std::copy_n(other.vel_y.begin(), count, vel_y.begin());
+    std::copy_n(other.rotation.begin(), count, rotation.begin());
+    std::copy_n(other.frame.begin(), count, frame.begin());
+    std::copy_n(other.bounce_timer.begin(), count, bounce_timer.begin());
+    std::copy_n(other.bouncing.begin(), count, bouncing.begin());
+    std::copy_n(other.serial.begin(), count, serial.begin());
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "helpers.h"
+#include "state.h"
+
+#include <cstdint>
+#include <vector>
+
+// Bullets (or explosions) of a system as a structure of arrays, so that the per bullet steps run on several bullets at once (SSE2/NEON).
+// Holds the live bullets among the last get_window_size() fired, oldest first. Like the ring buffers it replaces, destroying a bullet shrinks
+// the window by one, so the oldest bullets drop out of it without finishing (the pool forgets them on remove_destroyed)
+class Bullet_Pool {
+public:
+    enum Status {
+        idle = 0, // Not in flight (exploding)
+        in_flight, // On screen, not touching the target
+        left_screen,
+        hit_target
+    };
+
+private:
+    int capacity = 0;
+    int count = 0;
+
+    int num_fired = 0; // Serial of the next bullet
+    int window_size = 0;
+
+    float first_animated_frame = 1.0f;
+    float expired_frame = 5.0f;
+
+public:
+    // Live bullets, count of each
+    std::vector<float> pos_x;
+    std::vector<float> pos_y;
+    std::vector<float> vel_x;
+    std::vector<float> vel_y;
+    std::vector<float> rotation;
+    std::vector<float> frame; // Animation frame, -1.0f once destroyed (until remove_destroyed)
+    std::vector<float> bounce_timer; // Remaining lifespan after bouncing
+    std::vector<int32_t> bouncing;
+    std::vector<int32_t> serial;
+
+    std::vector<int32_t> status; // Of classify, not state
+
+    // Frames from first_animated_frame on advance with time, bullets are destroyed once they reach expired_frame
+    void init(int capacity, float first_animated_frame, float expired_frame);
+    void clear();
+
+    int size() const {
+        return count;
+    }
+
+    int get_window_size() const {
+        return window_size;
+    }
+
+    bool full() const {
+        return window_size >= capacity;
+    }
+
+    // Index of a new bullet (the newest), not bouncing. The rest is set by the caller. Requires !full()
+    int add();
+
+    bool in_window(int index) const {
+        return serial[index] >= num_fired - window_size;
+    }
+
+    // Whether advance destroys the bullet
+    bool expires(int index) const {
+        return frame[index] >= expired_frame || (bouncing[index] && !(bounce_timer[index] > 0.0f));
+    }
+
+    // For every bullet destroyed in an update, newest first as in the window
+    void shrink_window() {
+        window_size--;
+    }
+
+    // Status of every bullet, in flight ones (frame 0) tested with a small box against the screen and the target (if any)
+    void classify(const Rectangle &screen_rect, const Rectangle* target_rect);
+
+    // Move, animate and count down bounces of the bullets from first on, destroying expired ones
+    void advance(int first, float dt, float animation_rate);
+
+    // Drop destroyed bullets and the ones out of the window
+    void remove_destroyed();
+
+    void save_state(State_Writer &writer) const;
+    void load_state(State_Reader &reader);
+    void copy_state(const Bullet_Pool &other);
+};
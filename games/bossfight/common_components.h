@@ -52,3 +52,14 @@ struct Component_Hazard {
 struct Component_Agent {
     int action = 0;
 };
+
+// Component types of the game, in signature bit order
+struct Component_List : Type_List<
+    Component_Transform,
+    Component_Collision,
+    Component_Dynamics,
+    Component_Sprite,
+    Component_Mob_AI,
+    Component_Hazard,
+    Component_Agent
+> {};
@@ -4,17 +4,11 @@
 #include <iostream>
 
 void System_Sprite_Render::update(float dt) {
-    if (render_entities.size() != entities.size())
-        render_entities.resize(entities.size());
+    render_entities.clear();
 
-    int index = 0;
-
-    for (auto const &e : entities) {
-        auto &sprite = c.get_component<Component_Sprite>(e);
-
-        render_entities[index] = std::make_pair(sprite.z, e);
-        index++;
-    }
+    c->view<Component_Sprite>().each([&](Entity e, Component_Sprite &sprite) {
+        render_entities.push_back(std::make_pair(sprite.z, e));
+    });
     
     // Sort sprites
     std::sort(render_entities.begin(), render_entities.end(), [](const std::pair<float, Entity> &left, const std::pair<float, Entity> &right) {
@@ -27,8 +21,8 @@ void System_Sprite_Render::render(Sprite_Render_Mode mode) {
     for (size_t i = 0; i < render_entities.size(); i++) {
         Entity e = render_entities[i].second;
 
-        auto const &sprite = c.get_component<Component_Sprite>(e);
-        auto const &transform = c.get_component<Component_Transform>(e);
+        auto const &sprite = c->get_component<Component_Sprite>(e);
+        auto const &transform = c->get_component<Component_Transform>(e);
 
         if (sprite.texture == nullptr)
             continue;
@@ -42,7 +36,18 @@ void System_Sprite_Render::render(Sprite_Render_Mode mode) {
         float scale = transform.scale * sprite.scale;
 
         // If visible
-        gr.render_texture(sprite.texture, (Vector2){ (transform.position.x + sprite.position.x) * unit_to_pixels, (transform.position.y + sprite.position.y) * unit_to_pixels }, scale * unit_to_pixels / sprite.texture->width, 1.0f, sprite.flip_x, sprite.flip_y);
+        gr->render_texture(sprite.texture, (Vector2){ (transform.position.x + sprite.position.x) * unit_to_pixels, (transform.position.y + sprite.position.y) * unit_to_pixels }, scale * unit_to_pixels / sprite.texture->width, 1.0f, sprite.flip_x, sprite.flip_y);
+    }
+}
+
+void System_Hazard::hash_entities(Spatial_Hash &hash) const {
+    hash.clear();
+
+    for (Entity h : entities) {
+        const Component_Transform &hazard_transform = c->get_component<Component_Transform>(h);
+        const Component_Collision &hazard_collision = c->get_component<Component_Collision>(h);
+
+        hash.insert(h, Rectangle{ hazard_transform.position.x + hazard_collision.bounds.x, hazard_transform.position.y + hazard_collision.bounds.y, hazard_collision.bounds.width, hazard_collision.bounds.height });
     }
 }
 
@@ -56,46 +61,41 @@ void System_Mob_AI::init() {
 
     bullet_textures.resize(3);
 
-    bullet_textures[0] = &manager_texture.get("assets/misc_assets/laserGreen14.png");
-    bullet_textures[1] = &manager_texture.get("assets/misc_assets/laserRed11.png");
-    bullet_textures[2] = &manager_texture.get("assets/misc_assets/laserBlue09.png");
+    bullet_textures[0] = &manager_texture->get("assets/misc_assets/laserGreen14.png");
+    bullet_textures[1] = &manager_texture->get("assets/misc_assets/laserRed11.png");
+    bullet_textures[2] = &manager_texture->get("assets/misc_assets/laserBlue09.png");
 
     explosion_textures.resize(5);
 
     for (int i = 0; i < explosion_textures.size(); i++)
-        explosion_textures[i] = &manager_texture.get("assets/misc_assets/explosion" + std::to_string(i + 1) + ".png");
+        explosion_textures[i] = &manager_texture->get("assets/misc_assets/explosion" + std::to_string(i + 1) + ".png");
 
     shield_texture.load("assets/misc_assets/shield2.png");
 
-    // Max bullets and explosions
-    bullets.resize(64);
-    explosions.resize(8);
+    // Max bullets and explosions. Bullets explode from frame 1, explosions animate from the start
+    bullets.init(64, 1.0f, 5.0f);
+    explosions.init(8, 0.0f, 4.0f);
 }
 
 void System_Mob_AI::fire(const Vector2 &pos, float rotation, float speed) {
-    if (num_bullets < bullets.size()) {
-        Bullet &bullet = bullets[next_bullet];
-
-        bullet.rotation = rotation;
-        bullet.vel = { std::cos(rotation) * speed, -std::sin(rotation) * speed };
-        bullet.pos = pos;
-        bullet.frame = 0.0f; // First frame (bullet)
-
-        next_bullet = (next_bullet + 1) % bullets.size();
-        num_bullets++;
+    if (!bullets.full()) {
+        int bullet = bullets.add(); // First frame (bullet)
+
+        bullets.rotation[bullet] = rotation;
+        bullets.vel_x[bullet] = std::cos(rotation) * speed;
+        bullets.vel_y[bullet] = -std::sin(rotation) * speed;
+        bullets.pos_x[bullet] = pos.x;
+        bullets.pos_y[bullet] = pos.y;
     }
 }
 
 // Spawn en explosion
 void System_Mob_AI::explode(const Vector2 &pos) {
-    if (num_explosions < explosions.size()) {
-        Explosion &explosion = explosions[next_explosion];
-
-        explosion.pos = pos;
-        explosion.frame = 0.0f; // First frame
+    if (!explosions.full()) {
+        int explosion = explosions.add(); // First frame
 
-        next_explosion = (next_explosion + 1) % explosions.size();
-        num_explosions++;
+        explosions.pos_x[explosion] = pos.x;
+        explosions.pos_y[explosion] = pos.y;
     }
 }
 
@@ -211,28 +211,27 @@ bool System_Mob_AI::update(float dt, const std::shared_ptr<System_Hazard> &hazar
     bool alive = true;
 
     // Get agent system
-    std::shared_ptr<System_Agent> agent = c.system_manager.get_system<System_Agent>();
+    std::shared_ptr<System_Agent> agent = c->system_manager.get_system<System_Agent>();
 
     // Gather some information about the agent
     Entity e_agent = *agent->entities.begin();
 
-    const Component_Transform &agent_transform = c.get_component<Component_Transform>(e_agent);
-    const Component_Collision &agent_collision = c.get_component<Component_Collision>(e_agent);
+    const Component_Transform &agent_transform = c->get_component<Component_Transform>(e_agent);
+    const Component_Collision &agent_collision = c->get_component<Component_Collision>(e_agent);
 
     Rectangle agent_rect{ agent_transform.position.x + agent_collision.bounds.x, agent_transform.position.y + agent_collision.bounds.y, agent_collision.bounds.width, agent_collision.bounds.height };
 
     assert(entities.size() == 1); // Only 1 boss
 
     // Screen rectangle
-    Rectangle screen_rect{ -gr.camera_size.x / gr.camera_scale * pixels_to_unit * 0.5f, -gr.camera_size.y / gr.camera_scale * pixels_to_unit * 0.5f,
-        gr.camera_size.x / gr.camera_scale * pixels_to_unit, gr.camera_size.y / gr.camera_scale * pixels_to_unit };
+    Rectangle screen_rect{ -gr->camera_size.x / gr->camera_scale * pixels_to_unit * 0.5f, -gr->camera_size.y / gr->camera_scale * pixels_to_unit * 0.5f,
+        gr->camera_size.x / gr->camera_scale * pixels_to_unit, gr->camera_size.y / gr->camera_scale * pixels_to_unit };
 
     // For all entities (only 1, the boss)
     for (auto const &e : entities) {
-        auto &mob_ai = c.get_component<Component_Mob_AI>(e);
-        auto &transform = c.get_component<Component_Transform>(e);
-        auto &dynamics = c.get_component<Component_Dynamics>(e);
-        auto &collision = c.get_component<Component_Collision>(e);
+        auto &mob_ai = c->get_component<Component_Mob_AI>(e);
+        auto &transform = c->get_component<Component_Transform>(e);
+        auto &dynamics = c->get_component<Component_Dynamics>(e);
 
         if (mob_ai.phase_timer == 0.0f) { // Phase start, set some values
             std::uniform_int_distribution<int> weapon_dist(0, num_weapons - 1);
@@ -297,91 +296,73 @@ bool System_Mob_AI::update(float dt, const std::shared_ptr<System_Hazard> &hazar
         transform.position.x += dynamics.velocity.x * dt;
         transform.position.y += dynamics.velocity.y * dt;
 
-        // World space collision
-        Rectangle world_collision{ transform.position.x + collision.bounds.x, transform.position.y + collision.bounds.y, collision.bounds.width, collision.bounds.height };
-
-        // Control bullets
-        for (int i = 0; i < num_bullets; i++) {
-            int bullet_index = (bullets.size() + next_bullet - 1 - i) % bullets.size();
+        hazard->hash_entities(hazard_hash);
 
-            Bullet &bullet = bullets[bullet_index];
+        // Control bullets. Screen and agent tests for all at once, then the collisions newest first, then the movement and animation of the bullets that got there
+        bullets.classify(screen_rect, &agent_rect);
 
-            if (bullet.frame == -1.0f)
-                continue;
+        int first_bullet = bullets.size();
 
-            if (bullet.frame == 0.0f) {
-                Rectangle world_collision{ bullet.pos.x - 0.01f, bullet.pos.y - 0.01f, 0.02f, 0.02f };
+        while (first_bullet > 0) {
+            int bullet = first_bullet - 1;
 
-                if (!check_collision(world_collision, screen_rect)) {
-                    // Remove by setting to completed animation
-                    bullet.vel = { 0.0f, 0.0f };
-                    bullet.frame = 5.0f;
-                }
-                else {
-                    // If collide with agent
-                    if (check_collision(world_collision, agent_rect)) {
-                        // Set velocity to 0 and animate
-                        bullet.vel = { 0.0f, 0.0f };
-                        bullet.frame = 1.0f;
+            if (!bullets.in_window(bullet)) // Dropped by newer bullets being destroyed
+                break;
 
-                        agent->alive = false;
+            if (bullets.status[bullet] == Bullet_Pool::left_screen) {
+                // Remove by setting to completed animation
+                bullets.vel_x[bullet] = bullets.vel_y[bullet] = 0.0f;
+                bullets.frame[bullet] = 5.0f;
+            }
+            else if (bullets.status[bullet] == Bullet_Pool::hit_target) { // If collide with agent
+                // Set velocity to 0 and animate
+                bullets.vel_x[bullet] = bullets.vel_y[bullet] = 0.0f;
+                bullets.frame[bullet] = 1.0f;
 
-                        break;
-                    }
+                agent->alive = false;
 
-                    for (Entity h : hazard->get_entities()) {
-                        if (h == e) // Skip self (also a hazard)
-                            continue;
+                break;
+            }
+            else if (bullets.status[bullet] == Bullet_Pool::in_flight) {
+                Rectangle world_collision{ bullets.pos_x[bullet] - 0.01f, bullets.pos_y[bullet] - 0.01f, 0.02f, 0.02f };
 
-                        const Component_Hazard &hazard = c.get_component<Component_Hazard>(h);
-                        
-                        const Component_Transform &hazard_transform = c.get_component<Component_Transform>(h);
-                        const Component_Collision &hazard_collision = c.get_component<Component_Collision>(h);
+                hazard_hash.query(world_collision, hazard_hits);
 
-                        Rectangle hazard_rect{ hazard_transform.position.x + hazard_collision.bounds.x, hazard_transform.position.y + hazard_collision.bounds.y, hazard_collision.bounds.width, hazard_collision.bounds.height };
+                for (Entity h : hazard_hits) {
+                    if (h == e) // Skip self (also a hazard)
+                        continue;
 
-                        if (check_collision(world_collision, hazard_rect)) {
-                            // Set velocity to 0 and animate
-                            bullet.vel = { 0.0f, 0.0f };
-                            bullet.frame = 1.0f;
+                    // Set velocity to 0 and animate
+                    bullets.vel_x[bullet] = bullets.vel_y[bullet] = 0.0f;
+                    bullets.frame[bullet] = 1.0f;
 
-                            break;
-                        }
-                    }
+                    break;
                 }
             }
 
-            // Move
-            bullet.pos.x += bullet.vel.x * dt;
-            bullet.pos.y += bullet.vel.y * dt;
+            if (bullets.expires(bullet))
+                bullets.shrink_window();
 
-            if (bullet.frame >= 5.0f) {
-                // Destroy
-                num_bullets--;
-                bullet.frame = -1.0f;
-            }
-            else if (bullet.frame >= 1.0f)
-                bullet.frame += explosion_rate * dt;
+            first_bullet = bullet;
         }
 
-        // Control explosions
-        for (int i = 0; i < num_explosions; i++) {
-            int explosion_index = (explosions.size() + next_explosion - 1 - i) % explosions.size();
+        // Move, animate and destroy
+        bullets.advance(first_bullet, dt, explosion_rate);
+        bullets.remove_destroyed();
 
-            Explosion &explosion = explosions[explosion_index];
+        // Control explosions
+        int first_explosion = explosions.size();
 
-            if (explosion.frame == -1.0f)
-                continue;
+        while (first_explosion > 0 && explosions.in_window(first_explosion - 1)) {
+            first_explosion--;
 
-            if (explosion.frame >= 4.0f) {
-                // Destroy
-                num_explosions--;
-                explosion.frame = -1.0f;
-            }
-            else if (explosion.frame >= 0.0f)
-                explosion.frame += explosion_rate * dt;
+            if (explosions.expires(first_explosion))
+                explosions.shrink_window();
         }
 
+        explosions.advance(first_explosion, dt, explosion_rate);
+        explosions.remove_destroyed();
+
         if (mob_ai.phase_index >= 6) // 6 since there are 2 sub-phases per damage phase (3)
             alive = false;
     }
@@ -393,67 +374,51 @@ void System_Mob_AI::render() {
     assert(entities.size() == 1); // Only one player
 
     for (auto const &e : entities) {
-        auto const &mob_ai = c.get_component<Component_Mob_AI>(e);
-        auto const &transform = c.get_component<Component_Transform>(e);
-        auto const &dynamics = c.get_component<Component_Dynamics>(e);
-
-        // Render bullets
-        for (int i = 0; i < num_bullets; i++) {
-            int bullet_index = (bullets.size() + next_bullet - 1 - i) % bullets.size();
-
-            Bullet &bullet = bullets[bullet_index];
-
-            if (bullet.frame == -1.0f)
-                continue;
+        auto const &mob_ai = c->get_component<Component_Mob_AI>(e);
+        auto const &transform = c->get_component<Component_Transform>(e);
+        auto const &dynamics = c->get_component<Component_Dynamics>(e);
 
+        // Render bullets, newest first
+        for (int bullet = bullets.size() - 1; bullet >= 0; bullet--) {
             Asset_Texture* texture;
 
-            if (bullet.frame == 0.0f)
+            if (bullets.frame[bullet] == 0.0f)
                 texture = bullet_textures[current_bullet_texture_index];
             else
-                texture = explosion_textures[static_cast<int>(bullet.frame - 1.0f)];
+                texture = explosion_textures[static_cast<int>(bullets.frame[bullet] - 1.0f)];
 
             const float size = 0.1f;
 
-            gr.render_texture_rotated(texture, { bullet.pos.x * unit_to_pixels - size * texture->width * 0.5f, bullet.pos.y * unit_to_pixels - size * texture->height * 0.5f }, bullet.rotation + M_PI * 0.5f, size);
+            gr->render_texture_rotated(texture, { bullets.pos_x[bullet] * unit_to_pixels - size * texture->width * 0.5f, bullets.pos_y[bullet] * unit_to_pixels - size * texture->height * 0.5f }, bullets.rotation[bullet] + M_PI * 0.5f, size);
         }
 
         {
             const float size = 0.25f;
 
-            gr.render_texture(&ship_textures[current_ship_texture_index], { transform.position.x * unit_to_pixels - size * ship_textures[current_ship_texture_index].width * 0.5f, transform.position.y * unit_to_pixels - size * ship_textures[current_ship_texture_index].height * 0.5f }, size);
+            gr->render_texture(&ship_textures[current_ship_texture_index], { transform.position.x * unit_to_pixels - size * ship_textures[current_ship_texture_index].width * 0.5f, transform.position.y * unit_to_pixels - size * ship_textures[current_ship_texture_index].height * 0.5f }, size);
         }
 
         // Render shield if in a shield phase
         if (mob_ai.phase_index % 2 == 0) {
             const float size = 0.25f;
 
-            gr.render_texture(&shield_texture, { transform.position.x * unit_to_pixels - size * shield_texture.width * 0.5f, transform.position.y * unit_to_pixels - size * shield_texture.height * 0.5f }, size, 0.7f); // Some transparency
+            gr->render_texture(&shield_texture, { transform.position.x * unit_to_pixels - size * shield_texture.width * 0.5f, transform.position.y * unit_to_pixels - size * shield_texture.height * 0.5f }, size, 0.7f); // Some transparency
         }
 
-        // Render explosions
-        for (int i = 0; i < num_explosions; i++) {
-            int explosion_index = (explosions.size() + next_explosion - 1 - i) % explosions.size();
-
-            Explosion &explosion = explosions[explosion_index];
-
-            if (explosion.frame == -1.0f)
-                continue;
-
-            Asset_Texture* texture = explosion_textures[static_cast<int>(explosion.frame)];
+        // Render explosions, newest first
+        for (int explosion = explosions.size() - 1; explosion >= 0; explosion--) {
+            Asset_Texture* texture = explosion_textures[static_cast<int>(explosions.frame[explosion])];
 
             const float size = 0.3f;
 
-            gr.render_texture(texture, { explosion.pos.x * unit_to_pixels - size * texture->width * 0.5f, explosion.pos.y * unit_to_pixels - size * texture->height * 0.5f }, size);
+            gr->render_texture(texture, { explosions.pos_x[explosion] * unit_to_pixels - size * texture->width * 0.5f, explosions.pos_y[explosion] * unit_to_pixels - size * texture->height * 0.5f }, size);
         }
     }
 }
 
 void System_Mob_AI::reset(std::mt19937 &rng) {
-    next_bullet = 0;
-    next_explosion = 0;
-    num_bullets = 0;
-    num_explosions = 0;
+    bullets.clear();
+    explosions.clear();
     bullet_timer = 0.0f;
     explosion_timer = 0.0f;
     damage_timer = 0.0f;
@@ -478,17 +443,17 @@ void System_Agent::init() {
 
     bullet_textures.resize(3);
 
-    bullet_textures[0] = &manager_texture.get("assets/misc_assets/laserGreen14.png");
-    bullet_textures[1] = &manager_texture.get("assets/misc_assets/laserRed11.png");
-    bullet_textures[2] = &manager_texture.get("assets/misc_assets/laserBlue09.png");
+    bullet_textures[0] = &manager_texture->get("assets/misc_assets/laserGreen14.png");
+    bullet_textures[1] = &manager_texture->get("assets/misc_assets/laserRed11.png");
+    bullet_textures[2] = &manager_texture->get("assets/misc_assets/laserBlue09.png");
 
     explosion_textures.resize(5);
 
     for (int i = 0; i < explosion_textures.size(); i++)
-        explosion_textures[i] = &manager_texture.get("assets/misc_assets/explosion" + std::to_string(i + 1) + ".png");
+        explosion_textures[i] = &manager_texture->get("assets/misc_assets/explosion" + std::to_string(i + 1) + ".png");
 
     // Max bullets
-    bullets.resize(32);
+    bullets.init(32, 1.0f, 5.0f);
 }
 
 bool System_Agent::update(float dt, const std::shared_ptr<System_Hazard> &hazard, int action, std::mt19937 &rng) {
@@ -501,28 +466,28 @@ bool System_Agent::update(float dt, const std::shared_ptr<System_Hazard> &hazard
     const float explosion_rate = 0.3f;
 
     // Get tile map system
-    std::shared_ptr<System_Mob_AI> mob_ai = c.system_manager.get_system<System_Mob_AI>();
+    std::shared_ptr<System_Mob_AI> mob_ai = c->system_manager.get_system<System_Mob_AI>();
 
     // First and only entity in mob_ai (the boss)
     Entity boss = *mob_ai->entities.begin();
-    auto &boss_mob_ai = c.get_component<Component_Mob_AI>(boss);
+    auto &boss_mob_ai = c->get_component<Component_Mob_AI>(boss);
 
     assert(entities.size() == 1); // Only one player
 
     // Screen rectangle
-    Rectangle screen_rect{ -gr.camera_size.x / gr.camera_scale * pixels_to_unit * 0.5f, -gr.camera_size.y / gr.camera_scale * pixels_to_unit * 0.5f,
-        gr.camera_size.x / gr.camera_scale * pixels_to_unit, gr.camera_size.y / gr.camera_scale * pixels_to_unit };
+    Rectangle screen_rect{ -gr->camera_size.x / gr->camera_scale * pixels_to_unit * 0.5f, -gr->camera_size.y / gr->camera_scale * pixels_to_unit * 0.5f,
+        gr->camera_size.x / gr->camera_scale * pixels_to_unit, gr->camera_size.y / gr->camera_scale * pixels_to_unit };
 
     for (auto const &e : entities) {
-        auto &agent = c.get_component<Component_Agent>(e);
+        auto &agent = c->get_component<Component_Agent>(e);
 
         // Set action
         agent.action = action;
 
-        auto &transform = c.get_component<Component_Transform>(e);
-        auto &dynamics = c.get_component<Component_Dynamics>(e);
+        auto &transform = c->get_component<Component_Transform>(e);
+        auto &dynamics = c->get_component<Component_Dynamics>(e);
 
-        const auto &collision = c.get_component<Component_Collision>(e);
+        const auto &collision = c->get_component<Component_Collision>(e);
 
         float movement_x = (agent.action == 6 || agent.action == 7 || agent.action == 8) - (agent.action == 0 || agent.action == 1 || agent.action == 2);
         float movement_y =  (agent.action == 2 || agent.action == 5 || agent.action == 8) - (agent.action == 0 || agent.action == 3 || agent.action == 6);
@@ -561,122 +526,84 @@ bool System_Agent::update(float dt, const std::shared_ptr<System_Hazard> &hazard
         world_collision = Rectangle{ transform.position.x + collision.bounds.x, transform.position.y + collision.bounds.y, collision.bounds.width, collision.bounds.height };
 
         if (fire) {
-            if (bullet_timer == 0.0f && num_bullets < bullets.size()) {
+            if (bullet_timer == 0.0f && !bullets.full()) {
                 bullet_timer = bullet_time;
 
-                Bullet &bullet = bullets[next_bullet];
+                int bullet = bullets.add(); // First frame (bullet)
 
-                bullet.rotation = transform.rotation;
-                bullet.vel = { 0.0f, -bullet_speed };
-                bullet.pos = transform.position;
-                bullet.frame = 0.0f; // First frame (bullet)
-                bullet.bouncing = false;
-                bullet.bounce_timer = 0.0f;
-
-                next_bullet = (next_bullet + 1) % bullets.size();
-                num_bullets++;
+                bullets.rotation[bullet] = transform.rotation;
+                bullets.vel_x[bullet] = 0.0f;
+                bullets.vel_y[bullet] = -bullet_speed;
+                bullets.pos_x[bullet] = transform.position.x;
+                bullets.pos_y[bullet] = transform.position.y;
             }
             else
                 bullet_timer = std::max(0.0f, bullet_timer - dt);
         }
 
         // Go through all hazards
-        for (auto const &h : hazard->get_entities()) {
-            auto const &hazard_transform = c.get_component<Component_Transform>(h);
-            auto const &hazard_collision = c.get_component<Component_Collision>(h);
+        hazard->hash_entities(hazard_hash);
+
+        hazard_hash.query(world_collision, hazard_hits);
+
+        if (!hazard_hits.empty())
+            alive = false;
 
-            // World space
-            Rectangle hazard_world_collision{ hazard_transform.position.x + hazard_collision.bounds.x, hazard_transform.position.y + hazard_collision.bounds.y, hazard_collision.bounds.width, hazard_collision.bounds.height };
+        // Control bullets, as in System_Mob_AI::update
+        bullets.classify(screen_rect, nullptr);
 
-            if (check_collision(world_collision, hazard_world_collision)) {
-                alive = false;
+        int first_bullet = bullets.size();
 
+        while (first_bullet > 0) {
+            int bullet = first_bullet - 1;
+
+            if (!bullets.in_window(bullet)) // Dropped by newer bullets being destroyed
                 break;
+
+            if (bullets.status[bullet] == Bullet_Pool::left_screen) {
+                // Remove by setting to completed animation
+                bullets.vel_x[bullet] = bullets.vel_y[bullet] = 0.0f;
+                bullets.frame[bullet] = 5.0f;
             }
-        }
+            else if (bullets.status[bullet] == Bullet_Pool::in_flight) {
+                Rectangle world_collision{ bullets.pos_x[bullet] - 0.01f, bullets.pos_y[bullet] - 0.01f, 0.02f, 0.02f };
 
-        // Control bullets
-        for (int i = 0; i < num_bullets; i++) {
-            int bullet_index = (bullets.size() + next_bullet - 1 - i) % bullets.size();
+                // If collide with hazard (the first one, in entity order)
+                hazard_hash.query(world_collision, hazard_hits);
 
-            Bullet &bullet = bullets[bullet_index];
+                if (!hazard_hits.empty()) {
+                    Entity h = hazard_hits[0];
 
-            if (bullet.frame == -1.0f)
-                continue;
+                    if (h == boss && boss_mob_ai.phase_index % 2 == 0) { // Boss and is in a shield phase
+                        // Bounce
+                        std::uniform_real_distribution<float> bounce_dist(-1.0f, 1.0f);
 
-            if (bullet.frame == 0.0f) {
-                Rectangle world_collision{ bullet.pos.x - 0.01f, bullet.pos.y - 0.01f, 0.02f, 0.02f };
+                        bullets.vel_x[bullet] = bounce_dist(rng) * bullet_bounce_speed;
+                        bullets.vel_y[bullet] = bullet_bounce_speed;
 
-                if (!check_collision(world_collision, screen_rect)) {
-                    // Remove by setting to completed animation
-                    bullet.vel = { 0.0f, 0.0f };
-                    bullet.frame = 5.0f;
-                }
-                else {
-                    // If collide with hazard
-                    for (Entity h : hazard->get_entities()) {
-                        const Component_Hazard &hazard = c.get_component<Component_Hazard>(h);
-                        
-                        const Component_Transform &hazard_transform = c.get_component<Component_Transform>(h);
-                        const Component_Collision &hazard_collision = c.get_component<Component_Collision>(h);
-
-                        Rectangle hazard_rect{ hazard_transform.position.x + hazard_collision.bounds.x, hazard_transform.position.y + hazard_collision.bounds.y, hazard_collision.bounds.width, hazard_collision.bounds.height };
-
-                        if (check_collision(world_collision, hazard_rect)) {
-                            if (h == boss) {
-                                if (boss_mob_ai.phase_index % 2 == 0) { // Boss and is in a shield phase
-                                    // Set velocity to 0 and bounce
-                                    std::uniform_real_distribution<float> bounce_dist(-1.0f, 1.0f);
-
-                                    bullet.vel = { bounce_dist(rng) * bullet_bounce_speed, bullet_bounce_speed };
-
-                                    bullet.bounce_timer = bounce_time;
-                                    bullet.bouncing = true;
-                                }
-                                else {
-                                    // Set velocity to 0 and animate
-                                    bullet.vel = { 0.0f, 0.0f };
-                                    bullet.frame = 1.0f;
-
-                                    if (boss_mob_ai.hp > 0)
-                                        boss_mob_ai.hp--;
-                                }
-                            }
-                            else {
-                                // Set velocity to 0 and animate
-                                bullet.vel = { 0.0f, 0.0f };
-                                bullet.frame = 1.0f;
-                            }
-
-                            break;
-                        }
+                        bullets.bounce_timer[bullet] = bounce_time;
+                        bullets.bouncing[bullet] = true;
+                    }
+                    else {
+                        // Set velocity to 0 and animate
+                        bullets.vel_x[bullet] = bullets.vel_y[bullet] = 0.0f;
+                        bullets.frame[bullet] = 1.0f;
+
+                        if (h == boss && boss_mob_ai.hp > 0)
+                            boss_mob_ai.hp--;
                     }
                 }
             }
 
-            // Move
-            bullet.pos.x += bullet.vel.x * dt;
-            bullet.pos.y += bullet.vel.y * dt;
-
-            bool destroy_bullet = false;
-
-            if (bullet.frame >= 5.0f)
-                destroy_bullet = true;
-            else if (bullet.frame >= 1.0f)
-                bullet.frame += explosion_rate * dt;
-
-            if (bullet.bouncing) {
-                if (bullet.bounce_timer > 0.0f)
-                    bullet.bounce_timer = std::max(0.0f, bullet.bounce_timer - dt);
-                else
-                    destroy_bullet = true;
-            }
+            if (bullets.expires(bullet))
+                bullets.shrink_window();
 
-            if (destroy_bullet) {
-                num_bullets--;
-                bullet.frame = -1.0f;
-            }
+            first_bullet = bullet;
         }
+
+        // Move, animate, count down bounces and destroy
+        bullets.advance(first_bullet, dt, explosion_rate);
+        bullets.remove_destroyed();
     }
 
     return alive;
@@ -686,43 +613,35 @@ void System_Agent::render() {
     assert(entities.size() == 1); // Only one player
 
     for (auto const &e : entities) {
-        auto const &agent = c.get_component<Component_Agent>(e);
-        auto const &transform = c.get_component<Component_Transform>(e);
-        auto const &dynamics = c.get_component<Component_Dynamics>(e);
-
-        // Render bullets
-        for (int i = 0; i < num_bullets; i++) {
-            int bullet_index = (bullets.size() + next_bullet - 1 - i) % bullets.size();
-
-            Bullet &bullet = bullets[bullet_index];
-
-            if (bullet.frame == -1.0f)
-                continue;
+        auto const &agent = c->get_component<Component_Agent>(e);
+        auto const &transform = c->get_component<Component_Transform>(e);
+        auto const &dynamics = c->get_component<Component_Dynamics>(e);
 
+        // Render bullets, newest first
+        for (int bullet = bullets.size() - 1; bullet >= 0; bullet--) {
             Asset_Texture* texture;
 
-            if (bullet.frame == 0.0f)
+            if (bullets.frame[bullet] == 0.0f)
                 texture = bullet_textures[current_bullet_texture_index];
             else
-                texture = explosion_textures[static_cast<int>(bullet.frame - 1.0f)];
+                texture = explosion_textures[static_cast<int>(bullets.frame[bullet] - 1.0f)];
 
             const float size = 0.05f;
 
-            gr.render_texture(texture, { bullet.pos.x * unit_to_pixels - size * texture->width * 0.5f, bullet.pos.y * unit_to_pixels - size * texture->height * 0.5f }, size);
+            gr->render_texture(texture, { bullets.pos_x[bullet] * unit_to_pixels - size * texture->width * 0.5f, bullets.pos_y[bullet] * unit_to_pixels - size * texture->height * 0.5f }, size);
         }
 
         // Render ship
         {
             const float size = 0.05f;
 
-            gr.render_texture(&ship_textures[current_ship_texture_index], { transform.position.x * unit_to_pixels - size * ship_textures[current_ship_texture_index].width * 0.5f, transform.position.y * unit_to_pixels - size * ship_textures[current_ship_texture_index].height * 0.5f }, size);
+            gr->render_texture(&ship_textures[current_ship_texture_index], { transform.position.x * unit_to_pixels - size * ship_textures[current_ship_texture_index].width * 0.5f, transform.position.y * unit_to_pixels - size * ship_textures[current_ship_texture_index].height * 0.5f }, size);
         }
     }
 }
 
 void System_Agent::reset(std::mt19937 &rng) {
-    next_bullet = 0;
-    num_bullets = 0;
+    bullets.clear();
     bullet_timer = 0.0f;
 
     std::uniform_int_distribution<int> ship_texture_dist(0, ship_textures.size() - 1);
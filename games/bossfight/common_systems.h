@@ -2,6 +2,7 @@
 
 #include "common_components.h"
 #include "common_assets.h"
+#include "bullet_pool.h"
 #include "ecs.h"
 
 #include <cmath>
@@ -29,6 +30,20 @@ public:
     void clear_render() {
         render_entities.clear();
     }
+
+    void save_state(State_Writer &writer) const override {
+        writer.write(render_entities, max_entities);
+    }
+
+    void load_state(State_Reader &reader) override {
+        reader.read(render_entities, max_entities);
+    }
+
+    void copy_state(const System &other) override {
+        const System_Sprite_Render &other_system = static_cast<const System_Sprite_Render&>(other);
+
+        render_entities = other_system.render_entities;
+    }
 };
 
 // -------------------- Hazards --------------------
@@ -36,9 +51,12 @@ public:
 // Empty mostly, since just need it to collect hazards for agent system
 class System_Hazard : public System {
 public:
-    std::unordered_set<Entity> &get_entities() {
+    const Entity_List &get_entities() const {
         return entities;
     }
+
+    // Clear the hash and insert the world space collision of every hazard
+    void hash_entities(Spatial_Hash &hash) const;
 };
 
 enum Distribution_Mode {
@@ -48,18 +66,6 @@ enum Distribution_Mode {
 
 class System_Mob_AI : public System {
 public:
-    struct Bullet {
-        Vector2 pos;
-        Vector2 vel;
-        float rotation;
-        float frame = -1.0f; // Animation frame, -1.0f is "dead" flag
-    };
-
-    struct Explosion {
-        Vector2 pos;
-        float frame = -1.0f;
-    };
-
     struct Config {
         Distribution_Mode mode = hard_mode;
     };
@@ -67,20 +73,20 @@ public:
 private:
     std::vector<Asset_Texture> ship_textures;
     std::vector<Asset_Texture*> bullet_textures;
-    std::vector<Bullet> bullets;
-    std::vector<Explosion> explosions;
+    Bullet_Pool bullets;
+    Bullet_Pool explosions;
     std::vector<Asset_Texture*> explosion_textures;
     Asset_Texture shield_texture;
 
-    int next_bullet = 0;
-    int next_explosion = 0;
-    int num_bullets = 0;
-    int num_explosions = 0;
     float bullet_timer = 0.0f;
     float explosion_timer = 0.0f;
     float damage_timer = 0.0f;
     float move_timer = 0.0f;
 
+    // Hazards by position, filled every update
+    Spatial_Hash hazard_hash{ 0.5f };
+    std::vector<Entity> hazard_hits;
+
     int current_ship_texture_index;
     int current_bullet_texture_index;
 
@@ -100,30 +106,57 @@ public:
     void render();
 
     void reset(std::mt19937 &rng);
+
+    void save_state(State_Writer &writer) const override {
+        bullets.save_state(writer);
+        explosions.save_state(writer);
+        writer.write(bullet_timer);
+        writer.write(explosion_timer);
+        writer.write(damage_timer);
+        writer.write(move_timer);
+        writer.write(current_ship_texture_index);
+        writer.write(current_bullet_texture_index);
+    }
+
+    void load_state(State_Reader &reader) override {
+        bullets.load_state(reader);
+        explosions.load_state(reader);
+        reader.read(bullet_timer);
+        reader.read(explosion_timer);
+        reader.read(damage_timer);
+        reader.read(move_timer);
+        reader.read(current_ship_texture_index);
+        reader.read(current_bullet_texture_index);
+    }
+
+    void copy_state(const System &other) override {
+        const System_Mob_AI &other_system = static_cast<const System_Mob_AI&>(other);
+
+        bullets.copy_state(other_system.bullets);
+        explosions.copy_state(other_system.explosions);
+        bullet_timer = other_system.bullet_timer;
+        explosion_timer = other_system.explosion_timer;
+        damage_timer = other_system.damage_timer;
+        move_timer = other_system.move_timer;
+        current_ship_texture_index = other_system.current_ship_texture_index;
+        current_bullet_texture_index = other_system.current_bullet_texture_index;
+    }
 };
 
 // --------------------- Player --------------------
 
 class System_Agent : public System {
-public:
-    struct Bullet {
-        Vector2 pos;
-        Vector2 vel;
-        float rotation;
-        float frame = -1.0f; // Animation frame, -1.0f is "dead" flag
-        bool bouncing = false;
-        float bounce_timer = 0.0f; // Bouncing off shield (timer for remaining lifespan)
-    };
-
 private:
     std::vector<Asset_Texture> ship_textures;
     std::vector<Asset_Texture*> bullet_textures;
-    std::vector<Bullet> bullets;
+    Bullet_Pool bullets;
     std::vector<Asset_Texture*> explosion_textures;
-    int next_bullet = 0;
-    int num_bullets = 0;
     float bullet_timer = 0.0f;
 
+    // Hazards by position, filled every update
+    Spatial_Hash hazard_hash{ 0.5f };
+    std::vector<Entity> hazard_hits;
+
     int current_ship_texture_index;
     int current_bullet_texture_index;
 
@@ -137,4 +170,30 @@ public:
     void render();
 
     void reset(std::mt19937 &rng);
+
+    void save_state(State_Writer &writer) const override {
+        bullets.save_state(writer);
+        writer.write(bullet_timer);
+        writer.write(current_ship_texture_index);
+        writer.write(current_bullet_texture_index);
+        writer.write(alive);
+    }
+
+    void load_state(State_Reader &reader) override {
+        bullets.load_state(reader);
+        reader.read(bullet_timer);
+        reader.read(current_ship_texture_index);
+        reader.read(current_bullet_texture_index);
+        reader.read(alive);
+    }
+
+    void copy_state(const System &other) override {
+        const System_Agent &other_system = static_cast<const System_Agent&>(other);
+
+        bullets.copy_state(other_system.bullets);
+        bullet_timer = other_system.bullet_timer;
+        current_ship_texture_index = other_system.current_ship_texture_index;
+        current_bullet_texture_index = other_system.current_bullet_texture_index;
+        alive = other_system.alive;
+    }
 };
@@ -1,5 +1,7 @@
 #include "helpers.h"
 
+#include <cassert>
+
 Rectangle rotated_scaled_AABB(const Rectangle &restangle, float rotation, float scale) {
     Vector2 half_size = (Vector2){ restangle.width * 0.5f, restangle.height * 0.5f };
 
@@ -114,3 +116,76 @@ std::string to_lower(std::string s) {
 
     return s;
 }
+
+Spatial_Hash::Spatial_Hash(float cell_size, int num_buckets) {
+    this->cell_size = cell_size;
+
+    assert(num_buckets > 0 && (num_buckets & (num_buckets - 1)) == 0);
+
+    buckets.resize(num_buckets, -1);
+}
+
+void Spatial_Hash::clear() {
+    std::fill(buckets.begin(), buckets.end(), -1);
+
+    for (int id : ids)
+        items_by_id[id] = -1;
+
+    entries.clear();
+    ids.clear();
+    rectangles.clear();
+    removed.clear();
+}
+
+void Spatial_Hash::insert(int id, const Rectangle &rectangle) {
+    assert(id >= 0);
+
+    int item = ids.size();
+
+    if (id >= static_cast<int>(items_by_id.size()))
+        items_by_id.resize(id + 1, -1);
+
+    assert(items_by_id[id] == -1);
+
+    items_by_id[id] = item;
+
+    ids.push_back(id);
+    rectangles.push_back(rectangle);
+    removed.push_back(false);
+
+    // Into every cell it touches
+    for (int y = get_cell(rectangle.y); y <= get_cell(rectangle.y + rectangle.height); y++)
+        for (int x = get_cell(rectangle.x); x <= get_cell(rectangle.x + rectangle.width); x++) {
+            int bucket = get_bucket(x, y);
+
+            entries.push_back(Entry{ item, buckets[bucket] });
+            buckets[bucket] = entries.size() - 1;
+        }
+}
+
+void Spatial_Hash::remove(int id) {
+    if (id >= 0 && id < static_cast<int>(items_by_id.size()) && items_by_id[id] != -1)
+        removed[items_by_id[id]] = true;
+}
+
+void Spatial_Hash::query(const Rectangle &rectangle, std::vector<int> &result) {
+    result.clear();
+    candidates.clear();
+
+    for (int y = get_cell(rectangle.y); y <= get_cell(rectangle.y + rectangle.height); y++)
+        for (int x = get_cell(rectangle.x); x <= get_cell(rectangle.x + rectangle.width); x++) {
+            for (int entry = buckets[get_bucket(x, y)]; entry != -1; entry = entries[entry].next)
+                candidates.push_back(entries[entry].item);
+        }
+
+    // Items in several cells (or buckets shared with other cells) come up more than once
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    for (size_t i = 0; i < candidates.size(); i++) {
+        int item = candidates[i];
+
+        if (!removed[item] && check_collision(rectangle, rectangles[item]))
+            result.push_back(ids[item]);
+    }
+}
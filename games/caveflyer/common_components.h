@@ -2,6 +2,10 @@
 
 #include "ecs.h"
 #include "common_assets.h"
+#include "inline_vector.h"
+
+// Capacities of the inline storage in components
+const int max_particles = 16;
 
 // General
 struct Component_Transform {
@@ -55,7 +59,7 @@ struct Particle {
 };
 
 struct Component_Particles {
-    std::vector<Particle> particles;
+    Inline_Vector<Particle, max_particles> particles;
 
     Vector2 offset{ 0.0f, 0.0f };
     float lifespan = 3.0f;
@@ -63,3 +67,16 @@ struct Component_Particles {
     float spawn_time = 0.3f;
     bool enabled = true;
 };
+
+// Component types of the game, in signature bit order
+struct Component_List : Type_List<
+    Component_Transform,
+    Component_Collision,
+    Component_Dynamics,
+    Component_Sprite,
+    Component_Mob_AI,
+    Component_Hazard,
+    Component_Goal,
+    Component_Agent,
+    Component_Particles
+> {};
@@ -4,18 +4,15 @@
 
 #include "helpers.h"
 
-void System_Sprite_Render::update(float dt) {
-    if (render_entities.size() != entities.size())
-        render_entities.resize(entities.size());
-
-    int index = 0;
+// Walls
+static const Collision_Mask wall_mask = make_collision_mask({ { wall, full } });
 
-    for (auto const &e : entities) {
-        auto &sprite = c.get_component<Component_Sprite>(e);
+void System_Sprite_Render::update(float dt) {
+    render_entities.clear();
 
-        render_entities[index] = std::make_pair(sprite.z, e);
-        index++;
-    }
+    c->view<Component_Sprite>().each([&](Entity e, Component_Sprite &sprite) {
+        render_entities.push_back(std::make_pair(sprite.z, e));
+    });
     
     // Sort sprites
     std::sort(render_entities.begin(), render_entities.end(), [](const std::pair<float, Entity> &left, const std::pair<float, Entity> &right) {
@@ -28,8 +25,8 @@ void System_Sprite_Render::render(Sprite_Render_Mode mode) {
     for (size_t i = 0; i < render_entities.size(); i++) {
         Entity e = render_entities[i].second;
 
-        auto const &sprite = c.get_component<Component_Sprite>(e);
-        auto const &transform = c.get_component<Component_Transform>(e);
+        auto const &sprite = c->get_component<Component_Sprite>(e);
+        auto const &transform = c->get_component<Component_Transform>(e);
 
         if (sprite.texture == nullptr)
             continue;
@@ -43,18 +40,18 @@ void System_Sprite_Render::render(Sprite_Render_Mode mode) {
         float scale = transform.scale * sprite.scale;
 
         // If visible
-        gr.render_texture(sprite.texture, (Vector2){ (transform.position.x + sprite.position.x) * unit_to_pixels, (transform.position.y + sprite.position.y) * unit_to_pixels }, scale * unit_to_pixels / sprite.texture->width, 1.0f, sprite.flip_x);
+        gr->render_texture(sprite.texture, (Vector2){ (transform.position.x + sprite.position.x) * unit_to_pixels, (transform.position.y + sprite.position.y) * unit_to_pixels }, scale * unit_to_pixels / sprite.texture->width, 1.0f, sprite.flip_x);
     }
 }
 
 void System_Mob_AI::update(float dt) {
     // Get tile map system
-    std::shared_ptr<System_Tilemap> tilemap = c.system_manager.get_system<System_Tilemap>();
+    std::shared_ptr<System_Tilemap> tilemap = c->system_manager.get_system<System_Tilemap>();
 
     for (auto const &e : entities) {
-        auto &transform = c.get_component<Component_Transform>(e);
-        auto &dynamics = c.get_component<Component_Dynamics>(e);
-        auto &collision = c.get_component<Component_Collision>(e);
+        auto &transform = c->get_component<Component_Transform>(e);
+        auto &dynamics = c->get_component<Component_Dynamics>(e);
+        auto &collision = c->get_component<Component_Collision>(e);
     
         transform.position.x += dynamics.velocity.x * dt;
         transform.position.y += dynamics.velocity.y * dt;
@@ -63,9 +60,7 @@ void System_Mob_AI::update(float dt) {
         Rectangle world_collision{ transform.position.x + collision.bounds.x, transform.position.y + collision.bounds.y, collision.bounds.width, collision.bounds.height };
 
         // If colliding with map
-        std::pair<Vector2, bool> collision_data = tilemap->get_collision(world_collision, [](Tile_ID id) -> Collision_Type {
-            return (id == wall ? full : none);
-        });
+        std::pair<Vector2, bool> collision_data = tilemap->get_collision(world_collision, wall_mask);
 
         if (collision_data.second) {
             // Reverse direction
@@ -101,20 +96,20 @@ std::tuple<bool, bool, int> System_Agent::update(float dt, const std::shared_ptr
     const float explosion_rate = 0.5f;
 
     // Get tile map system
-    std::shared_ptr<System_Tilemap> tilemap = c.system_manager.get_system<System_Tilemap>();
+    std::shared_ptr<System_Tilemap> tilemap = c->system_manager.get_system<System_Tilemap>();
 
     assert(entities.size() == 1); // Only one player
 
     for (auto const &e : entities) {
-        auto &agent = c.get_component<Component_Agent>(e);
+        auto &agent = c->get_component<Component_Agent>(e);
 
         // Set action
         agent.action = action;
 
-        auto &transform = c.get_component<Component_Transform>(e);
-        auto &dynamics = c.get_component<Component_Dynamics>(e);
+        auto &transform = c->get_component<Component_Transform>(e);
+        auto &dynamics = c->get_component<Component_Dynamics>(e);
 
-        const auto &collision = c.get_component<Component_Collision>(e);
+        const auto &collision = c->get_component<Component_Collision>(e);
 
         float movement_x = (agent.action == 6 || agent.action == 7 || agent.action == 8) - (agent.action == 0 || agent.action == 1 || agent.action == 2);
         float movement_y =  (agent.action == 2 || agent.action == 5 || agent.action == 8) - (agent.action == 0 || agent.action == 3 || agent.action == 6);
@@ -158,9 +153,7 @@ std::tuple<bool, bool, int> System_Agent::update(float dt, const std::shared_ptr
         // World space collision
         Rectangle world_collision{ transform.position.x + collision.bounds.x, transform.position.y + collision.bounds.y, collision.bounds.width, collision.bounds.height };
 
-        std::pair<Vector2, bool> collision_data = tilemap->get_collision(world_collision, [](Tile_ID id) -> Collision_Type {
-            return (id == wall ? full : none);
-        });
+        std::pair<Vector2, bool> collision_data = tilemap->get_collision(world_collision, wall_mask);
 
         // If was moved up, on ground
         Vector2 delta_position{ collision_data.first.x - world_collision.x, collision_data.first.y - world_collision.y };
@@ -179,25 +172,28 @@ std::tuple<bool, bool, int> System_Agent::update(float dt, const std::shared_ptr
         if (delta_position.y != 0.0f)
             dynamics.velocity.y = 0.0f;
 
-        // Go through all hazards
+        // Hazards by position, for the agent and its bullets
+        hazard_hash.clear();
+
         for (auto const &h : hazard->get_entities()) {
-            auto const &hazard_transform = c.get_component<Component_Transform>(h);
-            auto const &hazard_collision = c.get_component<Component_Collision>(h);
+            auto const &hazard_transform = c->get_component<Component_Transform>(h);
+            auto const &hazard_collision = c->get_component<Component_Collision>(h);
 
             // World space
             Rectangle hazard_world_collision{ hazard_transform.position.x + hazard_collision.bounds.x, hazard_transform.position.y + hazard_collision.bounds.y, hazard_collision.bounds.width, hazard_collision.bounds.height };
 
-            if (check_collision(world_collision, hazard_world_collision)) {
-                alive = false;
-
-                break;
-            }
+            hazard_hash.insert(h, hazard_world_collision);
         }
 
+        hazard_hash.query(world_collision, hazard_hits);
+
+        if (!hazard_hits.empty())
+            alive = false;
+
         // Go through all goals
         for (auto const &g : goal->get_entities()) {
-            auto const &goal_transform = c.get_component<Component_Transform>(g);
-            auto const &goal_collision = c.get_component<Component_Collision>(g);
+            auto const &goal_transform = c->get_component<Component_Transform>(g);
+            auto const &goal_collision = c->get_component<Component_Collision>(g);
 
             // World space
             Rectangle goal_world_collision{ goal_transform.position.x + goal_collision.bounds.x, goal_transform.position.y + goal_collision.bounds.y, goal_collision.bounds.width, goal_collision.bounds.height };
@@ -210,8 +206,8 @@ std::tuple<bool, bool, int> System_Agent::update(float dt, const std::shared_ptr
         }
 
         // Camera follows the agent
-        gr.camera_position.x = transform.position.x * unit_to_pixels;
-        gr.camera_position.y = transform.position.y * unit_to_pixels;
+        gr->camera_position.x = transform.position.x * unit_to_pixels;
+        gr->camera_position.y = transform.position.y * unit_to_pixels;
 
         // Control bullets
         for (int i = 0; i < num_bullets; i++) {
@@ -225,9 +221,7 @@ std::tuple<bool, bool, int> System_Agent::update(float dt, const std::shared_ptr
             if (bullet.frame == 0.0f) {
                 Rectangle world_collision{ bullet.pos.x - 0.01f, bullet.pos.y - 0.01f, 0.02f, 0.02f };
 
-                std::pair<Vector2, bool> collision_data = tilemap->get_collision(world_collision, [](Tile_ID id) -> Collision_Type {
-                    return (id == wall ? full : none);
-                });
+                std::pair<Vector2, bool> collision_data = tilemap->get_collision(world_collision, wall_mask);
 
                 if (collision_data.second) {
                     // Set velocity to 0 and animate
@@ -235,35 +229,26 @@ std::tuple<bool, bool, int> System_Agent::update(float dt, const std::shared_ptr
                     bullet.frame = 1.0f;
                 }
 
-                std::vector<Entity> to_destroy;
-
-                // If collide with hazard
-                for (Entity h : hazard->get_entities()) {
-                    const Component_Hazard &hazard = c.get_component<Component_Hazard>(h);
-                    
-                    const Component_Transform &hazard_transform = c.get_component<Component_Transform>(h);
-                    const Component_Collision &hazard_collision = c.get_component<Component_Collision>(h);
+                // If collide with hazard (the first one, in entity order)
+                hazard_hash.query(world_collision, hazard_hits);
 
-                    Rectangle hazard_rect{ hazard_transform.position.x + hazard_collision.bounds.x, hazard_transform.position.y + hazard_collision.bounds.y, hazard_collision.bounds.width, hazard_collision.bounds.height };
+                if (!hazard_hits.empty()) {
+                    Entity h = hazard_hits[0];
 
-                    if (check_collision(world_collision, hazard_rect)) {
-                        // Set velocity to 0 and animate
-                        bullet.vel = { 0.0f, 0.0f };
-                        bullet.frame = 1.0f;
+                    const Component_Hazard &hazard = c->get_component<Component_Hazard>(h);
 
-                        if (hazard.destroyable) {
-                            // Destroy the hazard
-                            to_destroy.push_back(h);
+                    // Set velocity to 0 and animate
+                    bullet.vel = { 0.0f, 0.0f };
+                    bullet.frame = 1.0f;
 
-                            targets_destroyed++;
-                        }
+                    if (hazard.destroyable) {
+                        // Destroy the hazard
+                        c->destroy_entity(h);
+                        hazard_hash.remove(h);
 
-                        break;
+                        targets_destroyed++;
                     }
                 }
-
-                for (int i = 0; i < to_destroy.size(); i++)
-                    c.destroy_entity(to_destroy[i]);
             }
 
             // Move
@@ -280,7 +265,7 @@ std::tuple<bool, bool, int> System_Agent::update(float dt, const std::shared_ptr
         }
             
         // Enable particles on jump
-        auto &particles = c.get_component<Component_Particles>(e);
+        auto &particles = c->get_component<Component_Particles>(e);
 
         particles.enabled = movement_y > 0.0f;
     }
@@ -292,9 +277,9 @@ void System_Agent::render() {
     assert(entities.size() == 1); // Only one player
 
     for (auto const &e : entities) {
-        auto const &agent = c.get_component<Component_Agent>(e);
-        auto const &transform = c.get_component<Component_Transform>(e);
-        auto const &dynamics = c.get_component<Component_Dynamics>(e);
+        auto const &agent = c->get_component<Component_Agent>(e);
+        auto const &transform = c->get_component<Component_Transform>(e);
+        auto const &dynamics = c->get_component<Component_Dynamics>(e);
 
         // Render bullets
         for (int i = 0; i < num_bullets; i++) {
@@ -314,14 +299,14 @@ void System_Agent::render() {
 
             const float size = 0.1f;
 
-            gr.render_texture_rotated(texture, { bullet.pos.x * unit_to_pixels - size * texture->width * 0.5f, bullet.pos.y * unit_to_pixels - size * texture->height * 0.5f }, bullet.rotation + M_PI * 0.5f, size);
+            gr->render_texture_rotated(texture, { bullet.pos.x * unit_to_pixels - size * texture->width * 0.5f, bullet.pos.y * unit_to_pixels - size * texture->height * 0.5f }, bullet.rotation + M_PI * 0.5f, size);
         }
 
         // Render ship
         {
             const float size = 0.15f;
 
-            gr.render_texture_rotated(&ship_texture, { transform.position.x * unit_to_pixels - size * ship_texture.width * 0.5f, transform.position.y * unit_to_pixels - size * ship_texture.height * 0.5f }, transform.rotation + M_PI * 0.5f, size);
+            gr->render_texture_rotated(&ship_texture, { transform.position.x * unit_to_pixels - size * ship_texture.width * 0.5f, transform.position.y * unit_to_pixels - size * ship_texture.height * 0.5f }, transform.rotation + M_PI * 0.5f, size);
         }
     }
 }
@@ -331,10 +316,7 @@ void System_Particles::init() {
 }
 
 void System_Particles::update(float dt) {
-    for (auto const &e : entities) {
-        auto const &transform = c.get_component<Component_Transform>(e);
-        auto &particles = c.get_component<Component_Particles>(e);
-
+    c->view<Component_Particles, Component_Transform>().each([&](Entity, Component_Particles &particles, const Component_Transform &transform) {
         int dead_index = -1;
     
         for (int i = 0; i < particles.particles.size(); i++) {
@@ -368,7 +350,7 @@ void System_Particles::update(float dt) {
             p.position.x = transform.position.x + rotated_offset.x;
             p.position.y = transform.position.y + rotated_offset.y;
         }
-    }
+    });
 }
 
 void System_Particles::render() {
@@ -376,7 +358,7 @@ void System_Particles::render() {
     const float base_scale = 1.0f;
 
     for (auto const &e : entities) {
-        auto const &particles = c.get_component<Component_Particles>(e);
+        auto const &particles = c->get_component<Component_Particles>(e);
 
         for (int i = 0; i < particles.particles.size(); i++) {
             const Particle &p = particles.particles[i];
@@ -391,7 +373,7 @@ void System_Particles::render() {
             float shift = life_ratio * 2.0f;
             float size = scale * unit_to_pixels / particle_texture.width;
 
-            gr.render_texture_rotated(&particle_texture, (Vector2){ (p.position.x + p.dir.x * shift) * unit_to_pixels - size * particle_texture.width * 0.5f, (p.position.y + p.dir.y * shift) * unit_to_pixels - size * particle_texture.height * 0.5f }, p.rotation, size, alpha);
+            gr->render_texture_rotated(&particle_texture, (Vector2){ (p.position.x + p.dir.x * shift) * unit_to_pixels - size * particle_texture.width * 0.5f, (p.position.y + p.dir.y * shift) * unit_to_pixels - size * particle_texture.height * 0.5f }, p.rotation, size, alpha);
         }
     }
 }
@@ -28,6 +28,20 @@ public:
     void clear_render() {
         render_entities.clear();
     }
+
+    void save_state(State_Writer &writer) const override {
+        writer.write(render_entities, max_entities);
+    }
+
+    void load_state(State_Reader &reader) override {
+        reader.read(render_entities, max_entities);
+    }
+
+    void copy_state(const System &other) override {
+        const System_Sprite_Render &other_system = static_cast<const System_Sprite_Render&>(other);
+
+        render_entities = other_system.render_entities;
+    }
 };
 
 // -------------------- Hazards --------------------
@@ -35,7 +49,7 @@ public:
 // Empty mostly, since just need it to collect hazards for agent system
 class System_Hazard : public System {
 public:
-    std::unordered_set<Entity> &get_entities() {
+    const Entity_List &get_entities() const {
         return entities;
     }
 };
@@ -50,7 +64,7 @@ public:
 // Empty mostly, since just need it to collect goals for agent system
 class System_Goal : public System {
 public:
-    std::unordered_set<Entity> &get_entities() {
+    const Entity_List &get_entities() const {
         return entities;
     }
 };
@@ -76,6 +90,10 @@ private:
     int num_bullets = 0;
     float bullet_timer = 0.0f;
 
+    // Hazards by position, filled every update
+    Spatial_Hash hazard_hash{ 1.0f };
+    std::vector<Entity> hazard_hits;
+
 public:
     void init(); // Needs to load sprites
 
@@ -88,6 +106,29 @@ public:
         num_bullets = 0;
         bullet_timer = 0.0f;
     }
+
+    void save_state(State_Writer &writer) const override {
+        writer.write(bullets);
+        writer.write(next_bullet);
+        writer.write(num_bullets);
+        writer.write(bullet_timer);
+    }
+
+    void load_state(State_Reader &reader) override {
+        reader.read(bullets);
+        reader.read(next_bullet);
+        reader.read(num_bullets);
+        reader.read(bullet_timer);
+    }
+
+    void copy_state(const System &other) override {
+        const System_Agent &other_system = static_cast<const System_Agent&>(other);
+
+        bullets = other_system.bullets;
+        next_bullet = other_system.next_bullet;
+        num_bullets = other_system.num_bullets;
+        bullet_timer = other_system.bullet_timer;
+    }
 };
 
 // ------------------- Particles ------------------
@@ -0,0 +1,116 @@
+#include "observation.h"
+
+#include "renderer.h"
+
+#include <cstring>
+
+void Observation_Builder::init(const Observation_Format &format) {
+    this->format = format;
+
+    frames.resize(format.frame_stack > 1 ? format.get_size() : 0);
+
+    newest = 0;
+    restarted = true;
+}
+
+void Observation_Builder::convert(SDL_Surface* surface, uint8_t* frame) const {
+    int factor = surface->w / format.size;
+
+    // Plain copies of the render target
+    if (factor == 1 && !format.grayscale && !format.chw) {
+        if (format.rgba)
+            copy_surface_rgba(surface, frame);
+        else
+            copy_surface_rgb(surface, frame);
+
+        return;
+    }
+
+    int channels = format.get_frame_channels();
+    int area = factor * factor;
+    int plane_size = format.size * format.size;
+
+    SDL_LockSurface(surface);
+
+    const uint8_t* pixels = (const uint8_t*)surface->pixels;
+
+    for (int y = 0; y < format.size; y++)
+        for (int x = 0; x < format.size; x++) {
+            // Box filter
+            int sums[4] = { 0, 0, 0, 0 };
+
+            for (int dy = 0; dy < factor; dy++) {
+                const uint8_t* row = pixels + (y * factor + dy) * surface->pitch + x * factor * 4;
+
+                for (int dx = 0; dx < factor; dx++)
+                    for (int c = 0; c < 4; c++)
+                        sums[c] += row[c + 4 * dx];
+            }
+
+            int values[4];
+
+            for (int c = 0; c < 4; c++)
+                values[c] = (sums[c] + area / 2) / area;
+
+            // Luma (BT.601)
+            if (format.grayscale)
+                values[0] = (77 * values[0] + 150 * values[1] + 29 * values[2] + 128) >> 8;
+
+            int pixel = x + y * format.size;
+
+            for (int c = 0; c < channels; c++)
+                frame[format.chw ? pixel + c * plane_size : c + channels * pixel] = values[c];
+        }
+
+    SDL_UnlockSurface(surface);
+}
+
+void Observation_Builder::build(SDL_Surface* surface, uint8_t* buffer) {
+    if (format.frame_stack == 1) {
+        convert(surface, buffer);
+
+        return;
+    }
+
+    int frame_size = format.get_frame_size();
+
+    newest = (newest + 1) % format.frame_stack;
+
+    convert(surface, &frames[newest * frame_size]);
+
+    if (restarted) {
+        for (int i = 0; i < format.frame_stack; i++) {
+            if (i != newest)
+                memcpy(&frames[i * frame_size], &frames[newest * frame_size], frame_size);
+        }
+
+        restarted = false;
+    }
+
+    stack(buffer);
+}
+
+void Observation_Builder::stack(uint8_t* buffer) const {
+    int frame_size = format.get_frame_size();
+
+    // Oldest first
+    if (format.chw) {
+        for (int i = 0; i < format.frame_stack; i++)
+            memcpy(buffer + i * frame_size, &frames[((newest + 1 + i) % format.frame_stack) * frame_size], frame_size);
+    }
+    else {
+        int channels = format.get_frame_channels();
+        int num_pixels = format.size * format.size;
+        int stride = channels * format.frame_stack;
+
+        for (int i = 0; i < format.frame_stack; i++) {
+            const uint8_t* frame = &frames[((newest + 1 + i) % format.frame_stack) * frame_size];
+
+            uint8_t* stacked = buffer + i * channels;
+
+            for (int p = 0; p < num_pixels; p++)
+                for (int c = 0; c < channels; c++)
+                    stacked[c + p * stride] = frame[c + p * channels];
+        }
+    }
+}
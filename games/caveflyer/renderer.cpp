@@ -2,6 +2,16 @@
 
 #include "common_assets.h"
 
+#include <algorithm>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RENDERER_X86
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 void Renderer::render_texture(Asset_Texture* texture, const Vector2 &position, float scale, float alpha, bool flip_horizontal, bool flip_vertical) {
     SDL_Renderer* renderer = get_renderer();
 
@@ -51,11 +61,6 @@ void Renderer::render_texture(Asset_Texture* texture, const Vector2 &position, f
         dst_rect.h = camera_size.y - dst_rect.y;
     }
 
-    SDL_Texture* current_texture = rendering_obs ? texture->obs_texture : texture->window_texture;
-
-    if (alpha != 1.0f)
-        SDL_SetTextureAlphaMod(current_texture, 255 * alpha);
-
     int padding = std::ceil(1.0f / (scale * camera_scale));
 
     SDL_Rect src_recti{ static_cast<int>(std::floor(src_rect.x)), static_cast<int>(std::floor(src_rect.y)), static_cast<int>(std::ceil(src_rect.w)) + padding, static_cast<int>(std::ceil(src_rect.h)) + padding };
@@ -75,32 +80,366 @@ void Renderer::render_texture(Asset_Texture* texture, const Vector2 &position, f
 
     src_rect = { static_cast<float>(src_recti.x), static_cast<float>(src_recti.y), static_cast<float>(src_recti.w), static_cast<float>(src_recti.h) };
 
-    SDL_RenderTextureRotated(renderer, rendering_obs ? texture->obs_texture : texture->window_texture, &src_rect, &dst_rect, 0.0f, NULL, flip_horizontal ? SDL_FLIP_HORIZONTAL : (flip_vertical ? SDL_FLIP_VERTICAL : SDL_FLIP_NONE));
+    if (rendering_obs) {
+        blit_obs(texture, src_rect, dst_rect, alpha, flip_horizontal, flip_vertical && !flip_horizontal);
+
+        return;
+    }
+
+    // Clip to the texture as SDL would, then move to where it is in its SDL texture (an atlas may hold others around it)
+    float src_x0 = std::max(0.0f, src_rect.x);
+    float src_y0 = std::max(0.0f, src_rect.y);
+    float src_x1 = std::min(src_rect.x + src_rect.w, static_cast<float>(texture->width));
+    float src_y1 = std::min(src_rect.y + src_rect.h, static_cast<float>(texture->height));
+
+    if (src_x0 >= src_x1 || src_y0 >= src_y1)
+        return;
+
+    const SDL_Rect &region = texture->get_region();
+
+    src_rect = { region.x + src_x0, region.y + src_y0, src_x1 - src_x0, src_y1 - src_y0 };
+
+    SDL_Texture* window_texture = texture->get_window_texture();
 
     if (alpha != 1.0f)
-        SDL_SetTextureAlphaMod(current_texture, 255);
+        SDL_SetTextureAlphaMod(window_texture, 255 * alpha);
+
+    SDL_RenderTextureRotated(renderer, window_texture, &src_rect, &dst_rect, 0.0f, NULL, flip_horizontal ? SDL_FLIP_HORIZONTAL : (flip_vertical ? SDL_FLIP_VERTICAL : SDL_FLIP_NONE));
+
+    if (alpha != 1.0f)
+        SDL_SetTextureAlphaMod(window_texture, 255);
 }
 
 void Renderer::render_texture_rotated(Asset_Texture* texture, const Vector2 &position, float rotation, float scale, float alpha) {
     SDL_Renderer* renderer = get_renderer();
 
-    SDL_FRect src_rect{ 0.0f, 0.0f, static_cast<float>(texture->width), static_cast<float>(texture->height) };
+    const SDL_Rect &region = texture->get_region();
+
+    SDL_FRect src_rect{ static_cast<float>(region.x), static_cast<float>(region.y), static_cast<float>(region.w), static_cast<float>(region.h) };
 
     SDL_FRect dst_rect{ (position.x - camera_position.x) * camera_scale + camera_size.x * 0.5f, (position.y - camera_position.y) * camera_scale + camera_size.y * 0.5f,
         texture->width * scale * camera_scale, texture->height * scale * camera_scale };
 
-    SDL_Texture* current_texture = rendering_obs ? texture->obs_texture : texture->window_texture;
+    SDL_Texture* current_texture = rendering_obs ? texture->get_obs_texture() : texture->get_window_texture();
 
     if (alpha != 1.0f)
         SDL_SetTextureAlphaMod(current_texture, 255 * alpha);
 
-    SDL_RenderTextureRotated(renderer, rendering_obs ? texture->obs_texture : texture->window_texture, NULL, &dst_rect, rotation * 180.0f / M_PI, NULL, SDL_FLIP_NONE);
+    SDL_RenderTextureRotated(renderer, current_texture, &src_rect, &dst_rect, rotation * 180.0f / M_PI, NULL, SDL_FLIP_NONE);
 
     if (alpha != 1.0f)
         SDL_SetTextureAlphaMod(current_texture, 255);
 }
 
+void Renderer::blit_obs(Asset_Texture* texture, const SDL_FRect &src_rect, const SDL_FRect &dst_rect, float alpha, bool flip_horizontal, bool flip_vertical) {
+    int alpha_mod = static_cast<int>(255 * alpha); // Truncated like SDL_SetTextureAlphaMod
+
+    if (alpha_mod <= 0 || dst_rect.w <= 0.0f || dst_rect.h <= 0.0f)
+        return;
+
+    // Like SDL, clip the source to the texture and stretch what is left over the whole destination
+    float src_x = std::max(0.0f, src_rect.x);
+    float src_y = std::max(0.0f, src_rect.y);
+    float src_w = std::min(src_rect.x + src_rect.w, static_cast<float>(texture->width)) - src_x;
+    float src_h = std::min(src_rect.y + src_rect.h, static_cast<float>(texture->height)) - src_y;
+
+    if (src_w <= 0.0f || src_h <= 0.0f)
+        return;
+
+    // Destination pixels whose centers are covered
+    int dst_x0 = std::max(0, static_cast<int>(std::ceil(dst_rect.x - 0.5f)));
+    int dst_y0 = std::max(0, static_cast<int>(std::ceil(dst_rect.y - 0.5f)));
+    int dst_x1 = std::min(obs_target->w, static_cast<int>(std::ceil(dst_rect.x + dst_rect.w - 0.5f)));
+    int dst_y1 = std::min(obs_target->h, static_cast<int>(std::ceil(dst_rect.y + dst_rect.h - 0.5f)));
+
+    if (dst_x0 >= dst_x1 || dst_y0 >= dst_y1)
+        return;
+
+    // Source coordinates of the pixel centers in 16.16 fixed-point, stepped per destination pixel
+    float scale_x = src_w / dst_rect.w;
+    float scale_y = src_h / dst_rect.h;
+
+    const uint32_t* pixels = texture->get_pixels();
+    int pixels_pitch = texture->get_pitch();
+
+    // When shrinking, sample a mip of the size the whole texture has on screen instead, so that it is close to 1:1.
+    // Taken from the unclipped rectangles, clipping would make it jitter with the camera
+    int mip_width = std::min(texture->width, std::max(1, static_cast<int>(std::lround(texture->width * dst_rect.w / src_rect.w))));
+    int mip_height = std::min(texture->height, std::max(1, static_cast<int>(std::lround(texture->height * dst_rect.h / src_rect.h))));
+
+    if (mip_width < texture->width || mip_height < texture->height) {
+        pixels = texture->get_mip(mip_width, mip_height);
+        pixels_pitch = mip_width;
+
+        float ratio_x = static_cast<float>(mip_width) / texture->width;
+        float ratio_y = static_cast<float>(mip_height) / texture->height;
+
+        src_x *= ratio_x;
+        src_y *= ratio_y;
+        src_w *= ratio_x;
+        src_h *= ratio_y;
+        scale_x *= ratio_x;
+        scale_y *= ratio_y;
+    }
+
+    int32_t step_u = std::lround(scale_x * 65536.0f);
+    int32_t step_v = std::lround(scale_y * 65536.0f);
+    int32_t start_u = std::lround((src_x + (dst_x0 + 0.5f - dst_rect.x) * scale_x) * 65536.0f);
+    int32_t v = std::lround((src_y + (dst_y0 + 0.5f - dst_rect.y) * scale_y) * 65536.0f);
+
+    // Mirror within the source rectangle
+    if (flip_horizontal) {
+        start_u = std::lround((2.0f * src_x + src_w) * 65536.0f) - start_u;
+        step_u = -step_u;
+    }
+
+    if (flip_vertical) {
+        v = std::lround((2.0f * src_y + src_h) * 65536.0f) - v;
+        step_v = -step_v;
+    }
+
+    int min_x = static_cast<int>(src_x);
+    int min_y = static_cast<int>(src_y);
+    int max_x = static_cast<int>(std::ceil(src_x + src_w)) - 1;
+    int max_y = static_cast<int>(std::ceil(src_y + src_h)) - 1;
+
+    int num_pixels = dst_x1 - dst_x0;
+
+    blit_row.resize(num_pixels);
+
+    // Anything still queued on the SDL side (clear, rotated draws) has to land first
+    SDL_FlushRenderer(obs_renderer);
+
+    SDL_LockSurface(obs_target);
+
+    for (int y = dst_y0; y < dst_y1; y++, v += step_v) {
+        const uint32_t* src_row = &pixels[std::min(max_y, std::max(min_y, v >> 16)) * pixels_pitch];
+
+        int32_t u = start_u;
+
+        for (int i = 0; i < num_pixels; i++, u += step_u)
+            blit_row[i] = src_row[std::min(max_x, std::max(min_x, u >> 16))];
+
+        blend_rgba(reinterpret_cast<const uint8_t*>(blit_row.data()), static_cast<uint8_t*>(obs_target->pixels) + y * obs_target->pitch + dst_x0 * 4, num_pixels, alpha_mod);
+    }
+
+    SDL_UnlockSurface(obs_target);
+}
+
+SDL_Texture* Renderer::get_atlas_texture(const std::shared_ptr<const Texture_Data> &atlas, bool obs) {
+    Atlas_Textures &textures = atlas_textures[atlas.get()];
+
+    textures.atlas = atlas;
+
+    SDL_Texture* &texture = obs ? textures.obs_texture : textures.window_texture;
+
+    if (texture == nullptr)
+        texture = create_sdl_texture(obs ? obs_renderer : window_renderer, atlas->pixels, atlas->width, atlas->height);
+
+    return texture;
+}
+
 Renderer::~Renderer() {
+    for (auto const &pair : atlas_textures) {
+        if (pair.second.obs_texture != nullptr)
+            SDL_DestroyTexture(pair.second.obs_texture);
+
+        if (pair.second.window_texture != nullptr)
+            SDL_DestroyTexture(pair.second.window_texture);
+    }
+}
+
+thread_local Renderer* gr = nullptr;
+
+static void rgba_to_rgb_scalar(const uint8_t* src, uint8_t* dst, int num_pixels) {
+    for (int i = 0; i < num_pixels; i++) {
+        dst[0 + 3 * i] = src[0 + 4 * i];
+        dst[1 + 3 * i] = src[1 + 4 * i];
+        dst[2 + 3 * i] = src[2 + 4 * i];
+    }
 }
 
-Renderer gr;
+#if defined(RENDERER_X86)
+__attribute__((target("ssse3")))
+static void rgba_to_rgb_ssse3(const uint8_t* src, uint8_t* dst, int num_pixels) {
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+    int i = 0;
+
+    // 4 pixels per 16 byte store, of which the last 4 bytes are overwritten by the next store. Stop early enough to not write past the end
+    for (; i + 6 <= num_pixels; i += 4)
+        _mm_storeu_si128((__m128i*)(dst + 3 * i), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + 4 * i)), shuffle));
+
+    rgba_to_rgb_scalar(src + 4 * i, dst + 3 * i, num_pixels - i);
+}
+
+__attribute__((target("avx2")))
+static void rgba_to_rgb_avx2(const uint8_t* src, uint8_t* dst, int num_pixels) {
+    const __m256i shuffle = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    const __m256i permute = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7); // Join the packed 12 bytes of both lanes
+
+    int i = 0;
+
+    // 8 pixels per 32 byte store, of which the last 8 bytes are overwritten by the next store
+    for (; i + 11 <= num_pixels; i += 8) {
+        __m256i pixels = _mm256_loadu_si256((const __m256i*)(src + 4 * i));
+
+        _mm256_storeu_si256((__m256i*)(dst + 3 * i), _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(pixels, shuffle), permute));
+    }
+
+    rgba_to_rgb_ssse3(src + 4 * i, dst + 3 * i, num_pixels - i);
+}
+#elif defined(__ARM_NEON)
+static void rgba_to_rgb_neon(const uint8_t* src, uint8_t* dst, int num_pixels) {
+    int i = 0;
+
+    for (; i + 16 <= num_pixels; i += 16) {
+        uint8x16x4_t rgba = vld4q_u8(src + 4 * i);
+        uint8x16x3_t rgb = { { rgba.val[0], rgba.val[1], rgba.val[2] } };
+
+        vst3q_u8(dst + 3 * i, rgb);
+    }
+
+    rgba_to_rgb_scalar(src + 4 * i, dst + 3 * i, num_pixels - i);
+}
+#endif
+
+void rgba_to_rgb(const uint8_t* src, uint8_t* dst, int num_pixels) {
+#if defined(RENDERER_X86)
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    static const bool has_ssse3 = __builtin_cpu_supports("ssse3");
+
+    if (has_avx2)
+        rgba_to_rgb_avx2(src, dst, num_pixels);
+    else if (has_ssse3)
+        rgba_to_rgb_ssse3(src, dst, num_pixels);
+    else
+        rgba_to_rgb_scalar(src, dst, num_pixels);
+#elif defined(__ARM_NEON)
+    rgba_to_rgb_neon(src, dst, num_pixels);
+#else
+    rgba_to_rgb_scalar(src, dst, num_pixels);
+#endif
+}
+
+void copy_surface_rgb(SDL_Surface* surface, uint8_t* dst) {
+    SDL_LockSurface(surface);
+
+    const uint8_t* pixels = (const uint8_t*)surface->pixels;
+
+    // In one go unless rows are padded
+    if (surface->pitch == surface->w * 4)
+        rgba_to_rgb(pixels, dst, surface->w * surface->h);
+    else {
+        for (int y = 0; y < surface->h; y++)
+            rgba_to_rgb(pixels + y * surface->pitch, dst + y * surface->w * 3, surface->w);
+    }
+
+    SDL_UnlockSurface(surface);
+}
+
+void copy_surface_rgba(SDL_Surface* surface, uint8_t* dst) {
+    SDL_LockSurface(surface);
+
+    const uint8_t* pixels = (const uint8_t*)surface->pixels;
+
+    for (int y = 0; y < surface->h; y++)
+        memcpy(dst + y * surface->w * 4, pixels + y * surface->pitch, surface->w * 4);
+
+    SDL_UnlockSurface(surface);
+}
+
+// x / 255 rounded, exact for x in [0, 255 * 255]
+static inline int div_255(int x) {
+    x += 128;
+
+    return (x + (x >> 8)) >> 8;
+}
+
+static void blend_rgba_scalar(const uint8_t* src, uint8_t* dst, int num_pixels, int alpha_mod) {
+    for (int i = 0; i < num_pixels; i++) {
+        int a = div_255(src[3 + 4 * i] * alpha_mod);
+
+        for (int c = 0; c < 3; c++)
+            dst[c + 4 * i] = div_255(src[c + 4 * i] * a + dst[c + 4 * i] * (255 - a));
+
+        dst[3 + 4 * i] = 255;
+    }
+}
+
+#if defined(__SSE2__)
+static inline __m128i div_255_sse2(__m128i x) {
+    x = _mm_add_epi16(x, _mm_set1_epi16(128));
+
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+// Two pixels widened to 16 bits per channel
+static inline __m128i blend_rgba_sse2(__m128i src, __m128i dst, __m128i alpha_mod) {
+    __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(src, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+
+    a = div_255_sse2(_mm_mullo_epi16(a, alpha_mod));
+
+    return div_255_sse2(_mm_add_epi16(_mm_mullo_epi16(src, a), _mm_mullo_epi16(dst, _mm_sub_epi16(_mm_set1_epi16(255), a))));
+}
+
+static void blend_rgba_sse2(const uint8_t* src, uint8_t* dst, int num_pixels, int alpha_mod) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i mod = _mm_set1_epi16(alpha_mod);
+    const __m128i opaque = _mm_set1_epi32(static_cast<int>(0xff000000));
+
+    int i = 0;
+
+    for (; i + 4 <= num_pixels; i += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i*)(src + 4 * i));
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + 4 * i));
+
+        __m128i low = blend_rgba_sse2(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero), mod);
+        __m128i high = blend_rgba_sse2(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero), mod);
+
+        _mm_storeu_si128((__m128i*)(dst + 4 * i), _mm_or_si128(_mm_packus_epi16(low, high), opaque));
+    }
+
+    blend_rgba_scalar(src + 4 * i, dst + 4 * i, num_pixels - i, alpha_mod);
+}
+#elif defined(__ARM_NEON)
+static inline uint8x8_t div_255_neon(uint16x8_t x) {
+    x = vaddq_u16(x, vdupq_n_u16(128));
+
+    return vshrn_n_u16(vsraq_n_u16(x, x, 8), 8);
+}
+
+static void blend_rgba_neon(const uint8_t* src, uint8_t* dst, int num_pixels, int alpha_mod) {
+    const uint8x8_t mod = vdup_n_u8(alpha_mod);
+
+    int i = 0;
+
+    for (; i + 8 <= num_pixels; i += 8) {
+        uint8x8x4_t s = vld4_u8(src + 4 * i);
+        uint8x8x4_t d = vld4_u8(dst + 4 * i);
+
+        uint8x8_t a = div_255_neon(vmull_u8(s.val[3], mod));
+        uint8x8_t inverse = vmvn_u8(a); // 255 - a
+
+        for (int c = 0; c < 3; c++)
+            d.val[c] = div_255_neon(vmlal_u8(vmull_u8(s.val[c], a), d.val[c], inverse));
+
+        d.val[3] = vdup_n_u8(255);
+
+        vst4_u8(dst + 4 * i, d);
+    }
+
+    blend_rgba_scalar(src + 4 * i, dst + 4 * i, num_pixels - i, alpha_mod);
+}
+#endif
+
+void blend_rgba(const uint8_t* src, uint8_t* dst, int num_pixels, int alpha_mod) {
+#if defined(__SSE2__)
+    blend_rgba_sse2(src, dst, num_pixels, alpha_mod);
+#elif defined(__ARM_NEON)
+    blend_rgba_neon(src, dst, num_pixels, alpha_mod);
+#else
+    blend_rgba_scalar(src, dst, num_pixels, alpha_mod);
+#endif
+}
@@ -0,0 +1,253 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+static int get_num_cores() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+#ifdef __linux__
+// Cores the calling thread may run on, the one it is on first
+static std::vector<int> get_allowed_cores() {
+    std::vector<int> cores;
+
+    cpu_set_t allowed;
+
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &allowed) != 0)
+        return cores;
+
+    int current = sched_getcpu();
+
+    if (current >= 0 && current < CPU_SETSIZE && CPU_ISSET(current, &allowed))
+        cores.push_back(current);
+
+    for (int core = 0; core < CPU_SETSIZE; core++) {
+        if (CPU_ISSET(core, &allowed) && core != current)
+            cores.push_back(core);
+    }
+
+    return cores;
+}
+#endif
+
+Thread_Pool::Thread_Pool(int num_threads, bool pin_threads) {
+    int num_cores = get_num_cores();
+
+    if (num_threads <= 0)
+        num_threads = num_cores;
+
+    pinned = pin_threads;
+
+    for (int i = 0; i < num_threads; i++)
+        queues.push_back(std::make_unique<Work_Queue>());
+
+#ifdef __linux__
+    // The calling thread is worker 0 and stays where it is. Worker i goes to the i-th allowed core counting from the caller's,
+    // so that with one thread per core no core gets two
+    std::vector<int> cores;
+
+    if (pin_threads)
+        cores = get_allowed_cores();
+#endif
+
+    for (int i = 1; i < num_threads; i++) {
+        threads.emplace_back(&Thread_Pool::run, this, i);
+
+#ifdef __linux__
+        if (!cores.empty()) {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(cores[i % cores.size()], &cpus);
+
+            pthread_setaffinity_np(threads.back().native_handle(), sizeof(cpu_set_t), &cpus);
+        }
+#endif
+    }
+}
+
+Thread_Pool::~Thread_Pool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        stopping = true;
+    }
+
+    start_condition.notify_all();
+
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+}
+
+bool Thread_Pool::matches(int num_threads, bool pin_threads) const {
+    if (num_threads <= 0)
+        num_threads = get_num_cores();
+
+    return num_threads == get_num_threads() && pin_threads == pinned;
+}
+
+bool Thread_Pool::pop(int worker_index, int &index) {
+    // Own work first
+    {
+        Work_Queue &queue = *queues[worker_index];
+
+        std::lock_guard<std::mutex> lock(queue.mutex);
+
+        if (queue.begin < queue.end) {
+            index = queue.begin++;
+
+            return true;
+        }
+    }
+
+    // Steal
+    for (size_t offset = 1; offset < queues.size(); offset++) {
+        Work_Queue &queue = *queues[(worker_index + offset) % queues.size()];
+
+        std::lock_guard<std::mutex> lock(queue.mutex);
+
+        if (queue.begin < queue.end) {
+            index = --queue.end;
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void Thread_Pool::work(int worker_index) {
+    int index;
+
+    while (pop(worker_index, index))
+        (*job)(index);
+}
+
+void Thread_Pool::run(int worker_index) {
+    int current_generation = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+
+            start_condition.wait(lock, [&] { return stopping || generation != current_generation; });
+
+            if (stopping)
+                return;
+
+            current_generation = generation;
+        }
+
+        work(worker_index);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (--num_busy == 0)
+                done_condition.notify_one();
+        }
+    }
+}
+
+void Thread_Pool::parallel_for(int n, const std::function<void(int)> &f) {
+    if (threads.empty() || n <= 1) {
+        for (int i = 0; i < n; i++)
+            f(i);
+
+        return;
+    }
+
+    std::lock_guard<std::mutex> loop_lock(loop_mutex);
+
+    // Even split, stealing evens out the rest
+    for (size_t i = 0; i < queues.size(); i++) {
+        std::lock_guard<std::mutex> lock(queues[i]->mutex);
+
+        queues[i]->begin = static_cast<long>(n) * i / queues.size();
+        queues[i]->end = static_cast<long>(n) * (i + 1) / queues.size();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        job = &f;
+        num_busy = threads.size();
+        generation++;
+    }
+
+    start_condition.notify_all();
+
+    work(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    done_condition.wait(lock, [this] { return num_busy == 0; });
+
+    job = nullptr;
+}
+
+Background_Worker::Background_Worker() {
+    thread = std::thread(&Background_Worker::run, this);
+}
+
+Background_Worker::~Background_Worker() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        stopping = true;
+    }
+
+    start_condition.notify_one();
+
+    thread.join();
+}
+
+void Background_Worker::start(Job* job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        job->done = false;
+
+        queue.push_back(job);
+    }
+
+    start_condition.notify_one();
+}
+
+void Background_Worker::wait(Job* job) {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    done_condition.wait(lock, [job] { return job->done; });
+}
+
+void Background_Worker::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true) {
+        start_condition.wait(lock, [this] { return stopping || next_job < queue.size(); });
+
+        if (next_job == queue.size()) // Stopping and nothing left
+            return;
+
+        Job* job = queue[next_job++];
+
+        if (next_job == queue.size()) {
+            queue.clear();
+            next_job = 0;
+        }
+
+        lock.unlock();
+
+        job->run();
+
+        lock.lock();
+
+        job->done = true;
+
+        done_condition.notify_all();
+    }
+}
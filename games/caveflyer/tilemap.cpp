@@ -12,11 +12,11 @@ void System_Tilemap::init() {
     id_to_textures[wall][0].load("assets/misc_assets/groundA.png");
 
     // Pre-load some assets
-    manager_texture.get("assets/misc_assets/ufoGreen2.png");
-    manager_texture.get("assets/misc_assets/ufoRed2.png");
-    manager_texture.get("assets/misc_assets/meteorBrown_big1.png");
-    manager_texture.get("assets/misc_assets/enemyShipBlue4.png");
-    manager_texture.get("assets/misc_assets/laserBlue02.png");
+    manager_texture->get("assets/misc_assets/ufoGreen2.png");
+    manager_texture->get("assets/misc_assets/ufoRed2.png");
+    manager_texture->get("assets/misc_assets/meteorBrown_big1.png");
+    manager_texture->get("assets/misc_assets/enemyShipBlue4.png");
+    manager_texture->get("assets/misc_assets/laserBlue02.png");
 }
 
 // Tile manipulation
@@ -36,43 +36,43 @@ void System_Tilemap::spawn_obstacle(int cell) {
     int x = cell / map_height;
     int y = cell % map_height;
 
-    Entity e = c.create_entity();
+    Entity e = c->create_entity();
 
     Vector2 pos = { static_cast<float>(x) + 0.5f, static_cast<float>(map_height - 1 - y) + 0.5f };
 
-    Asset_Texture* texture = &manager_texture.get("assets/misc_assets/meteorBrown_big1.png");
+    Asset_Texture* texture = &manager_texture->get("assets/misc_assets/meteorBrown_big1.png");
 
-    c.add_component(e, Component_Transform{ .position{ pos } });
-    c.add_component(e, Component_Sprite{ .position{ -0.4f, -0.4f }, .scale=0.8f, .z = 1.0f, .texture = texture });
-    c.add_component(e, Component_Hazard{ .destroyable = false });
-    c.add_component(e, Component_Collision{ .bounds{ -0.25f, -0.25f, 0.5f, 0.5f }});
+    c->add_component(e, Component_Transform{ .position{ pos } });
+    c->add_component(e, Component_Sprite{ .position{ -0.4f, -0.4f }, .scale=0.8f, .z = 1.0f, .texture = texture });
+    c->add_component(e, Component_Hazard{ .destroyable = false });
+    c->add_component(e, Component_Collision{ .bounds{ -0.25f, -0.25f, 0.5f, 0.5f }});
 }
 
 void System_Tilemap::spawn_target(int cell) {
     int x = cell / map_height;
     int y = cell % map_height;
 
-    Entity e = c.create_entity();
+    Entity e = c->create_entity();
 
     Vector2 pos = { static_cast<float>(x) + 0.5f, static_cast<float>(map_height - 1 - y) + 0.5f };
 
-    Asset_Texture* texture = &manager_texture.get("assets/misc_assets/ufoRed2.png");
+    Asset_Texture* texture = &manager_texture->get("assets/misc_assets/ufoRed2.png");
 
-    c.add_component(e, Component_Transform{ .position{ pos } });
-    c.add_component(e, Component_Sprite{ .position{ -0.4f, -0.4f }, .scale=0.8f, .z = 1.0f, .texture = texture });
-    c.add_component(e, Component_Hazard{ .destroyable = true });
-    c.add_component(e, Component_Collision{ .bounds{ -0.25f, -0.25f, 0.5f, 0.5f }});
+    c->add_component(e, Component_Transform{ .position{ pos } });
+    c->add_component(e, Component_Sprite{ .position{ -0.4f, -0.4f }, .scale=0.8f, .z = 1.0f, .texture = texture });
+    c->add_component(e, Component_Hazard{ .destroyable = true });
+    c->add_component(e, Component_Collision{ .bounds{ -0.25f, -0.25f, 0.5f, 0.5f }});
 }
 
 void System_Tilemap::spawn_enemy(int cell, const Vector2 &agent_pos, std::mt19937 &rng) {
     int x = cell / map_height;
     int y = cell % map_height;
 
-    Entity e = c.create_entity();
+    Entity e = c->create_entity();
 
     Vector2 pos = { static_cast<float>(x) + 0.5f, static_cast<float>(map_height - 1 - y) + 0.5f };
 
-    Asset_Texture* texture = &manager_texture.get("assets/misc_assets/enemyShipBlue4.png");
+    Asset_Texture* texture = &manager_texture->get("assets/misc_assets/enemyShipBlue4.png");
 
     std::uniform_real_distribution<float> dist01(0.0f, 1.0f);
 
@@ -93,12 +93,12 @@ void System_Tilemap::spawn_enemy(int cell, const Vector2 &agent_pos, std::mt1993
     else
         vel.y = vel_component;
 
-    c.add_component(e, Component_Transform{ .position{ pos } });
-    c.add_component(e, Component_Dynamics{ .velocity{ vel } });
-    c.add_component(e, Component_Sprite{ .position{ -0.4f, -0.4f }, .scale=0.8f, .z = 1.0f, .texture = texture });
-    c.add_component(e, Component_Hazard{ .destroyable = false });
-    c.add_component(e, Component_Collision{ .bounds{ -0.4f, -0.4f, 0.8f, 0.8f }});
-    c.add_component(e, Component_Mob_AI{});
+    c->add_component(e, Component_Transform{ .position{ pos } });
+    c->add_component(e, Component_Dynamics{ .velocity{ vel } });
+    c->add_component(e, Component_Sprite{ .position{ -0.4f, -0.4f }, .scale=0.8f, .z = 1.0f, .texture = texture });
+    c->add_component(e, Component_Hazard{ .destroyable = false });
+    c->add_component(e, Component_Collision{ .bounds{ -0.4f, -0.4f, 0.8f, 0.8f }});
+    c->add_component(e, Component_Mob_AI{});
 }
 
 int System_Tilemap::check_neighbors(const Vector2 &p0, const Vector2 &p1) {
@@ -116,6 +116,8 @@ int System_Tilemap::check_neighbors(const Vector2 &p0, const Vector2 &p1) {
 
 // Main map generation
 void System_Tilemap::regenerate(std::mt19937 &rng, const Config &cfg) {
+    layer.invalidate();
+
     int world_dim;
 
     if (cfg.mode == hard_mode)
@@ -175,27 +177,27 @@ void System_Tilemap::regenerate(std::mt19937 &rng, const Config &cfg) {
     int goal_x = goal_cell / main_height;
     int goal_y = goal_cell % main_height;
 
-    Entity goal = c.create_entity();
+    Entity goal = c->create_entity();
 
     Vector2 goal_pos = { static_cast<float>(goal_x) + 0.5f, static_cast<float>(map_height - 1 - goal_y) + 0.5f };
 
-    c.add_component(goal, Component_Transform{ .position{ goal_pos } });
-    c.add_component(goal, Component_Sprite{ .position{ -0.4f, -0.4f }, .scale=0.8f, .z = 1.0f, .texture = &manager_texture.get("assets/misc_assets/ufoGreen2.png") });
-    c.add_component(goal, Component_Goal{});
-    c.add_component(goal, Component_Collision{ .bounds{ -0.4f, -0.4f, 0.8f, 0.8f }});
+    c->add_component(goal, Component_Transform{ .position{ goal_pos } });
+    c->add_component(goal, Component_Sprite{ .position{ -0.4f, -0.4f }, .scale=0.8f, .z = 1.0f, .texture = &manager_texture->get("assets/misc_assets/ufoGreen2.png") });
+    c->add_component(goal, Component_Goal{});
+    c->add_component(goal, Component_Collision{ .bounds{ -0.4f, -0.4f, 0.8f, 0.8f }});
 
     info.goal_pos = goal_pos;
 
     Vector2 agent_pos{ static_cast<float>(static_cast<int>(agent_cell / main_height)) + 0.5f, static_cast<float>(main_height - 1 - (agent_cell % main_height)) };
 
     // Spawn the player (agent)
-    Entity agent = c.create_entity();
+    Entity agent = c->create_entity();
 
-    c.add_component(agent, Component_Transform{ .position = agent_pos });
-    c.add_component(agent, Component_Collision{ .bounds{ -0.4f, -0.4f, 0.8f, 0.8f } });
-    c.add_component(agent, Component_Dynamics{});
-    c.add_component(agent, Component_Agent{});
-    c.add_component(agent, Component_Particles{ .particles = std::vector<Particle>(10), .offset{ 0.0f, 0.3f } });
+    c->add_component(agent, Component_Transform{ .position = agent_pos });
+    c->add_component(agent, Component_Collision{ .bounds{ -0.4f, -0.4f, 0.8f, 0.8f } });
+    c->add_component(agent, Component_Dynamics{});
+    c->add_component(agent, Component_Agent{});
+    c->add_component(agent, Component_Particles{ .particles = Inline_Vector<Particle, max_particles>(10), .offset{ 0.0f, 0.3f } });
 
     std::vector<int> goal_path;
     room_generator.find_path(agent_cell, goal_cell, goal_path);
@@ -277,9 +279,32 @@ void System_Tilemap::regenerate(std::mt19937 &rng, const Config &cfg) {
     }
 }
 
+Asset_Texture* System_Tilemap::get_tile_texture(int x, int y, int theme) {
+    Tile_ID id = get(x, map_height - 1 - y);
+
+    if (id == empty)
+        return nullptr;
+
+    if (id >= id_to_textures.size() || id_to_textures[id].empty())
+        return nullptr;
+
+    return &id_to_textures[id][theme];
+}
+
 void System_Tilemap::render(int theme) {
-    Rectangle camera_aabb{ (gr.camera_position.x - gr.camera_size.x * 0.5f / gr.camera_scale) * pixels_to_unit, (gr.camera_position.y - gr.camera_size.y * 0.5f / gr.camera_scale) * pixels_to_unit,
-        gr.camera_size.x * pixels_to_unit / gr.camera_scale, gr.camera_size.y * pixels_to_unit / gr.camera_scale };
+    if (gr->rendering_obs) {
+        if (theme != layer_theme) {
+            layer.invalidate();
+            layer_theme = theme;
+        }
+
+        layer.render(map_width, map_height, [&](int x, int y) { return get_tile_texture(x, y, theme); });
+
+        return;
+    }
+
+    Rectangle camera_aabb{ (gr->camera_position.x - gr->camera_size.x * 0.5f / gr->camera_scale) * pixels_to_unit, (gr->camera_position.y - gr->camera_size.y * 0.5f / gr->camera_scale) * pixels_to_unit,
+        gr->camera_size.x * pixels_to_unit / gr->camera_scale, gr->camera_size.y * pixels_to_unit / gr->camera_scale };
 
     int lower_x = std::floor(camera_aabb.x);
     int lower_y = std::floor(camera_aabb.y);
@@ -288,21 +313,16 @@ void System_Tilemap::render(int theme) {
     
     for (int y = lower_y; y <= upper_y; y++)
         for (int x = lower_x; x <= upper_x; x++) {
-            Tile_ID id = get(x, map_height - 1 - y);
-
-            if (id == empty)
-                continue;
+            Asset_Texture* tex = get_tile_texture(x, y, theme);
 
-            if (id >= id_to_textures.size() || id_to_textures[id].empty())
+            if (tex == nullptr)
                 continue;
 
-            Asset_Texture* tex = &id_to_textures[id][theme];
-
-            gr.render_texture(tex, (Vector2){ x * unit_to_pixels, y * unit_to_pixels }, unit_to_pixels / tex->width);
+            gr->render_texture(tex, (Vector2){ x * unit_to_pixels, y * unit_to_pixels }, unit_to_pixels / tex->width);
         }
 }
 
-std::pair<Vector2, bool> System_Tilemap::get_collision(Rectangle rectangle, const std::function<Collision_Type(Tile_ID)> &collision_id_func) {
+std::pair<Vector2, bool> System_Tilemap::get_collision(Rectangle rectangle, const Collision_Mask &collision_mask) {
     bool collided = false;
 
     int lower_x = std::floor(rectangle.x);
@@ -320,7 +340,7 @@ std::pair<Vector2, bool> System_Tilemap::get_collision(Rectangle rectangle, cons
         for (int x = lower_x; x <= upper_x; x++) {
             Tile_ID id = get(x, map_height - 1 - y);
 
-            Collision_Type type = collision_id_func(id);
+            Collision_Type type = collision_mask[id];
 
             if (type != none) {
                 tile.x = x;
@@ -343,7 +363,7 @@ std::pair<Vector2, bool> System_Tilemap::get_collision(Rectangle rectangle, cons
         for (int x = lower_x; x <= upper_x; x++) {
             Tile_ID id = get(x, map_height - 1 - y);
 
-            Collision_Type type = collision_id_func(id);
+            Collision_Type type = collision_mask[id];
 
             if (type != none) {
                 tile.x = x;
@@ -364,3 +384,52 @@ std::pair<Vector2, bool> System_Tilemap::get_collision(Rectangle rectangle, cons
 
     return std::make_pair(Vector2{ rectangle.x, rectangle.y }, collided);
 }
+
+void System_Tilemap::save_state(State_Writer &writer) const {
+    writer.write(map_width);
+    writer.write(map_height);
+    writer.write(tile_ids);
+    writer.write(info);
+}
+
+void System_Tilemap::load_state(State_Reader &reader) {
+    int loaded_width = -1, loaded_height = -1;
+
+    reader.read(loaded_width);
+    reader.read(loaded_height);
+
+    // Map size is fixed per instance
+    if (loaded_width != map_width || loaded_height != map_height) {
+        reader.fail();
+
+        return;
+    }
+
+    loaded_tile_ids.resize(tile_ids.size());
+
+    reader.read(loaded_tile_ids);
+    reader.read(info);
+
+    if (reader.failed())
+        return;
+
+    set_tiles(loaded_tile_ids);
+}
+
+void System_Tilemap::copy_state(const System &other) {
+    const System_Tilemap &other_tilemap = static_cast<const System_Tilemap&>(other);
+
+    // Map size is fixed per instance, cenv_clone checks that it matches
+    assert(other_tilemap.map_width == map_width && other_tilemap.map_height == map_height);
+
+    set_tiles(other_tilemap.tile_ids);
+
+    info = other_tilemap.info;
+}
+
+void System_Tilemap::set_tiles(const std::vector<Tile_ID> &ids) {
+    for (int i = 0; i < static_cast<int>(tile_ids.size()); i++) {
+        if (ids[i] != tile_ids[i])
+            set(i / map_height, i % map_height, ids[i]);
+    }
+}
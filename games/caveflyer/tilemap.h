@@ -4,11 +4,13 @@
 #include "common_assets.h"
 #include "helpers.h"
 #include "ecs.h"
+#include "tile_layer.h"
 
 #include <cmath>
 #include <algorithm>
 #include <random>
-#include <functional>
+#include <array>
+#include <initializer_list>
 
 enum Distribution_Mode {
     easy_mode,
@@ -29,6 +31,21 @@ enum Collision_Type {
     full
 };
 
+// Collision type by tile id, see System_Tilemap::get_collision
+typedef std::array<Collision_Type, num_ids> Collision_Mask;
+
+// Mask with the given types, none for the other ids
+inline Collision_Mask make_collision_mask(std::initializer_list<std::pair<Tile_ID, Collision_Type>> types) {
+    Collision_Mask mask;
+
+    mask.fill(none);
+
+    for (auto const &type : types)
+        mask[type.first] = type.second;
+
+    return mask;
+}
+
 // Tile map system
 class System_Tilemap : public System {
 public:
@@ -49,7 +66,14 @@ private:
 
     std::vector<std::vector<Asset_Texture>> id_to_textures;
 
+    Tile_Layer layer; // Baked map for observations
+    int layer_theme = -1; // Theme the layer was baked with
+
     std::vector<Tile_ID> tile_ids;
+    std::vector<Tile_ID> loaded_tile_ids; // Compared against the current tiles to only re-bake what changed
+
+    // Set all tiles, only re-baking the ones that changed
+    void set_tiles(const std::vector<Tile_ID> &ids);
 
     Tilemap_Info info;
 
@@ -72,6 +96,8 @@ public:
             return;
 
         tile_ids[y + x * map_height] = id;
+
+        layer.invalidate(x, map_height - 1 - y);
     }
 
     // Top left corner x y, size, id to fill
@@ -86,10 +112,13 @@ public:
         return tile_ids[y + x * map_height];
     }
 
+    // Texture of the tile at render coordinates (y flipped), nullptr if empty
+    Asset_Texture* get_tile_texture(int x, int y, int theme);
+
     void render(int theme);
 
     // General collision detection, returns new rectangle position and a collision flag
-    std::pair<Vector2, bool> get_collision(Rectangle rectangle, const std::function<Collision_Type(Tile_ID)> &collision_id_func);
+    std::pair<Vector2, bool> get_collision(Rectangle rectangle, const Collision_Mask &collision_mask);
 
     int get_width() const {
         return map_width;
@@ -102,4 +131,8 @@ public:
     const Tilemap_Info &getInfo() const {
         return info;
     }
+
+    void save_state(State_Writer &writer) const override;
+    void load_state(State_Reader &reader) override;
+    void copy_state(const System &other) override;
 };
@@ -2,6 +2,10 @@
 
 #include "ecs.h"
 #include "common_assets.h"
+#include "inline_vector.h"
+
+// Capacities of the inline storage in components
+const int max_animation_frames = 4;
 
 // General
 struct Component_Transform {
@@ -39,7 +43,7 @@ struct Component_Sprite {
 };
 
 struct Component_Animation { // Requires a Component_Sprite as well in order to function
-    std::vector<Asset_Texture*> frames;
+    Inline_Vector<Asset_Texture*, max_animation_frames> frames;
 
     int frame_index = 0;
     float rate = 0.1f;
@@ -55,3 +59,15 @@ struct Component_Agent {
 
     Vector2 next_velocity{ 0.0f, 0.0f };
 };
+
+// Component types of the game, in signature bit order
+struct Component_List : Type_List<
+    Component_Transform,
+    Component_Collision,
+    Component_Dynamics,
+    Component_Mob_AI,
+    Component_Sprite,
+    Component_Animation,
+    Component_Point,
+    Component_Agent
+> {};
@@ -6,32 +6,27 @@
 #include <iostream>
 
 void System_Sprite_Render::update(float dt) {
-    if (render_entities.size() != entities.size())
-        render_entities.resize(entities.size());
+    render_entities.clear();
 
-    int index = 0;
+    // Optional
+    Component_Array<Component_Animation>* animations = c->get_component_array<Component_Animation>();
 
-    for (auto const &e : entities) {
-        auto &sprite = c.get_component<Component_Sprite>(e);
-
-        // If also has animation
-        if (c.entity_manager.get_signature(e)[c.component_manager.get_component_type<Component_Animation>()]) {
-            // Has animation component
-            auto &animation = c.get_component<Component_Animation>(e);
+    c->view<Component_Sprite>().each([&](Entity e, Component_Sprite &sprite) {
+        Component_Animation* animation = animations->try_get(e);
 
-            animation.t += dt;
+        if (animation != nullptr) {
+            animation->t += dt;
 
-            int frames_advance = animation.t * animation.rate;
-            animation.t -= frames_advance / animation.rate; 
+            int frames_advance = animation->t * animation->rate;
+            animation->t -= frames_advance / animation->rate; 
                 
-            animation.frame_index = (animation.frame_index + frames_advance) % animation.frames.size();
+            animation->frame_index = (animation->frame_index + frames_advance) % animation->frames.size();
 
-            sprite.texture = animation.frames[animation.frame_index];
+            sprite.texture = animation->frames[animation->frame_index];
         }
 
-        render_entities[index] = std::make_pair(sprite.z, e);
-        index++;
-    }
+        render_entities.push_back(std::make_pair(sprite.z, e));
+    });
     
     // Sort sprites
     std::sort(render_entities.begin(), render_entities.end(), [](const std::pair<float, Entity> &left, const std::pair<float, Entity> &right) {
@@ -44,8 +39,8 @@ void System_Sprite_Render::render(Sprite_Render_Mode mode) {
     for (size_t i = 0; i < render_entities.size(); i++) {
         Entity e = render_entities[i].second;
 
-        auto const &sprite = c.get_component<Component_Sprite>(e);
-        auto const &transform = c.get_component<Component_Transform>(e);
+        auto const &sprite = c->get_component<Component_Sprite>(e);
+        auto const &transform = c->get_component<Component_Transform>(e);
 
         if (sprite.texture == nullptr)
             continue;
@@ -59,16 +54,16 @@ void System_Sprite_Render::render(Sprite_Render_Mode mode) {
         float scale = transform.scale * sprite.scale;
 
         // If visible
-        gr.render_texture(sprite.texture, (Vector2){ (transform.position.x + sprite.position.x) * unit_to_pixels, (transform.position.y + sprite.position.y) * unit_to_pixels }, scale * unit_to_pixels / sprite.texture->width, 1.0f, sprite.flip_x);
+        gr->render_texture(sprite.texture, (Vector2){ (transform.position.x + sprite.position.x) * unit_to_pixels, (transform.position.y + sprite.position.y) * unit_to_pixels }, scale * unit_to_pixels / sprite.texture->width, 1.0f, sprite.flip_x);
     }
 }
 
 void System_Point::update() {
-    std::shared_ptr<System_Agent> agent = c.system_manager.get_system<System_Agent>();
-    const auto &agent_transform = c.get_component<Component_Transform>(agent->get_info().entity);
-    const auto &agent_collision = c.get_component<Component_Collision>(agent->get_info().entity);
+    std::shared_ptr<System_Agent> agent = c->system_manager.get_system<System_Agent>();
+    const auto &agent_transform = c->get_component<Component_Transform>(agent->get_info().entity);
+    const auto &agent_collision = c->get_component<Component_Collision>(agent->get_info().entity);
 
-    std::shared_ptr<System_Mob_AI> mob_ai = c.system_manager.get_system<System_Mob_AI>();
+    std::shared_ptr<System_Mob_AI> mob_ai = c->system_manager.get_system<System_Mob_AI>();
 
     Rectangle agent_rect = agent_collision.bounds;
     agent_rect.x += agent_transform.position.x;
@@ -77,12 +72,12 @@ void System_Point::update() {
     num_points_available = 0;
     point_delta = 0;
 
-    std::vector<Entity> to_destroy;
+    to_destroy.clear();
 
     for (auto const &e : entities) {
-        auto &transform = c.get_component<Component_Transform>(e);
-        auto &collision = c.get_component<Component_Collision>(e);
-        auto &point = c.get_component<Component_Point>(e);
+        auto &transform = c->get_component<Component_Transform>(e);
+        auto &collision = c->get_component<Component_Collision>(e);
+        auto &point = c->get_component<Component_Point>(e);
 
         Rectangle rect = collision.bounds;
         rect.x += transform.position.x;
@@ -102,7 +97,7 @@ void System_Point::update() {
     }
 
     for (int i = 0; i < to_destroy.size(); i++)
-        c.destroy_entity(to_destroy[i]);
+        c->destroy_entity(to_destroy[i]);
 }
 
 void System_Mob_AI::init() {
@@ -124,11 +119,11 @@ bool System_Mob_AI::update(float dt, std::mt19937 &rng) {
     bool player_hit = false;
 
     // Hatched only
-    std::shared_ptr<System_Tilemap> tilemap = c.system_manager.get_system<System_Tilemap>();
-    std::shared_ptr<System_Agent> agent = c.system_manager.get_system<System_Agent>();
+    std::shared_ptr<System_Tilemap> tilemap = c->system_manager.get_system<System_Tilemap>();
+    std::shared_ptr<System_Agent> agent = c->system_manager.get_system<System_Agent>();
 
-    const auto &agent_transform = c.get_component<Component_Transform>(agent->get_info().entity);
-    const auto &agent_collision = c.get_component<Component_Collision>(agent->get_info().entity);
+    const auto &agent_transform = c->get_component<Component_Transform>(agent->get_info().entity);
+    const auto &agent_collision = c->get_component<Component_Collision>(agent->get_info().entity);
 
     Rectangle agent_rect = agent_collision.bounds;
     agent_rect.x += agent_transform.position.x;
@@ -137,13 +132,13 @@ bool System_Mob_AI::update(float dt, std::mt19937 &rng) {
     std::uniform_real_distribution<float> dist01(0.0f, 1.0f);
 
     for (auto const &e : entities) {
-        auto &mob_ai = c.get_component<Component_Mob_AI>(e);
+        auto &mob_ai = c->get_component<Component_Mob_AI>(e);
 
         if (mob_ai.hatch_timer >= hatch_time) {
-            auto &transform = c.get_component<Component_Transform>(e);
-            auto &sprite = c.get_component<Component_Sprite>(e);
-            auto &collision = c.get_component<Component_Collision>(e);
-            auto &dynamics = c.get_component<Component_Dynamics>(e);
+            auto &transform = c->get_component<Component_Transform>(e);
+            auto &sprite = c->get_component<Component_Sprite>(e);
+            auto &collision = c->get_component<Component_Collision>(e);
+            auto &dynamics = c->get_component<Component_Dynamics>(e);
 
             float speed;
 
@@ -264,7 +259,7 @@ bool System_Mob_AI::update(float dt, std::mt19937 &rng) {
                     mob_ai.hatch_timer = 0.0f;
 
                     // Set to egg sprite again
-                    Asset_Texture* texture = &manager_texture.get("assets/misc_assets/enemySpikey_1b.png");
+                    Asset_Texture* texture = &manager_texture->get("assets/misc_assets/enemySpikey_1b.png");
 
                     std::uniform_int_distribution<int> free_cell_dist(0, tilemap->free_cells.size() - 1);
 
@@ -310,21 +305,21 @@ bool System_Agent::update(float dt, int action) {
     const float input_reset_time = 1.0f / speed * 0.5f;
 
     // Get tile map system
-    std::shared_ptr<System_Tilemap> tilemap = c.system_manager.get_system<System_Tilemap>();
-    std::shared_ptr<System_Point> point = c.system_manager.get_system<System_Point>();
+    std::shared_ptr<System_Tilemap> tilemap = c->system_manager.get_system<System_Tilemap>();
+    std::shared_ptr<System_Point> point = c->system_manager.get_system<System_Point>();
 
     assert(entities.size() == 1); // Only one player
 
     for (auto const &e : entities) {
-        auto &agent = c.get_component<Component_Agent>(e);
+        auto &agent = c->get_component<Component_Agent>(e);
 
         // Set action
         agent.action = action;
 
-        auto &transform = c.get_component<Component_Transform>(e);
-        auto &dynamics = c.get_component<Component_Dynamics>(e);
+        auto &transform = c->get_component<Component_Transform>(e);
+        auto &dynamics = c->get_component<Component_Dynamics>(e);
 
-        const auto &collision = c.get_component<Component_Collision>(e);
+        const auto &collision = c->get_component<Component_Collision>(e);
 
         float movement_x = (agent.action == 7) - (agent.action == 1);
         float movement_y = (agent.action == 3) - (agent.action == 5);
@@ -447,14 +442,14 @@ void System_Agent::render() {
     assert(entities.size() == 1); // Only one player
 
     for (auto const &e : entities) {
-        auto const &agent = c.get_component<Component_Agent>(e);
-        auto const &transform = c.get_component<Component_Transform>(e);
-        auto const &dynamics = c.get_component<Component_Dynamics>(e);
+        auto const &agent = c->get_component<Component_Agent>(e);
+        auto const &transform = c->get_component<Component_Transform>(e);
+        auto const &dynamics = c->get_component<Component_Dynamics>(e);
 
         // Additional offsets needed since texture sizes different between animation frames
         float agent_scale = 1.0f;
         Vector2 agent_offset{ -0.5f, -0.5f };
 
-        gr.render_texture(&agent_texture, (Vector2){ (transform.position.x + agent_offset.x) * unit_to_pixels, (transform.position.y + agent_offset.y) * unit_to_pixels }, unit_to_pixels / agent_texture.width * agent_scale, 1.0f, false);
+        gr->render_texture(&agent_texture, (Vector2){ (transform.position.x + agent_offset.x) * unit_to_pixels, (transform.position.y + agent_offset.y) * unit_to_pixels }, unit_to_pixels / agent_texture.width * agent_scale, 1.0f, false);
     }
 }
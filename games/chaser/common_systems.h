@@ -29,10 +29,27 @@ public:
     void reset() {
         render_entities.clear();
     }
+
+    void save_state(State_Writer &writer) const override {
+        writer.write(render_entities, max_entities);
+    }
+
+    void load_state(State_Reader &reader) override {
+        reader.read(render_entities, max_entities);
+    }
+
+    void copy_state(const System &other) override {
+        const System_Sprite_Render &other_system = static_cast<const System_Sprite_Render&>(other);
+
+        render_entities = other_system.render_entities;
+    }
 };
 
 // Empty mostly, since just need it to collect points for agent system
 class System_Point : public System {
+private:
+    std::vector<Entity> to_destroy; // Of update, kept so that collecting doesn't allocate
+
 public:
     int num_points_collected = 0;
     int point_delta = 0;
@@ -45,6 +62,26 @@ public:
         point_delta = 0;
         num_points_available = 0;
     }
+
+    void save_state(State_Writer &writer) const override {
+        writer.write(num_points_collected);
+        writer.write(point_delta);
+        writer.write(num_points_available);
+    }
+
+    void load_state(State_Reader &reader) override {
+        reader.read(num_points_collected);
+        reader.read(point_delta);
+        reader.read(num_points_available);
+    }
+
+    void copy_state(const System &other) override {
+        const System_Point &other_system = static_cast<const System_Point&>(other);
+
+        num_points_collected = other_system.num_points_collected;
+        point_delta = other_system.point_delta;
+        num_points_available = other_system.num_points_available;
+    }
 };
 
 // Enemy controller
@@ -77,6 +114,26 @@ public:
         anim_index = 0;
         eat_timer = 0.0f;
     }
+
+    void save_state(State_Writer &writer) const override {
+        writer.write(anim_timer);
+        writer.write(anim_index);
+        writer.write(eat_timer);
+    }
+
+    void load_state(State_Reader &reader) override {
+        reader.read(anim_timer);
+        reader.read(anim_index);
+        reader.read(eat_timer);
+    }
+
+    void copy_state(const System &other) override {
+        const System_Mob_AI &other_system = static_cast<const System_Mob_AI&>(other);
+
+        anim_timer = other_system.anim_timer;
+        anim_index = other_system.anim_index;
+        eat_timer = other_system.eat_timer;
+    }
 };
 
 // --------------------- Player --------------------
@@ -109,4 +166,21 @@ public:
     void reset() {
         input_timer = 0.0f;
     }
+
+    void save_state(State_Writer &writer) const override {
+        writer.write(info);
+        writer.write(input_timer);
+    }
+
+    void load_state(State_Reader &reader) override {
+        reader.read(info);
+        reader.read(input_timer);
+    }
+
+    void copy_state(const System &other) override {
+        const System_Agent &other_system = static_cast<const System_Agent&>(other);
+
+        info = other_system.info;
+        input_timer = other_system.input_timer;
+    }
 };
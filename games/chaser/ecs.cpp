@@ -1,20 +1,22 @@
 #include "ecs.h"
 
-Entity_Manager::Entity_Manager() {
-    for (Entity e = 0; e < max_entities; e++)
-        available_entities.push(e);
-}
-
 Entity Entity_Manager::create_entity() {
     // Make sure we don't have too many
-    assert(num_living_entities < max_entities);
+    assert(entities_in_use.size() < max_entities);
 
-    Entity e = available_entities.front();
-    available_entities.pop();
+    Entity e;
 
-    entities_in_use.insert(e);
+    if (next_unused < max_entities) {
+        e = next_unused;
+        next_unused++;
+    }
+    else {
+        e = destroyed_entities[destroyed_front];
+        destroyed_front = (destroyed_front + 1) % max_entities;
+        num_destroyed--;
+    }
 
-    num_living_entities++;
+    entities_in_use.insert(e);
 
     return e;
 }
@@ -26,27 +28,105 @@ void Entity_Manager::destroy_entity(Entity e) {
     // Clear signature
     signatures[e].reset();
 
-    available_entities.push(e);
+    destroyed_entities[(destroyed_front + num_destroyed) % max_entities] = e;
+    num_destroyed++;
 
-    assert(entities_in_use.find(e) != entities_in_use.end());
+    assert(entities_in_use.contains(e));
 
     entities_in_use.erase(e);
-
-    num_living_entities--;
 }
 
 void Entity_Manager::clear_entities() {
+    // Only the living entities can have signatures
+    for (Entity e : entities_in_use)
+        signatures[e].reset();
+
     entities_in_use.clear();
 
-    available_entities = std::queue<Entity>();
+    next_unused = 0;
+    destroyed_front = 0;
+    num_destroyed = 0;
+}
 
-    for (Entity e = 0; e < max_entities; e++) {
-        signatures[e].reset();
+void Entity_Manager::save_state(State_Writer &writer) const {
+    writer.write(next_unused);
+
+    // Destroyed entities, oldest first
+    std::array<Entity, max_entities> destroyed_in_order;
+
+    for (int i = 0; i < num_destroyed; i++)
+        destroyed_in_order[i] = destroyed_entities[(destroyed_front + i) % max_entities];
+
+    writer.write_array(destroyed_in_order.data(), num_destroyed, max_entities);
+
+    entities_in_use.save_state(writer);
+
+    // Only the living entities can have signatures
+    std::array<Signature, max_entities> living_signatures;
+
+    int num_living = 0;
 
-        available_entities.push(e);
+    for (Entity e : entities_in_use) {
+        living_signatures[num_living] = signatures[e];
+        num_living++;
     }
 
-    num_living_entities = 0;
+    writer.write_array(living_signatures.data(), num_living, max_entities);
+}
+
+void Entity_Manager::load_state(State_Reader &reader) {
+    clear_entities();
+
+    reader.read(next_unused);
+
+    num_destroyed = reader.read_array(destroyed_entities.data(), max_entities);
+
+    entities_in_use.load_state(reader);
+
+    std::array<Signature, max_entities> living_signatures;
+
+    if (reader.read_array(living_signatures.data(), max_entities) != static_cast<int>(entities_in_use.size()))
+        reader.fail();
+
+    if (next_unused < 0 || next_unused > max_entities)
+        reader.fail();
+
+    for (int i = 0; i < num_destroyed; i++) {
+        if (destroyed_entities[i] < 0 || destroyed_entities[i] >= max_entities)
+            reader.fail();
+    }
+
+    if (reader.failed()) {
+        clear_entities();
+
+        return;
+    }
+
+    int index = 0;
+
+    for (Entity e : entities_in_use) {
+        signatures[e] = living_signatures[index];
+        index++;
+    }
+}
+
+void Entity_Manager::copy_state(const Entity_Manager &other) {
+    clear_entities();
+
+    next_unused = other.next_unused;
+    destroyed_front = other.destroyed_front;
+    num_destroyed = other.num_destroyed;
+
+    for (int i = 0; i < num_destroyed; i++) {
+        int index = (destroyed_front + i) % max_entities;
+
+        destroyed_entities[index] = other.destroyed_entities[index];
+    }
+
+    entities_in_use.copy_state(other.entities_in_use);
+
+    for (Entity e : entities_in_use)
+        signatures[e] = other.signatures[e];
 }
 
 void System_Manager::entity_destroyed(Entity e) {
@@ -82,6 +162,35 @@ void System_Manager::entity_signature_changed(Entity e, Signature s) {
     }
 }
 
+void System_Manager::save_state(State_Writer &writer) const {
+    // Same order on every instance, since systems are registered in the same order
+    for (auto const &pair : systems) {
+        auto const &system = pair.second;
+
+        system->entities.save_state(writer);
+        system->save_state(writer);
+    }
+}
+
+void System_Manager::load_state(State_Reader &reader) {
+    for (auto const &pair : systems) {
+        auto const &system = pair.second;
+
+        system->entities.load_state(reader);
+        system->load_state(reader);
+    }
+}
+
+void System_Manager::copy_state(const System_Manager &other) {
+    for (auto const &pair : systems) {
+        auto const &system = pair.second;
+        auto const &other_system = other.systems.at(pair.first);
+
+        system->entities.copy_state(other_system->entities);
+        system->copy_state(*other_system);
+    }
+}
+
 void Coordinator::destroy_entity(Entity e) {
     entity_manager.destroy_entity(e);
     component_manager.entity_destroyed(e);
@@ -94,4 +203,22 @@ void Coordinator::clear_entities() {
     system_manager.clear_entities();
 }
 
-Coordinator c;
+void Coordinator::save_state(State_Writer &writer) const {
+    entity_manager.save_state(writer);
+    component_manager.save_state(writer);
+    system_manager.save_state(writer);
+}
+
+void Coordinator::load_state(State_Reader &reader) {
+    entity_manager.load_state(reader);
+    component_manager.load_state(reader);
+    system_manager.load_state(reader);
+}
+
+void Coordinator::copy_state(const Coordinator &other) {
+    entity_manager.copy_state(other.entity_manager);
+    component_manager.copy_state(other.component_manager);
+    system_manager.copy_state(other.system_manager);
+}
+
+thread_local Coordinator* c = nullptr;
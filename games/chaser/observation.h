@@ -0,0 +1,82 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+#include "state.h"
+
+#include <vector>
+
+// Layout of the observations handed to the learner, chosen at make time
+struct Observation_Format {
+    int size = 64; // Width and height, must divide the render target size (box filtered down)
+    bool rgba = false; // Keep alpha
+    bool grayscale = false; // Single luma channel (takes precedence over rgba)
+    bool chw = false; // Channels first instead of last
+    int frame_stack = 1; // Number of most recent frames stacked along the channels, oldest first
+
+    int get_frame_channels() const {
+        return grayscale ? 1 : (rgba ? 4 : 3);
+    }
+
+    int get_frame_size() const {
+        return size * size * get_frame_channels();
+    }
+
+    int get_size() const {
+        return get_frame_size() * frame_stack;
+    }
+
+    bool operator==(const Observation_Format &other) const {
+        return size == other.size && rgba == other.rgba && grayscale == other.grayscale && chw == other.chw && frame_stack == other.frame_stack;
+    }
+};
+
+// Turns render target pixels into observations of some format in a single pass over the pixels.
+// Frames are kept in a ring buffer for stacking
+class Observation_Builder {
+private:
+    Observation_Format format;
+
+    std::vector<uint8_t> frames; // Ring of the last frame_stack frames, each in the final (unstacked) layout
+    int newest = 0; // Index of the newest frame in the ring
+    bool restarted = true;
+
+    void convert(SDL_Surface* surface, uint8_t* frame) const;
+
+public:
+    void init(const Observation_Format &format);
+
+    const Observation_Format &get_format() const {
+        return format;
+    }
+
+    // Start a new episode, the next frame fills the whole stack
+    void restart() {
+        restarted = true;
+    }
+
+    // Add the surface as the newest frame and write the (stacked) observation to buffer
+    void build(SDL_Surface* surface, uint8_t* buffer);
+
+    // Write the stacked observation of the frames already added again (after loading a state), requires frame_stack > 1
+    void stack(uint8_t* buffer) const;
+
+    // The stacked frames, so that stacking continues where it was
+    void save_state(State_Writer &writer) const {
+        writer.write(frames);
+        writer.write(newest);
+        writer.write(restarted);
+    }
+
+    void load_state(State_Reader &reader) {
+        reader.read(frames);
+        reader.read(newest);
+        reader.read(restarted);
+    }
+
+    void copy_state(const Observation_Builder &other) {
+        frames = other.frames;
+        newest = other.newest;
+        restarted = other.restarted;
+    }
+};
@@ -10,9 +10,9 @@ void System_Tilemap::init() {
     id_to_textures[wall].load("assets/misc_assets/tileStone_slope.png");
 
     // Pre-load
-    manager_texture.get("assets/misc_assets/yellowCrystal.png");
-    manager_texture.get("assets/misc_assets/enemySpikey_1b.png");
-    manager_texture.get("assets/custom/chaser_point.png");
+    manager_texture->get("assets/misc_assets/yellowCrystal.png");
+    manager_texture->get("assets/misc_assets/enemySpikey_1b.png");
+    manager_texture->get("assets/custom/chaser_point.png");
 }
 
 // Tile manipulation
@@ -31,53 +31,55 @@ void System_Tilemap::spawn_orb(int tile_index) {
     int x = tile_index / map_height;
     int y = tile_index % map_height;
 
-    Entity e = c.create_entity();
+    Entity e = c->create_entity();
 
     Vector2 pos = { static_cast<float>(x) + 0.5f, static_cast<float>(map_height - 1 - y) + 0.5f };
 
-    Asset_Texture* texture = &manager_texture.get("assets/misc_assets/yellowCrystal.png");
+    Asset_Texture* texture = &manager_texture->get("assets/misc_assets/yellowCrystal.png");
 
-    c.add_component(e, Component_Transform{ .position{ pos } });
-    c.add_component(e, Component_Sprite{ .position{ -0.5f, -0.5f }, .scale=1.0f, .texture = texture });
-    c.add_component(e, Component_Collision{ .bounds{ -0.5f, -0.5f, 1.0f, 1.0f }});
-    c.add_component(e, Component_Point{ .is_orb = true });
+    c->add_component(e, Component_Transform{ .position{ pos } });
+    c->add_component(e, Component_Sprite{ .position{ -0.5f, -0.5f }, .scale=1.0f, .texture = texture });
+    c->add_component(e, Component_Collision{ .bounds{ -0.5f, -0.5f, 1.0f, 1.0f }});
+    c->add_component(e, Component_Point{ .is_orb = true });
 }
 
 void System_Tilemap::spawn_point(int tile_index) {
     int x = tile_index / map_height;
     int y = tile_index % map_height;
 
-    Entity e = c.create_entity();
+    Entity e = c->create_entity();
 
     Vector2 pos = { static_cast<float>(x) + 0.5f, static_cast<float>(map_height - 1 - y) + 0.5f };
 
-    Asset_Texture* texture = &manager_texture.get("assets/custom/chaser_point.png");
+    Asset_Texture* texture = &manager_texture->get("assets/custom/chaser_point.png");
 
-    c.add_component(e, Component_Transform{ .position{ pos } });
-    c.add_component(e, Component_Sprite{ .position{ -0.5f, -0.5f }, .scale=1.0f, .texture = texture });
-    c.add_component(e, Component_Collision{ .bounds{ -0.3f, -0.3f, 0.6f, 0.6f }});
-    c.add_component(e, Component_Point{ .is_orb = false });
+    c->add_component(e, Component_Transform{ .position{ pos } });
+    c->add_component(e, Component_Sprite{ .position{ -0.5f, -0.5f }, .scale=1.0f, .texture = texture });
+    c->add_component(e, Component_Collision{ .bounds{ -0.3f, -0.3f, 0.6f, 0.6f }});
+    c->add_component(e, Component_Point{ .is_orb = false });
 }
 
 void System_Tilemap::spawn_egg(int tile_index) {
     int x = tile_index / map_height;
     int y = tile_index % map_height;
 
-    Entity e = c.create_entity();
+    Entity e = c->create_entity();
 
     Vector2 pos = { static_cast<float>(x) + 0.5f, static_cast<float>(map_height - 1 - y) + 0.5f };
 
-    Asset_Texture* texture = &manager_texture.get("assets/misc_assets/enemySpikey_1b.png");
+    Asset_Texture* texture = &manager_texture->get("assets/misc_assets/enemySpikey_1b.png");
 
-    c.add_component(e, Component_Transform{ .position{ pos } });
-    c.add_component(e, Component_Sprite{ .position{ -0.5f, -0.5f }, .scale=1.0f, .texture = texture });
-    c.add_component(e, Component_Collision{ .bounds{ -0.5f, -0.5f, 1.0f, 1.0f }});
-    c.add_component(e, Component_Dynamics{});
-    c.add_component(e, Component_Mob_AI{});
+    c->add_component(e, Component_Transform{ .position{ pos } });
+    c->add_component(e, Component_Sprite{ .position{ -0.5f, -0.5f }, .scale=1.0f, .texture = texture });
+    c->add_component(e, Component_Collision{ .bounds{ -0.5f, -0.5f, 1.0f, 1.0f }});
+    c->add_component(e, Component_Dynamics{});
+    c->add_component(e, Component_Mob_AI{});
 }
 
 // Main map generation
 void System_Tilemap::regenerate(std::mt19937 &rng, const Config &cfg) {
+    layer.invalidate();
+
     int world_dim;
     int total_enemies;
     int extra_orb_sign;
@@ -234,17 +236,34 @@ void System_Tilemap::regenerate(std::mt19937 &rng, const Config &cfg) {
     Vector2 agent_pos{ static_cast<float>(agent_spawn_x) + 0.5f, static_cast<float>(main_height - 1 - agent_spawn_y) + 0.5f };
 
     // Spawn the player (agent)
-    Entity agent = c.create_entity();
+    Entity agent = c->create_entity();
+
+    c->add_component(agent, Component_Transform{ .position = agent_pos });
+    c->add_component(agent, Component_Collision{ .bounds{ -0.5f, -0.5f, 1.0f, 1.0f } });
+    c->add_component(agent, Component_Dynamics{});
+    c->add_component(agent, Component_Agent{});
+}
+
+Asset_Texture* System_Tilemap::get_tile_texture(int x, int y) {
+    Tile_ID id = get(x, map_height - 1 - y);
 
-    c.add_component(agent, Component_Transform{ .position = agent_pos });
-    c.add_component(agent, Component_Collision{ .bounds{ -0.5f, -0.5f, 1.0f, 1.0f } });
-    c.add_component(agent, Component_Dynamics{});
-    c.add_component(agent, Component_Agent{});
+    if (id == empty || id == out_of_bounds)
+        return nullptr;
+
+    assert(id == wall);
+
+    return &id_to_textures[id];
 }
 
 void System_Tilemap::render() {
-    Rectangle camera_aabb{ (gr.camera_position.x - gr.camera_size.x * 0.5f / gr.camera_scale) * pixels_to_unit, (gr.camera_position.y - gr.camera_size.y * 0.5f / gr.camera_scale) * pixels_to_unit,
-        gr.camera_size.x * pixels_to_unit / gr.camera_scale, gr.camera_size.y * pixels_to_unit / gr.camera_scale };
+    if (gr->rendering_obs) {
+        layer.render(map_width, map_height, [&](int x, int y) { return get_tile_texture(x, y); });
+
+        return;
+    }
+
+    Rectangle camera_aabb{ (gr->camera_position.x - gr->camera_size.x * 0.5f / gr->camera_scale) * pixels_to_unit, (gr->camera_position.y - gr->camera_size.y * 0.5f / gr->camera_scale) * pixels_to_unit,
+        gr->camera_size.x * pixels_to_unit / gr->camera_scale, gr->camera_size.y * pixels_to_unit / gr->camera_scale };
 
     int lower_x = std::floor(camera_aabb.x);
     int lower_y = std::floor(camera_aabb.y);
@@ -253,20 +272,16 @@ void System_Tilemap::render() {
     
     for (int y = lower_y; y <= upper_y; y++)
         for (int x = lower_x; x <= upper_x; x++) {
-            Tile_ID id = get(x, map_height - 1 - y);
+            Asset_Texture* tex = get_tile_texture(x, y);
 
-            if (id == empty || id == out_of_bounds)
+            if (tex == nullptr)
                 continue;
 
-            assert(id == wall);
-
-            Asset_Texture* tex = &id_to_textures[id];
-
-            gr.render_texture(tex, (Vector2){ x * unit_to_pixels, y * unit_to_pixels }, unit_to_pixels / tex->width);
+            gr->render_texture(tex, (Vector2){ x * unit_to_pixels, y * unit_to_pixels }, unit_to_pixels / tex->width);
         }
 }
 
-std::pair<Vector2, bool> System_Tilemap::get_collision(Rectangle rectangle, const std::function<Collision_Type(Tile_ID)> &collision_id_func) {
+std::pair<Vector2, bool> System_Tilemap::get_collision(Rectangle rectangle, const Collision_Mask &collision_mask) {
     bool collided = false;
 
     int lower_x = std::floor(rectangle.x);
@@ -284,7 +299,7 @@ std::pair<Vector2, bool> System_Tilemap::get_collision(Rectangle rectangle, cons
         for (int x = lower_x; x <= upper_x; x++) {
             Tile_ID id = get(x, map_height - 1 - y);
 
-            Collision_Type type = collision_id_func(id);
+            Collision_Type type = (id == out_of_bounds ? none : collision_mask[id]);
 
             if (type != none) {
                 tile.x = x;
@@ -307,7 +322,7 @@ std::pair<Vector2, bool> System_Tilemap::get_collision(Rectangle rectangle, cons
         for (int x = lower_x; x <= upper_x; x++) {
             Tile_ID id = get(x, map_height - 1 - y);
 
-            Collision_Type type = collision_id_func(id);
+            Collision_Type type = (id == out_of_bounds ? none : collision_mask[id]);
 
             if (type != none) {
                 tile.x = x;
@@ -328,3 +343,55 @@ std::pair<Vector2, bool> System_Tilemap::get_collision(Rectangle rectangle, cons
 
     return std::make_pair(Vector2{ rectangle.x, rectangle.y }, collided);
 }
+
+void System_Tilemap::save_state(State_Writer &writer) const {
+    writer.write(map_width);
+    writer.write(map_height);
+    writer.write(tile_ids);
+    writer.write(total_points);
+    writer.write(free_cells, map_width * map_height);
+}
+
+void System_Tilemap::load_state(State_Reader &reader) {
+    int loaded_width = -1, loaded_height = -1;
+
+    reader.read(loaded_width);
+    reader.read(loaded_height);
+
+    // Map size is fixed per instance
+    if (loaded_width != map_width || loaded_height != map_height) {
+        reader.fail();
+
+        return;
+    }
+
+    loaded_tile_ids.resize(tile_ids.size());
+
+    reader.read(loaded_tile_ids);
+    reader.read(total_points);
+    reader.read(free_cells, map_width * map_height);
+
+    if (reader.failed())
+        return;
+
+    set_tiles(loaded_tile_ids);
+}
+
+void System_Tilemap::copy_state(const System &other) {
+    const System_Tilemap &other_tilemap = static_cast<const System_Tilemap&>(other);
+
+    // Map size is fixed per instance, cenv_clone checks that it matches
+    assert(other_tilemap.map_width == map_width && other_tilemap.map_height == map_height);
+
+    set_tiles(other_tilemap.tile_ids);
+
+    total_points = other_tilemap.total_points;
+    free_cells = other_tilemap.free_cells;
+}
+
+void System_Tilemap::set_tiles(const std::vector<Tile_ID> &ids) {
+    for (int i = 0; i < static_cast<int>(tile_ids.size()); i++) {
+        if (ids[i] != tile_ids[i])
+            set(i / map_height, i % map_height, ids[i]);
+    }
+}
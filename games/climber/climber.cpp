@@ -1,59 +1,32 @@
 #include "../../cenv/cenv.h"
 
+#include <atomic>
 #include <cmath>
 #include <iostream>
+#include <mutex>
 
 #include "tilemap.h"
 #include "common_systems.h"
+#include "thread_pool.h"
+#include "observation.h"
 
 const int version = 100;
 const bool show_log = false;
 
-// ---------------------- CEnv Interface ----------------------
-
-// Define globals from cenv
-cenv_make_data make_data;
-cenv_reset_data reset_data;
-cenv_step_data step_data;
-cenv_render_data render_data;
-
-// Shared value between different datas (optional)
-cenv_key_value observation;
-
 // ---------------------- Game ----------------------
 
 const int obs_width = 64;
 const int obs_height = 64;
 const int num_actions = 15;
 
-int window_width = 512;
-int window_height = 512;
-
 float game_zoom = 0.2f; // Base game zoom level
 
-std::mt19937 rng;
-
-SDL_Surface* window_target; // Main render window
-SDL_Surface* obs_target; // Observation target
-SDL_Renderer* window_renderer;
-SDL_Renderer* obs_renderer;
-
 // Masking for SDL surfaces
 uint32_t rmask, gmask, bmask, amask;
 
 const int sub_steps = 4; // Physics sub-steps
 float dt = 1.0f / sub_steps; // Not relative to time in seconds, need to do it this way due to the weird way the original procgen works w.r.t. physics
 
-// Systems
-std::shared_ptr<System_Sprite_Render> sprite_render;
-std::shared_ptr<System_Tilemap> tilemap;
-std::shared_ptr<System_Mob_AI> mob_ai;
-std::shared_ptr<System_Point> point;
-std::shared_ptr<System_Agent> agent;
-
-System_Tilemap::Config tilemap_config;
-int current_map_theme = 0;
-
 // Big list of different background images
 std::vector<std::string> background_names {
     "assets/platform_backgrounds/alien_bg.png",
@@ -107,26 +80,177 @@ std::vector<std::string> background_names {
     "assets/platform_backgrounds_2/candy4.png"
 };
 
-std::vector<Asset_Texture> background_textures;
+// Sprites (tiles, enemies, agents, items), packed into one texture atlas
+std::vector<std::string> sprite_names = {
+    "assets/platformer/tileBlue_05.png",
+    "assets/platformer/tileGreen_05.png",
+    "assets/platformer/tileYellow_06.png",
+    "assets/platformer/tileBrown_06.png",
+    "assets/platformer/tileBlue_08.png",
+    "assets/platformer/tileGreen_08.png",
+    "assets/platformer/tileYellow_09.png",
+    "assets/platformer/tileBrown_09.png",
+    "assets/platformer/enemySwimming_1.png",
+    "assets/platformer/enemySwimming_2.png",
+    "assets/misc_assets/yellowCrystal.png",
+    "assets/platformer/playerBlue_stand.png",
+    "assets/platformer/playerBlue_walk4.png",
+    "assets/platformer/playerBlue_walk1.png",
+    "assets/platformer/playerBlue_walk2.png",
+    "assets/platformer/playerGreen_stand.png",
+    "assets/platformer/playerGreen_walk4.png",
+    "assets/platformer/playerGreen_walk1.png",
+    "assets/platformer/playerGreen_walk2.png",
+    "assets/platformer/playerGrey_stand.png",
+    "assets/platformer/playerGrey_walk4.png",
+    "assets/platformer/playerGrey_walk1.png",
+    "assets/platformer/playerGrey_walk2.png",
+    "assets/platformer/playerRed_stand.png",
+    "assets/platformer/playerRed_walk4.png",
+    "assets/platformer/playerRed_walk1.png",
+    "assets/platformer/playerRed_walk2.png"
+};
+
+// Threads the batched interface spreads environments over, shared by all instances. Made on first use, see cenv_set_threads
+std::mutex thread_pool_mutex;
+std::unique_ptr<Thread_Pool> thread_pool;
+int thread_pool_users = 0; // Batched calls running on the pool, including background steps not waited for yet
+
+// The pool can't be replaced until released again
+Thread_Pool* acquire_thread_pool() {
+    std::lock_guard<std::mutex> lock(thread_pool_mutex);
+
+    if (thread_pool == nullptr)
+        thread_pool = std::make_unique<Thread_Pool>();
+
+    thread_pool_users++;
+
+    return thread_pool.get();
+}
+
+void release_thread_pool() {
+    std::lock_guard<std::mutex> lock(thread_pool_mutex);
+
+    thread_pool_users--;
+}
+
+// Runs the steps started with cenv_step_async, made on first use
+Background_Worker &get_background_worker() {
+    static Background_Worker worker;
+
+    return worker;
+}
+
+// Arguments and result of a cenv_step_async
+struct Pending_Step : public Background_Worker::Job {
+    cenv_context** contexts;
+    int32_t num_envs;
+    int32_t* actions;
+    uint8_t* observations;
+    float* rewards;
+    bool* terminated;
+    bool* truncated;
+    uint8_t* final_observations;
+
+    int32_t result = 0;
+    bool started = false;
+
+    void run() override {
+        result = cenv_step_batch(contexts, num_envs, actions, observations, rewards, terminated, truncated, final_observations);
+    }
+};
+
+// Identifies instances in saved states, never reused
+std::atomic<uint64_t> next_instance_id{ 0 };
+
+// Everything belonging to a single environment instance
+struct cenv_context {
+    // ---------------------- CEnv Interface ----------------------
 
-int current_background_index = 0;
-float current_background_offset_x = 0.0f;
+    cenv_make_data make_data;
+    cenv_reset_data reset_data;
+    cenv_step_data step_data;
+    cenv_render_data render_data;
 
-int current_agent_theme = 0;
+    // Shared value between different datas (optional)
+    cenv_key_value observation;
+
+    // Batched step running in the background, kept by the first context of the batch
+    Pending_Step pending_step;
+    cenv_context* batch_owner = nullptr; // Context with the pending step of the batch this one is in, nullptr if none
+
+    uint64_t instance_id;
+
+    // ---------------------- Game ----------------------
+
+    int window_width = 512;
+    int window_height = 512;
+
+    Observation_Builder obs_builder;
+
+    std::mt19937 rng;
+
+    SDL_Surface* window_target; // Main render window
+    SDL_Surface* obs_target; // Observation target
+    SDL_Renderer* window_renderer;
+    SDL_Renderer* obs_renderer;
+
+    // ECS, renderer and textures, bound to the calling thread by every CEnv call
+    Coordinator coordinator;
+    Renderer renderer;
+    Asset_Manager<Asset_Texture> textures;
+    Texture_Table texture_table;
+
+    // Systems
+    std::shared_ptr<System_Sprite_Render> sprite_render;
+    std::shared_ptr<System_Tilemap> tilemap;
+    std::shared_ptr<System_Mob_AI> mob_ai;
+    std::shared_ptr<System_Point> point;
+    std::shared_ptr<System_Agent> agent;
+
+    System_Tilemap::Config tilemap_config;
+    int current_map_theme = 0;
+
+    Texture_Set background_textures;
+
+    int current_background_index = 0;
+    float current_background_offset_x = 0.0f;
+
+    int current_agent_theme = 0;
+};
 
 // Forward declarations
-void render_game(bool is_obs);
-void reset();
+void bind(cenv_context* ctx);
+void render_game(cenv_context* ctx, bool is_obs);
+void render_observation(cenv_context* ctx, uint8_t* buffer);
+void restore_observation(cenv_context* ctx, uint8_t* buffer);
+void step_game(cenv_context* ctx, int action);
+void reset(cenv_context* ctx);
+void save_state(cenv_context* ctx, State_Writer &writer);
+bool load_state(cenv_context* ctx, State_Reader &reader);
+bool can_clone(cenv_context* src, cenv_context* dst);
+void clone_state(cenv_context* src, cenv_context* dst);
 
 int32_t cenv_get_env_version() {
     return version;
 }
 
-int32_t cenv_make(const char* render_mode, cenv_option* options, int32_t options_size) {
+cenv_context* cenv_make(const char* render_mode, cenv_option* options, int32_t options_size) {
+    cenv_context* ctx = new cenv_context();
+
+    ctx->instance_id = next_instance_id++;
+
+    bind(ctx);
+
     // ---------------------- CEnv Interface ----------------------
 
     unsigned int seed = time(nullptr);
 
+    Observation_Format obs_format;
+
+    bool lazy_assets = false; // Load backgrounds on first use
+    int max_backgrounds = 0; // Most backgrounds to keep loaded, 0 for all
+
     // Parse options
     for (int i = 0; i < options_size; i++) {
         std::string name(options[i].name);
@@ -139,16 +263,68 @@ int32_t cenv_make(const char* render_mode, cenv_option* options, int32_t options
         else if (name == "width") {
             assert(options[i].value_type == CENV_VALUE_TYPE_INT);
 
-            window_width = options[i].value.i;
+            ctx->window_width = options[i].value.i;
         }
         else if (name == "height") {
             assert(options[i].value_type == CENV_VALUE_TYPE_INT);
 
-            window_height = options[i].value.i;
+            ctx->window_height = options[i].value.i;
+        }
+        else if (name == "obs_rgba") {
+            assert(options[i].value_type == CENV_VALUE_TYPE_INT);
+
+            obs_format.rgba = options[i].value.i;
+        }
+        else if (name == "obs_grayscale") {
+            assert(options[i].value_type == CENV_VALUE_TYPE_INT);
+
+            obs_format.grayscale = options[i].value.i;
+        }
+        else if (name == "obs_chw") {
+            assert(options[i].value_type == CENV_VALUE_TYPE_INT);
+
+            obs_format.chw = options[i].value.i;
+        }
+        else if (name == "obs_size") {
+            assert(options[i].value_type == CENV_VALUE_TYPE_INT);
+
+            obs_format.size = options[i].value.i;
+        }
+        else if (name == "frame_stack") {
+            assert(options[i].value_type == CENV_VALUE_TYPE_INT);
+
+            obs_format.frame_stack = options[i].value.i;
+        }
+        else if (name == "shared_memory_assets") {
+            assert(options[i].value_type == CENV_VALUE_TYPE_INT);
+
+            store_texture.set_shared_memory(options[i].value.i); // For the whole process
+        }
+        else if (name == "lazy_assets") {
+            assert(options[i].value_type == CENV_VALUE_TYPE_INT);
+
+            lazy_assets = options[i].value.i;
+        }
+        else if (name == "max_backgrounds") {
+            assert(options[i].value_type == CENV_VALUE_TYPE_INT);
+
+            max_backgrounds = options[i].value.i;
         }
     }
-    
+
+    if (obs_format.size <= 0 || obs_width % obs_format.size != 0 || obs_format.frame_stack <= 0) {
+        std::cerr << "Invalid observation format, obs_size must divide " << obs_width << " and frame_stack must be positive" << std::endl;
+
+        delete ctx;
+
+        return nullptr;
+    }
+
+    ctx->obs_builder.init(obs_format);
+
     // Allocate make data
+    cenv_make_data &make_data = ctx->make_data;
+
     make_data.observation_spaces_size = 1;
     make_data.observation_spaces = (cenv_key_value*)malloc(sizeof(cenv_key_value));
 
@@ -173,32 +349,32 @@ int32_t cenv_make(const char* render_mode, cenv_option* options, int32_t options
     make_data.action_spaces[0].value_buffer.i[0] = num_actions;
 
     // Allocate observations once and re-use (doesn't resize dynamically)
-    observation.key = "screen";
-    observation.value_type = CENV_VALUE_TYPE_BYTE;
-    observation.value_buffer_size = obs_width * obs_height * 3;
-    observation.value_buffer.b = (uint8_t*)malloc(obs_width * obs_height * 3 * sizeof(uint8_t));
+    ctx->observation.key = "screen";
+    ctx->observation.value_type = CENV_VALUE_TYPE_BYTE;
+    ctx->observation.value_buffer_size = obs_format.get_size();
+    ctx->observation.value_buffer.b = (uint8_t*)malloc(obs_format.get_size() * sizeof(uint8_t));
 
     // Reset data
-    reset_data.observations_size = 1;
-    reset_data.observations = &observation;
-    reset_data.infos_size = 0;
-    reset_data.infos = NULL;
+    ctx->reset_data.observations_size = 1;
+    ctx->reset_data.observations = &ctx->observation;
+    ctx->reset_data.infos_size = 0;
+    ctx->reset_data.infos = NULL;
 
     // Step data
-    step_data.observations_size = 1;
-    step_data.observations = &observation;
-    step_data.reward.f = 0.0f;
-    step_data.terminated = false;
-    step_data.truncated = false;
-    step_data.infos_size = 0;
-    step_data.infos = NULL;
+    ctx->step_data.observations_size = 1;
+    ctx->step_data.observations = &ctx->observation;
+    ctx->step_data.reward.f = 0.0f;
+    ctx->step_data.terminated = false;
+    ctx->step_data.truncated = false;
+    ctx->step_data.infos_size = 0;
+    ctx->step_data.infos = NULL;
 
     // Frame
-    render_data.value_type = CENV_VALUE_TYPE_BYTE;
-    render_data.value_buffer_height = window_height;
-    render_data.value_buffer_width = window_width;
-    render_data.value_buffer_channels = 3;
-    render_data.value_buffer.b = (uint8_t*)malloc(window_width * window_height * 3 * sizeof(uint8_t));
+    ctx->render_data.value_type = CENV_VALUE_TYPE_BYTE;
+    ctx->render_data.value_buffer_height = ctx->window_height;
+    ctx->render_data.value_buffer_width = ctx->window_width;
+    ctx->render_data.value_buffer_channels = 3;
+    ctx->render_data.value_buffer.b = (uint8_t*)malloc(ctx->window_width * ctx->window_height * 3 * sizeof(uint8_t));
 
     // ---------------------- Game ----------------------
 
@@ -220,74 +396,102 @@ int32_t cenv_make(const char* render_mode, cenv_option* options, int32_t options
 
     IMG_Init(IMG_INIT_PNG);
 
-    window_target = SDL_CreateSurface(window_width, window_height, SDL_GetPixelFormatEnumForMasks(32, rmask, gmask, bmask, amask));
-    obs_target = SDL_CreateSurface(obs_width, obs_height, SDL_GetPixelFormatEnumForMasks(32, rmask, gmask, bmask, amask));
+    ctx->window_target = SDL_CreateSurface(ctx->window_width, ctx->window_height, SDL_GetPixelFormatEnumForMasks(32, rmask, gmask, bmask, amask));
+    ctx->obs_target = SDL_CreateSurface(obs_width, obs_height, SDL_GetPixelFormatEnumForMasks(32, rmask, gmask, bmask, amask));
 
-    window_renderer = SDL_CreateSoftwareRenderer(window_target);
-    obs_renderer = SDL_CreateSoftwareRenderer(obs_target);
+    ctx->window_renderer = SDL_CreateSoftwareRenderer(ctx->window_target);
+    ctx->obs_renderer = SDL_CreateSoftwareRenderer(ctx->obs_target);
 
-    gr.window_renderer = window_renderer;
-    gr.obs_renderer = obs_renderer;
+    gr->window_renderer = ctx->window_renderer;
+    gr->obs_renderer = ctx->obs_renderer;
+    gr->obs_target = ctx->obs_target;
 
     // Seed RNG
-    rng.seed(seed);
-
-    // Register components
-    c.register_component<Component_Transform>();
-    c.register_component<Component_Collision>();
-    c.register_component<Component_Dynamics>();
-    c.register_component<Component_Sprite>();
-    c.register_component<Component_Animation>();
-    c.register_component<Component_Point>();
-    c.register_component<Component_Agent>(); // Player
-    c.register_component<Component_Mob_AI>();
-
-    // Sprite rendering system
-    sprite_render = c.register_system<System_Sprite_Render>();
-    Signature sprite_render_signature;
-    sprite_render_signature.set(c.get_component_type<Component_Sprite>()); // Operate only on sprites
-    c.set_system_signature<System_Sprite_Render>(sprite_render_signature);
-
-    // Tile map setup
-    tilemap = c.register_system<System_Tilemap>();
-    Signature tilemap_signature{ 0 }; // Operates on nothing
-    c.set_system_signature<System_Tilemap>(tilemap_signature);
-
-    tilemap->init();
-
-    // Point system setup
-    point = c.register_system<System_Point>();
-    Signature point_signature;
-    point_signature.set(c.get_component_type<Component_Point>()); // Operate only on points
-    c.set_system_signature<System_Point>(point_signature);
-
-    // Agent system setup
-    agent = c.register_system<System_Agent>();
-    Signature agent_signature;
-    agent_signature.set(c.get_component_type<Component_Agent>()); // Operate only on mobs
-    c.set_system_signature<System_Agent>(agent_signature);
-
-    agent->init();
-
-    // Mob AI setup
-    mob_ai = c.register_system<System_Mob_AI>();
-    Signature mob_ai_signature;
-    mob_ai_signature.set(c.get_component_type<Component_Mob_AI>()); // Operate only on mobs
-    c.set_system_signature<System_Mob_AI>(mob_ai_signature);
-
-    // Load backgrounds
-    background_textures.resize(background_names.size());
-
-    for (int i = 0; i < background_names.size(); i++)
-        background_textures[i].load(background_names[i]);
+    ctx->rng.seed(seed);
+
+    // Before anything loads sprites
+    store_texture.add_atlas(sprite_names);
+
+    try {
+        // Register components
+        c->register_component<Component_Transform>();
+        c->register_component<Component_Collision>();
+        c->register_component<Component_Dynamics>();
+        c->register_component<Component_Sprite>();
+        c->register_component<Component_Animation>();
+        c->register_component<Component_Point>();
+        c->register_component<Component_Agent>(); // Player
+        c->register_component<Component_Mob_AI>();
+
+        // Sprite rendering system
+        ctx->sprite_render = c->register_system<System_Sprite_Render>();
+        Signature sprite_render_signature;
+        sprite_render_signature.set(c->get_component_type<Component_Sprite>()); // Operate only on sprites
+        c->set_system_signature<System_Sprite_Render>(sprite_render_signature);
+
+        // Tile map setup
+        ctx->tilemap = c->register_system<System_Tilemap>();
+        Signature tilemap_signature{ 0 }; // Operates on nothing
+        c->set_system_signature<System_Tilemap>(tilemap_signature);
+
+        ctx->tilemap->init();
+
+        // Point system setup
+        ctx->point = c->register_system<System_Point>();
+        Signature point_signature;
+        point_signature.set(c->get_component_type<Component_Point>()); // Operate only on points
+        c->set_system_signature<System_Point>(point_signature);
+
+        // Agent system setup
+        ctx->agent = c->register_system<System_Agent>();
+        Signature agent_signature;
+        agent_signature.set(c->get_component_type<Component_Agent>()); // Operate only on mobs
+        c->set_system_signature<System_Agent>(agent_signature);
+
+        ctx->agent->init();
+
+        // Mob AI setup
+        ctx->mob_ai = c->register_system<System_Mob_AI>();
+        Signature mob_ai_signature;
+        mob_ai_signature.set(c->get_component_type<Component_Mob_AI>()); // Operate only on mobs
+        c->set_system_signature<System_Mob_AI>(mob_ai_signature);
+
+        // Load backgrounds
+        ctx->background_textures.init(background_names, lazy_assets, max_backgrounds);
+    }
+    catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+
+        cenv_close(ctx);
+
+        return nullptr;
+    }
 
     // Reset spawns entities while generating map
-    reset();
+    reset(ctx);
 
-    return 0; // No error
+    return ctx;
+}
+
+cenv_make_data* cenv_get_make_data(cenv_context* ctx) {
+    return &ctx->make_data;
+}
+
+cenv_reset_data* cenv_get_reset_data(cenv_context* ctx) {
+    return &ctx->reset_data;
 }
 
-int32_t cenv_reset(cenv_option* options, int32_t options_size) {
+cenv_step_data* cenv_get_step_data(cenv_context* ctx) {
+    return &ctx->step_data;
+}
+
+cenv_render_data* cenv_get_render_data(cenv_context* ctx) {
+    return &ctx->render_data;
+}
+
+int32_t cenv_reset(cenv_context* ctx, cenv_option* options, int32_t options_size) {
+    bind(ctx);
+
     // Parse options
     for (int i = 0; i < options_size; i++) {
         std::string name(options[i].name);
@@ -295,32 +499,20 @@ int32_t cenv_reset(cenv_option* options, int32_t options_size) {
         if (name == "seed") {
             assert(options[i].value_type == CENV_VALUE_TYPE_INT);
 
-            rng.seed(options[i].value.i);
+            ctx->rng.seed(options[i].value.i);
         }
     }
 
-    reset();
-
-    render_game(true);
+    reset(ctx);
 
-    // Grab observation
-    SDL_LockSurface(obs_target);
-
-    uint8_t* pixels = (uint8_t*)obs_target->pixels;
-
-    for (int x = 0; x < obs_width; x++)
-        for (int y = 0; y < obs_height; y++) {
-            observation.value_buffer.b[0 + 3 * (y + obs_height * x)] = pixels[0 + 4 * (y + obs_height * x)];
-            observation.value_buffer.b[1 + 3 * (y + obs_height * x)] = pixels[1 + 4 * (y + obs_height * x)];
-            observation.value_buffer.b[2 + 3 * (y + obs_height * x)] = pixels[2 + 4 * (y + obs_height * x)];
-        }
-
-    SDL_UnlockSurface(obs_target);
+    render_observation(ctx, ctx->observation.value_buffer.b);
 
     return 0; // No error
 }
 
-int32_t cenv_step(cenv_key_value* actions, int32_t actions_size) {
+int32_t cenv_step(cenv_context* ctx, cenv_key_value* actions, int32_t actions_size) {
+    bind(ctx);
+
     int action = 0;
 
     // Parse actions
@@ -335,91 +527,262 @@ int32_t cenv_step(cenv_key_value* actions, int32_t actions_size) {
         }
     }
 
-    // Sub-steps
-    for (int ss = 0; ss < sub_steps; ss++) {
-        // Update systems
-        agent->update(dt, action);
-        bool dead = mob_ai->update(dt);
+    step_game(ctx, action);
 
-        point->update();
+    // Render and grab pixels
+    render_observation(ctx, ctx->observation.value_buffer.b);
 
-        sprite_render->update(dt);
+    return 0; // No error
+}
 
-        step_data.reward.f = point->point_delta + (point->num_points_available == 0) * 10.0f;
+int32_t cenv_reset_batch(cenv_context** contexts, int32_t num_envs, int32_t* seeds, uint8_t* observations) {
+    Thread_Pool* pool = acquire_thread_pool();
 
-        step_data.terminated = dead || (point->num_points_available == 0);
-        step_data.truncated = false;
+    std::atomic<bool> failed{ false }; // See cenv_step_batch
 
-        if (step_data.terminated)
-            break;
-    }
+    pool->parallel_for(num_envs, [&](int e) {
+        try {
+            cenv_context* ctx = contexts[e];
 
-    std::cout << "REWARD" << step_data.reward.f << "\n";
-    // Render and grab pixels
-    render_game(true);
+            bind(ctx);
 
-    // Grab observation
-    SDL_LockSurface(obs_target);
+            if (seeds != nullptr)
+                ctx->rng.seed(seeds[e]);
 
-    uint8_t* pixels = (uint8_t*)obs_target->pixels;
+            reset(ctx);
 
-    for (int x = 0; x < obs_width; x++)
-        for (int y = 0; y < obs_height; y++) {
-            observation.value_buffer.b[0 + 3 * (y + obs_height * x)] = pixels[0 + 4 * (y + obs_height * x)];
-            observation.value_buffer.b[1 + 3 * (y + obs_height * x)] = pixels[1 + 4 * (y + obs_height * x)];
-            observation.value_buffer.b[2 + 3 * (y + obs_height * x)] = pixels[2 + 4 * (y + obs_height * x)];
+            render_observation(ctx, observations + e * ctx->obs_builder.get_format().get_size());
+        }
+        catch (...) {
+            failed = true;
         }
+    });
+
+    release_thread_pool();
 
-    SDL_UnlockSurface(obs_target);
+    if (failed)
+        return 3; // Error, an environment failed
 
     return 0; // No error
 }
 
-int32_t cenv_render() {
-    render_game(false);
+int32_t cenv_step_batch(cenv_context** contexts, int32_t num_envs, int32_t* actions, uint8_t* observations, float* rewards, bool* terminated, bool* truncated, uint8_t* final_observations) {
+    Thread_Pool* pool = acquire_thread_pool();
 
-    // Grab pixels
-    SDL_LockSurface(window_target);
+    // An exception (such as an asset failing to load) must not escape the worker threads, the batch fails instead
+    std::atomic<bool> failed{ false };
+
+    pool->parallel_for(num_envs, [&](int e) {
+        try {
+            cenv_context* ctx = contexts[e];
+
+            bind(ctx);
+
+            step_game(ctx, actions[e]);
 
-    uint8_t* pixels = (uint8_t*)window_target->pixels;
+            rewards[e] = ctx->step_data.reward.f;
+            terminated[e] = ctx->step_data.terminated;
+            truncated[e] = ctx->step_data.truncated;
 
-    for (int x = 0; x < window_width; x++)
-        for (int y = 0; y < window_height; y++) {
-            render_data.value_buffer.b[0 + 3 * (y + window_height * x)] = pixels[0 + 4 * (y + window_height * x)];
-            render_data.value_buffer.b[1 + 3 * (y + window_height * x)] = pixels[1 + 4 * (y + window_height * x)];
-            render_data.value_buffer.b[2 + 3 * (y + window_height * x)] = pixels[2 + 4 * (y + window_height * x)];
+            // Auto-reset, the observation is then the first one of the next episode
+            if (terminated[e] || truncated[e]) {
+                if (final_observations != nullptr)
+                    render_observation(ctx, final_observations + e * ctx->obs_builder.get_format().get_size());
+
+                reset(ctx);
+            }
+
+            render_observation(ctx, observations + e * ctx->obs_builder.get_format().get_size());
+        }
+        catch (...) {
+            failed = true;
         }
+    });
 
-    SDL_UnlockSurface(window_target);
+    release_thread_pool();
+
+    if (failed)
+        return 3; // Error, an environment failed
+
+    return 0; // No error
+}
+
+int32_t cenv_step_async(cenv_context** contexts, int32_t num_envs, int32_t* actions, uint8_t* observations, float* rewards, bool* terminated, bool* truncated, uint8_t* final_observations) {
+    if (num_envs <= 0)
+        return 2; // Error, no environments
+
+    Pending_Step &step = contexts[0]->pending_step;
+
+    for (int e = 0; e < num_envs; e++) {
+        if (contexts[e]->batch_owner != nullptr)
+            return 1; // Error, previous step was not waited for
+    }
+
+    for (int e = 0; e < num_envs; e++)
+        contexts[e]->batch_owner = contexts[0];
+
+    acquire_thread_pool(); // Until waited for
+
+    step.contexts = contexts;
+    step.num_envs = num_envs;
+    step.actions = actions;
+    step.observations = observations;
+    step.rewards = rewards;
+    step.terminated = terminated;
+    step.truncated = truncated;
+    step.final_observations = final_observations;
+    step.started = true;
+
+    get_background_worker().start(&step);
+
+    return 0; // No error
+}
+
+int32_t cenv_step_wait(cenv_context** contexts) {
+    Pending_Step &step = contexts[0]->pending_step;
+
+    if (!step.started)
+        return 1; // Error, no step was started
+
+    get_background_worker().wait(&step);
+
+    step.started = false;
+
+    for (int e = 0; e < step.num_envs; e++)
+        step.contexts[e]->batch_owner = nullptr;
+
+    release_thread_pool();
+
+    return step.result;
+}
+
+int32_t cenv_set_threads(int32_t num_threads, bool pin_threads) {
+    std::lock_guard<std::mutex> lock(thread_pool_mutex);
+
+    if (thread_pool != nullptr && thread_pool->matches(num_threads, pin_threads))
+        return 0; // No error, already set up like this
+
+    if (thread_pool_users > 0)
+        return 1; // Error, batched calls are running on the current pool
+
+    thread_pool = std::make_unique<Thread_Pool>(num_threads, pin_threads);
+
+    return 0; // No error
+}
+
+int32_t cenv_get_state_size(cenv_context* ctx) {
+    bind(ctx);
+
+    State_Writer writer; // Measures
+
+    save_state(ctx, writer);
+
+    return writer.get_size();
+}
+
+int32_t cenv_save_state(cenv_context* ctx, uint8_t* buffer, int32_t buffer_size) {
+    bind(ctx);
+
+    State_Writer writer(buffer, buffer_size);
+
+    save_state(ctx, writer);
+
+    if (writer.failed())
+        return -1; // Error, buffer too small
+
+    return writer.get_size();
+}
+
+int32_t cenv_load_state(cenv_context* ctx, const uint8_t* buffer, int32_t buffer_size) {
+    bind(ctx);
+
+    State_Reader reader(buffer, buffer_size);
+
+    if (!load_state(ctx, reader))
+        return 1; // Error, not a state of this instance (left unchanged)
+
+    if (reader.failed()) {
+        // Don't leave a partially loaded state behind, observe the new episode like cenv_reset
+        reset(ctx);
+
+        render_observation(ctx, ctx->observation.value_buffer.b);
+
+        return 2; // Error, corrupted state
+    }
+
+    restore_observation(ctx, ctx->observation.value_buffer.b);
+
+    return 0; // No error
+}
+
+int32_t cenv_clone(cenv_context* src, cenv_context* dst) {
+    if (src == dst)
+        return 0; // No error
+
+    if (!can_clone(src, dst))
+        return 1; // Error, made with different options (left unchanged)
+
+    bind(dst);
+
+    clone_state(src, dst);
+
+    restore_observation(dst, dst->observation.value_buffer.b);
+
+    return 0; // No error
+}
+
+int32_t cenv_render(cenv_context* ctx) {
+    bind(ctx);
+
+    render_game(ctx, false);
+
+    // Grab pixels
+    copy_surface_rgb(ctx->window_target, ctx->render_data.value_buffer.b);
 
     return 0; // No error
 }
 
-void cenv_close() {
+void cenv_close(cenv_context* ctx) {
+    // Finish a background step still using the context (of any context of its batch)
+    if (ctx->batch_owner != nullptr) {
+        cenv_context* owner = ctx->batch_owner;
+
+        cenv_step_wait(&owner);
+    }
+
+    bind(ctx);
+
     // ---------------------- CEnv Interface ----------------------
     
     // Dealloc make data
-    for (int i = 0; i < make_data.observation_spaces_size; i++)
-        free(make_data.observation_spaces[i].value_buffer.f);
+    for (int i = 0; i < ctx->make_data.observation_spaces_size; i++)
+        free(ctx->make_data.observation_spaces[i].value_buffer.f);
 
-    free(make_data.observation_spaces);
+    free(ctx->make_data.observation_spaces);
 
-    for (int i = 0; i < make_data.action_spaces_size; i++)
-        free(make_data.action_spaces[i].value_buffer.i);
+    for (int i = 0; i < ctx->make_data.action_spaces_size; i++)
+        free(ctx->make_data.action_spaces[i].value_buffer.i);
 
-    free(make_data.action_spaces);
+    free(ctx->make_data.action_spaces);
 
     // Observations
-    free(observation.value_buffer.b);
+    free(ctx->observation.value_buffer.b);
 
     // Frame
-    free(render_data.value_buffer.b);
+    free(ctx->render_data.value_buffer.b);
     
     // ---------------------- Game ----------------------
 
-    // Explicit destruct before renderer
-    background_textures.clear();
-    manager_texture.clear();
+    SDL_Surface* window_target = ctx->window_target;
+    SDL_Surface* obs_target = ctx->obs_target;
+    SDL_Renderer* window_renderer = ctx->window_renderer;
+    SDL_Renderer* obs_renderer = ctx->obs_renderer;
+
+    // Textures (owned by the systems and the context) must be destroyed before their renderers
+    delete ctx;
+
+    bind(nullptr);
+
     SDL_DestroyRenderer(window_renderer);
     SDL_DestroyRenderer(obs_renderer);
 
@@ -427,71 +790,195 @@ void cenv_close() {
     SDL_DestroySurface(obs_target);
 }
 
+// Make the context's ECS, renderer and textures the ones used by the calling thread
+void bind(cenv_context* ctx) {
+    c = ctx == nullptr ? nullptr : &ctx->coordinator;
+    gr = ctx == nullptr ? nullptr : &ctx->renderer;
+    manager_texture = ctx == nullptr ? nullptr : &ctx->textures;
+    table_texture = ctx == nullptr ? nullptr : &ctx->texture_table;
+}
+
 // Rendering
-void render_game(bool is_obs) {
+void render_game(cenv_context* ctx, bool is_obs) {
     // If obs, set render to obs target
-    gr.rendering_obs = is_obs;
+    gr->rendering_obs = is_obs;
 
-    SDL_SetRenderDrawColor(gr.get_renderer(), 0, 0, 0, 255);
-    SDL_RenderClear(gr.get_renderer());
-    SDL_SetRenderDrawColor(gr.get_renderer(), 255, 255, 255, 255);
+    SDL_SetRenderDrawColor(gr->get_renderer(), 0, 0, 0, 255);
+    SDL_RenderClear(gr->get_renderer());
+    SDL_SetRenderDrawColor(gr->get_renderer(), 255, 255, 255, 255);
 
-    int width = is_obs ? obs_width : window_width;
-    int height = is_obs ? obs_height : window_height;
+    int width = is_obs ? obs_width : ctx->window_width;
+    int height = is_obs ? obs_height : ctx->window_height;
 
-    gr.camera_scale = game_zoom * static_cast<float>(width) / static_cast<float>(obs_width);
-    gr.camera_size = (Vector2){ static_cast<float>(width), static_cast<float>(height) };
+    gr->camera_scale = game_zoom * static_cast<float>(width) / static_cast<float>(obs_width);
+    gr->camera_size = (Vector2){ static_cast<float>(width), static_cast<float>(height) };
 
     // Draw background image
-    Asset_Texture* background = &background_textures[current_background_index];
+    Asset_Texture* background = &ctx->background_textures.get(ctx->current_background_index);
 
     float background_aspect = static_cast<float>(background->width) / static_cast<float>(background->height);
     float extra_width = background_aspect - 1.0f; // 1 for game world aspect, which is 64x64 tiles
     
-    gr.render_texture(background, Vector2{ -current_background_offset_x * extra_width, 0.0f }, 64.0f * unit_to_pixels / background->height);
+    gr->render_texture(background, Vector2{ -ctx->current_background_offset_x * extra_width, 0.0f }, 64.0f * unit_to_pixels / background->height);
+
+    ctx->sprite_render->render(negative_z);
+    ctx->tilemap->render(ctx->current_map_theme);
+    ctx->sprite_render->render(positive_z);
+    ctx->agent->render(ctx->current_agent_theme);
+}
+
+// Render the agent's view and write it to buffer in the observation format
+void render_observation(cenv_context* ctx, uint8_t* buffer) {
+    render_game(ctx, true);
+
+    ctx->obs_builder.build(ctx->obs_target, buffer);
+}
+
+// The observation of a loaded (or cloned) state, without adding another frame to the stack
+void restore_observation(cenv_context* ctx, uint8_t* buffer) {
+    if (ctx->obs_builder.get_format().frame_stack > 1)
+        ctx->obs_builder.stack(buffer);
+    else
+        render_observation(ctx, buffer);
+}
+
+// Advance the game by one action, filling in reward and termination of the step data
+void step_game(cenv_context* ctx, int action) {
+    // Sub-steps
+    for (int ss = 0; ss < sub_steps; ss++) {
+        // Update systems
+        ctx->agent->update(dt, action);
+        bool dead = ctx->mob_ai->update(dt);
+
+        ctx->point->update();
+
+        ctx->sprite_render->update(dt);
+
+        ctx->step_data.reward.f = ctx->point->point_delta + (ctx->point->num_points_available == 0) * 10.0f;
 
-    sprite_render->render(negative_z);
-    tilemap->render(current_map_theme);
-    sprite_render->render(positive_z);
-    agent->render(current_agent_theme);
+        ctx->step_data.terminated = dead || (ctx->point->num_points_available == 0);
+        ctx->step_data.truncated = false;
+
+        if (ctx->step_data.terminated)
+            break;
+    }
+
+    std::cout << "REWARD" << ctx->step_data.reward.f << "\n";
 }
 
-void reset() {
-    c.clear_entities();
+void reset(cenv_context* ctx) {
+    c->clear_entities();
 
-    tilemap->regenerate(rng, tilemap_config);
+    ctx->obs_builder.restart();
+
+    ctx->tilemap->regenerate(ctx->rng, ctx->tilemap_config);
     
-    gr.camera_position.x = tilemap->get_width() / 2.0f * unit_to_pixels;
+    gr->camera_position.x = ctx->tilemap->get_width() / 2.0f * unit_to_pixels;
 
     // Determine background (themeing)
-    std::uniform_int_distribution<int> background_dist(0, background_textures.size() - 1);
+    std::uniform_int_distribution<int> background_dist(0, ctx->background_textures.size() - 1);
 
-    current_background_index = background_dist(rng);
+    ctx->current_background_index = background_dist(ctx->rng);
 
     std::uniform_real_distribution<float> dist01(0.0f, 1.0f);
 
-    current_background_offset_x = dist01(rng);
+    ctx->current_background_offset_x = dist01(ctx->rng);
 
-    // Spawn the player (agent)
-    Entity e = c.create_entity();
+    // Spawn the player (ctx->agent)
+    Entity e = c->create_entity();
 
-    Vector2 pos{ 1.5f, tilemap->get_height() - 2 + 1.0f };
+    Vector2 pos{ 1.5f, ctx->tilemap->get_height() - 2 + 1.0f };
 
-    c.add_component(e, Component_Transform{ .position{ pos }, .scale=0.8f });
-    c.add_component(e, Component_Collision{ .bounds{ -0.5f, -1.0f, 1.0f, 1.0f } });
-    c.add_component(e, Component_Dynamics{});
-    c.add_component(e, Component_Agent{});
+    c->add_component(e, Component_Transform{ .position{ pos }, .scale=0.8f });
+    c->add_component(e, Component_Collision{ .bounds{ -0.5f, -1.0f, 1.0f, 1.0f } });
+    c->add_component(e, Component_Dynamics{});
+    c->add_component(e, Component_Agent{});
 
     // Determine themes
     std::uniform_int_distribution<int> agent_theme_dist(0, agent_themes.size() - 1);
 
-    current_agent_theme = agent_theme_dist(rng);
+    ctx->current_agent_theme = agent_theme_dist(ctx->rng);
 
     std::uniform_int_distribution<int> map_theme_dist(0, 4 - 1);
 
-    current_map_theme = map_theme_dist(rng);
+    ctx->current_map_theme = map_theme_dist(ctx->rng);
 
     // Clear before next render to remove now destroyed entities from previous episode
-    sprite_render->reset();
-    point->reset();
+    ctx->sprite_render->reset();
+    ctx->point->reset();
+}
+
+// Everything that changes over an episode. Textures are referenced by pointer, so the state belongs to this instance
+void save_state(cenv_context* ctx, State_Writer &writer) {
+    writer.write(version);
+    writer.write(ctx->instance_id);
+
+    c->save_state(writer);
+
+    writer.write(ctx->rng);
+    writer.write(gr->camera_position);
+
+    ctx->obs_builder.save_state(writer);
+
+    writer.write(ctx->current_map_theme);
+    writer.write(ctx->current_background_index);
+    writer.write(ctx->current_background_offset_x);
+    writer.write(ctx->current_agent_theme);
+}
+
+// Returns false (without loading anything) if the state wasn't saved by this instance
+bool load_state(cenv_context* ctx, State_Reader &reader) {
+    int state_version;
+    uint64_t state_instance_id;
+
+    reader.read(state_version);
+    reader.read(state_instance_id);
+
+    if (reader.failed() || state_version != version || state_instance_id != ctx->instance_id)
+        return false;
+
+    c->load_state(reader);
+
+    reader.read(ctx->rng);
+    reader.read(gr->camera_position);
+
+    ctx->obs_builder.load_state(reader);
+
+    reader.read(ctx->current_map_theme);
+    reader.read(ctx->current_background_index);
+    reader.read(ctx->current_background_offset_x);
+    reader.read(ctx->current_agent_theme);
+
+    return true;
+}
+
+// Whether the state of src fits dst, which holds when both were made with the same options
+bool can_clone(cenv_context* src, cenv_context* dst) {
+    return src->obs_builder.get_format() == dst->obs_builder.get_format() &&
+        src->tilemap->get_width() == dst->tilemap->get_width() && src->tilemap->get_height() == dst->tilemap->get_height();
+}
+
+// Copies the state of src into dst (bound) directly, otherwise like load_state
+void clone_state(cenv_context* src, cenv_context* dst) {
+    c->copy_state(src->coordinator);
+
+    dst->rng = src->rng;
+    gr->camera_position = src->renderer.camera_position;
+
+    dst->obs_builder.copy_state(src->obs_builder);
+
+    dst->current_map_theme = src->current_map_theme;
+    dst->current_background_index = src->current_background_index;
+    dst->current_background_offset_x = src->current_background_offset_x;
+    dst->current_agent_theme = src->current_agent_theme;
+
+    // Copied components point at the textures of src, switch them over to the same textures of dst
+    c->view<Component_Sprite>().each([](Entity, Component_Sprite &sprite) {
+        sprite.texture = table_texture->translate(sprite.texture);
+    });
+
+    c->view<Component_Animation>().each([](Entity, Component_Animation &animation) {
+        for (Asset_Texture* &frame : animation.frames)
+            frame = table_texture->translate(frame);
+    });
 }
@@ -4,34 +4,31 @@
 
 #include "helpers.h"
 
+// Walls
+static const Collision_Mask wall_mask = make_collision_mask({ { wall_top, full }, { wall_mid, full } });
 
 void System_Sprite_Render::update(float dt) {
-    if (render_entities.size() != entities.size())
-        render_entities.resize(entities.size());
+    render_entities.clear();
 
-    int index = 0;
+    // Optional
+    Component_Array<Component_Animation>* animations = c->get_component_array<Component_Animation>();
 
-    for (auto const &e : entities) {
-        auto &sprite = c.get_component<Component_Sprite>(e);
-
-        // If also has animation
-        if (c.entity_manager.get_signature(e)[c.component_manager.get_component_type<Component_Animation>()]) {
-            // Has animation component
-            auto &animation = c.get_component<Component_Animation>(e);
+    c->view<Component_Sprite>().each([&](Entity e, Component_Sprite &sprite) {
+        Component_Animation* animation = animations->try_get(e);
 
-            animation.t += dt;
+        if (animation != nullptr) {
+            animation->t += dt;
 
-            int frames_advance = animation.t * animation.rate;
-            animation.t -= frames_advance / animation.rate; 
+            int frames_advance = animation->t * animation->rate;
+            animation->t -= frames_advance / animation->rate; 
                 
-            animation.frame_index = (animation.frame_index + frames_advance) % animation.frames.size();
+            animation->frame_index = (animation->frame_index + frames_advance) % animation->frames.size();
 
-            sprite.texture = animation.frames[animation.frame_index];
+            sprite.texture = animation->frames[animation->frame_index];
         }
 
-        render_entities[index] = std::make_pair(sprite.z, e);
-        index++;
-    }
+        render_entities.push_back(std::make_pair(sprite.z, e));
+    });
     
     // Sort sprites
     std::sort(render_entities.begin(), render_entities.end(), [](const std::pair<float, Entity> &left, const std::pair<float, Entity> &right) {
@@ -44,8 +41,8 @@ void System_Sprite_Render::render(Sprite_Render_Mode mode) {
     for (size_t i = 0; i < render_entities.size(); i++) {
         Entity e = render_entities[i].second;
 
-        auto const &sprite = c.get_component<Component_Sprite>(e);
-        auto const &transform = c.get_component<Component_Transform>(e);
+        auto const &sprite = c->get_component<Component_Sprite>(e);
+        auto const &transform = c->get_component<Component_Transform>(e);
 
         if (sprite.texture == nullptr)
             continue;
@@ -59,21 +56,21 @@ void System_Sprite_Render::render(Sprite_Render_Mode mode) {
         float scale = transform.scale * sprite.scale;
 
         // If visible
-        gr.render_texture(sprite.texture, (Vector2){ (transform.position.x + sprite.position.x) * unit_to_pixels, (transform.position.y + sprite.position.y) * unit_to_pixels }, scale * unit_to_pixels / sprite.texture->width, 1.0f, sprite.flip_x);
+        gr->render_texture(sprite.texture, (Vector2){ (transform.position.x + sprite.position.x) * unit_to_pixels, (transform.position.y + sprite.position.y) * unit_to_pixels }, scale * unit_to_pixels / sprite.texture->width, 1.0f, sprite.flip_x);
     }
 }
 
 void System_Point::update() {
     // get entities
-    std::shared_ptr<System_Mob_AI> mob_ai = c.system_manager.get_system<System_Mob_AI>();
+    std::shared_ptr<System_Mob_AI> mob_ai = c->system_manager.get_system<System_Mob_AI>();
 
     // get agent
-    std::shared_ptr<System_Agent> agent = c.system_manager.get_system<System_Agent>();
+    std::shared_ptr<System_Agent> agent = c->system_manager.get_system<System_Agent>();
 
     Entity e_agent = *agent->entities.begin();
 
-    const Component_Transform &agent_transform = c.get_component<Component_Transform>(e_agent);
-    const Component_Collision &agent_collision = c.get_component<Component_Collision>(e_agent);
+    const Component_Transform &agent_transform = c->get_component<Component_Transform>(e_agent);
+    const Component_Collision &agent_collision = c->get_component<Component_Collision>(e_agent);
 
     Rectangle agent_rect = agent_collision.bounds;
     agent_rect.x += agent_transform.position.x;
@@ -82,11 +79,11 @@ void System_Point::update() {
     num_points_available = 0;
     point_delta = 0;
 
-    std::vector<Entity> to_destroy;
+    to_destroy.clear();
 
     for (auto const &e : entities) {
-        auto &transform = c.get_component<Component_Transform>(e);
-        auto &collision = c.get_component<Component_Collision>(e);
+        auto &transform = c->get_component<Component_Transform>(e);
+        auto &collision = c->get_component<Component_Collision>(e);
 
         Rectangle rect = collision.bounds;
         rect.x += transform.position.x;
@@ -103,7 +100,7 @@ void System_Point::update() {
     }
 
     for (int i = 0; i < to_destroy.size(); i++)
-        c.destroy_entity(to_destroy[i]);
+        c->destroy_entity(to_destroy[i]);
 }
 
 bool System_Mob_AI::update(float dt) {
@@ -112,32 +109,30 @@ bool System_Mob_AI::update(float dt) {
     bool player_hit = false;
 
     // Get tile map system
-    std::shared_ptr<System_Tilemap> tilemap = c.system_manager.get_system<System_Tilemap>();
-    std::shared_ptr<System_Agent> agent = c.system_manager.get_system<System_Agent>();
+    std::shared_ptr<System_Tilemap> tilemap = c->system_manager.get_system<System_Tilemap>();
+    std::shared_ptr<System_Agent> agent = c->system_manager.get_system<System_Agent>();
 
     Entity e_agent = *agent->entities.begin();
 
-    const Component_Transform &agent_transform = c.get_component<Component_Transform>(e_agent);
-    const Component_Collision &agent_collision = c.get_component<Component_Collision>(e_agent);
+    const Component_Transform &agent_transform = c->get_component<Component_Transform>(e_agent);
+    const Component_Collision &agent_collision = c->get_component<Component_Collision>(e_agent);
 
     Rectangle agent_rect = agent_collision.bounds;
     agent_rect.x += agent_transform.position.x;
     agent_rect.y += agent_transform.position.y;
 
     for (auto const &e : entities) {
-        auto &mob_ai = c.get_component<Component_Mob_AI>(e);
+        auto &mob_ai = c->get_component<Component_Mob_AI>(e);
 
-        auto &transform = c.get_component<Component_Transform>(e);
-        auto &collision = c.get_component<Component_Collision>(e);
+        auto &transform = c->get_component<Component_Transform>(e);
+        auto &collision = c->get_component<Component_Collision>(e);
 
         // Move
         transform.position.x += mob_ai.velocity_x * dt;
 
         Rectangle wall_sensor{ transform.position.x - 0.5f, transform.position.y - 0.6f, 1.0f, 0.5f };
 
-        std::pair<Vector2, bool> wall_collision_data = tilemap->get_collision(wall_sensor, [](Tile_ID id) -> Collision_Type {
-            return (id == wall_mid || id == wall_top ? full : none);
-        });
+        std::pair<Vector2, bool> wall_collision_data = tilemap->get_collision(wall_sensor, wall_mask);
 
         float new_x = wall_collision_data.first.x + 0.5f;
 
@@ -158,7 +153,7 @@ bool System_Mob_AI::update(float dt) {
             mob_ai.velocity_x *= -1.0f; // Rebound
 
         // Choose texture sprite
-        auto &sprite = c.get_component<Component_Sprite>(e);
+        auto &sprite = c->get_component<Component_Sprite>(e);
 
         // Flip sprite if needed
         sprite.flip_x = mob_ai.velocity_x < 0.0f;
@@ -190,20 +185,20 @@ void System_Agent::update(float dt, int action) {
     const float air_control = 0.15f;
 
     // Get tile map system
-    std::shared_ptr<System_Tilemap> tilemap = c.system_manager.get_system<System_Tilemap>();
+    std::shared_ptr<System_Tilemap> tilemap = c->system_manager.get_system<System_Tilemap>();
 
     assert(entities.size() == 1); // Only one player
 
     for (auto const &e : entities) {
-        auto &agent = c.get_component<Component_Agent>(e);
+        auto &agent = c->get_component<Component_Agent>(e);
 
         // Set action
         agent.action = action;
 
-        auto &transform = c.get_component<Component_Transform>(e);
-        auto &dynamics = c.get_component<Component_Dynamics>(e);
+        auto &transform = c->get_component<Component_Transform>(e);
+        auto &dynamics = c->get_component<Component_Dynamics>(e);
 
-        const auto &collision = c.get_component<Component_Collision>(e);
+        const auto &collision = c->get_component<Component_Collision>(e);
 
         float movement_x = (agent.action == 6 || agent.action == 7 || agent.action == 8) - (agent.action == 0 || agent.action == 1 || agent.action == 2);
         bool jump = (agent.action == 2 || agent.action == 5 || agent.action == 8);
@@ -232,9 +227,7 @@ void System_Agent::update(float dt, int action) {
         // World space collision
         Rectangle world_collision{ transform.position.x + collision.bounds.x, transform.position.y + collision.bounds.y, collision.bounds.width, collision.bounds.height };
 
-        std::pair<Vector2, bool> collision_data = tilemap->get_collision(world_collision, [](Tile_ID id) -> Collision_Type {
-            return (id == wall_mid || id == wall_top ? full : none);
-        });
+        std::pair<Vector2, bool> collision_data = tilemap->get_collision(world_collision, wall_mask);
 
         // If was moved up, on ground
         Vector2 delta_position{ collision_data.first.x - world_collision.x, collision_data.first.y - world_collision.y };
@@ -256,7 +249,7 @@ void System_Agent::update(float dt, int action) {
             dynamics.velocity.y = 0.0f;
         
         // Camera follows the agent
-        gr.camera_position.y = (transform.position.y - 8 - 0.5f) * unit_to_pixels;
+        gr->camera_position.y = (transform.position.y - 8 - 0.5f) * unit_to_pixels;
 
         // Animation cycle
         agent.t += agent.rate * dt;
@@ -273,9 +266,9 @@ void System_Agent::render(int theme) {
     assert(entities.size() == 1); // Only one player
 
     for (auto const &e : entities) {
-        auto const &agent = c.get_component<Component_Agent>(e);
-        auto const &transform = c.get_component<Component_Transform>(e);
-        auto const &dynamics = c.get_component<Component_Dynamics>(e);
+        auto const &agent = c->get_component<Component_Agent>(e);
+        auto const &transform = c->get_component<Component_Transform>(e);
+        auto const &dynamics = c->get_component<Component_Dynamics>(e);
 
         // Select the correct texture
         Asset_Texture* texture;
@@ -291,6 +284,6 @@ void System_Agent::render(int theme) {
 
         Vector2 position{ transform.position.x - 0.5f, transform.position.y - 1.0f };
 
-        gr.render_texture(texture, (Vector2){ position.x * unit_to_pixels, position.y * unit_to_pixels }, transform.scale * unit_to_pixels / texture->width, 1.0f, !agent.face_forward);
+        gr->render_texture(texture, (Vector2){ position.x * unit_to_pixels, position.y * unit_to_pixels }, transform.scale * unit_to_pixels / texture->width, 1.0f, !agent.face_forward);
     }
 }
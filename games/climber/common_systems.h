@@ -28,10 +28,27 @@ public:
     void reset() {
         render_entities.clear();
     }
+
+    void save_state(State_Writer &writer) const override {
+        writer.write(render_entities, max_entities);
+    }
+
+    void load_state(State_Reader &reader) override {
+        reader.read(render_entities, max_entities);
+    }
+
+    void copy_state(const System &other) override {
+        const System_Sprite_Render &other_system = static_cast<const System_Sprite_Render&>(other);
+
+        render_entities = other_system.render_entities;
+    }
 };
 
 // Empty mostly, since just need it to collect points for agent system
 class System_Point : public System {
+private:
+    std::vector<Entity> to_destroy; // Of update, kept so that collecting doesn't allocate
+
 public:
     int num_points_collected = 0;
     int point_delta = 0;
@@ -44,6 +61,26 @@ public:
         point_delta = 0;
         num_points_available = 0;
     }
+
+    void save_state(State_Writer &writer) const override {
+        writer.write(num_points_collected);
+        writer.write(point_delta);
+        writer.write(num_points_available);
+    }
+
+    void load_state(State_Reader &reader) override {
+        reader.read(num_points_collected);
+        reader.read(point_delta);
+        reader.read(num_points_available);
+    }
+
+    void copy_state(const System &other) override {
+        const System_Point &other_system = static_cast<const System_Point&>(other);
+
+        num_points_collected = other_system.num_points_collected;
+        point_delta = other_system.point_delta;
+        num_points_available = other_system.num_points_available;
+    }
 };
 
 // --------------------- Mob AI --------------------
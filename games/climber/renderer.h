@@ -5,14 +5,31 @@
 
 #include "helpers.h"
 
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
 class Asset_Texture;
+class Texture_Data;
 
 class Renderer {
+private:
+    std::vector<uint32_t> blit_row; // Sampled texels of the row being blitted
+
+    struct Atlas_Textures {
+        std::shared_ptr<const Texture_Data> atlas; // Kept so that the address isn't reused for another one
+        SDL_Texture* obs_texture = nullptr;
+        SDL_Texture* window_texture = nullptr;
+    };
+
+    std::unordered_map<const Texture_Data*, Atlas_Textures> atlas_textures;
+
 public:
     bool rendering_obs = false;
 
     SDL_Renderer* window_renderer = nullptr;
     SDL_Renderer* obs_renderer = nullptr;
+    SDL_Surface* obs_target = nullptr; // Axis-aligned observation draws go here directly, bypassing obs_renderer
 
     // Camera
     Vector2 camera_position{ 0 };
@@ -22,6 +39,14 @@ public:
     void render_texture(Asset_Texture* texture, const Vector2 &position, float scale = 1.0f, float alpha = 1.0f, bool flip_horizontal = false, bool flip_vertical = false);
     void render_texture_rotated(Asset_Texture* texture, const Vector2 &position, float rotation, float scale = 1.0f, float alpha = 1.0f);
 
+    // Software blit of (part of) a texture into obs_target with nearest sampling and alpha blending, as SDL's software renderer would.
+    // Tolerance against SDL: blended channels may differ by 1 (rounding), samples landing exactly on a texel edge may take the neighbouring
+    // texel, and where SDL filters linearly this takes the nearest texel. Shrunk textures are sampled from box-filtered mips instead
+    void blit_obs(Asset_Texture* texture, const SDL_FRect &src_rect, const SDL_FRect &dst_rect, float alpha = 1.0f, bool flip_horizontal = false, bool flip_vertical = false);
+
+    // SDL texture of a texture atlas for obs_renderer or window_renderer, made on first use and shared by all textures in the atlas
+    SDL_Texture* get_atlas_texture(const std::shared_ptr<const Texture_Data> &atlas, bool obs);
+
     SDL_Renderer* get_renderer() const {
         return rendering_obs ? obs_renderer : window_renderer;
     }
@@ -29,5 +54,15 @@ public:
     ~Renderer();
 };
 
-extern Renderer gr; // Global renderer
+extern thread_local Renderer* gr; // Renderer of the environment bound to the calling thread
+
+// Pack RGBA pixels (as in the render targets) into RGB. Uses SSSE3/AVX2 or NEON where available
+void rgba_to_rgb(const uint8_t* src, uint8_t* dst, int num_pixels);
+
+// Alpha blend RGBA pixels over opaque RGBA pixels (dst = src * a + dst * (1 - a), with a the source alpha times alpha_mod / 255). Uses SSE2 or NEON where available
+void blend_rgba(const uint8_t* src, uint8_t* dst, int num_pixels, int alpha_mod = 255);
+
+// Copy the pixels of a render target into a tightly packed buffer, as RGB or as-is (RGBA)
+void copy_surface_rgb(SDL_Surface* surface, uint8_t* dst);
+void copy_surface_rgba(SDL_Surface* surface, uint8_t* dst);
 
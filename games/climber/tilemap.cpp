@@ -18,11 +18,11 @@ void System_Tilemap::init() {
     id_to_textures[wall_mid][3].load("assets/platformer/tileBrown_09.png");
 
     // Preload enemies
-    manager_texture.get("assets/platformer/enemySwimming_1.png");
-    manager_texture.get("assets/platformer/enemySwimming_2.png");
+    manager_texture->get("assets/platformer/enemySwimming_1.png");
+    manager_texture->get("assets/platformer/enemySwimming_2.png");
 
     // Pre-load coin
-    manager_texture.get("assets/misc_assets/yellowCrystal.png");
+    manager_texture->get("assets/misc_assets/yellowCrystal.png");
 }
 
 // Tile manipulation
@@ -40,39 +40,41 @@ void System_Tilemap::set_area_with_top(int x, int y, int width, int height, Tile
 void System_Tilemap::spawn_enemy_mob(int x, int y, std::mt19937 &rng) {
     std::uniform_int_distribution<int> dist2(0, 1);
 
-    Entity e = c.create_entity();
+    Entity e = c->create_entity();
     
     Vector2 pos = { static_cast<float>(x) + 0.5f, static_cast<float>(map_height - 1 - y) + 0.5f };
 
     Component_Animation animation;
     animation.frames.resize(2);
-    animation.frames[0] = &manager_texture.get("assets/platformer/enemySwimming_1.png");
-    animation.frames[1] = &manager_texture.get("assets/platformer/enemySwimming_2.png");
+    animation.frames[0] = &manager_texture->get("assets/platformer/enemySwimming_1.png");
+    animation.frames[1] = &manager_texture->get("assets/platformer/enemySwimming_2.png");
     animation.rate = 0.2f;
 
-    c.add_component(e, Component_Transform{ .position{ pos } });
-    c.add_component(e, Component_Sprite{ .position{ -0.4f, -0.4f }, .scale=1.0f, .z = 1.0f });
-    c.add_component(e, Component_Collision{ .bounds{ -0.4f, -0.4f, 0.8f, 0.8f }});
-    c.add_component(e, Component_Mob_AI{ .velocity_x = 0.15f * (dist2(rng) * 2.0f - 1.0f), .spawn_x = x});
-    c.add_component(e, animation);
+    c->add_component(e, Component_Transform{ .position{ pos } });
+    c->add_component(e, Component_Sprite{ .position{ -0.4f, -0.4f }, .scale=1.0f, .z = 1.0f });
+    c->add_component(e, Component_Collision{ .bounds{ -0.4f, -0.4f, 0.8f, 0.8f }});
+    c->add_component(e, Component_Mob_AI{ .velocity_x = 0.15f * (dist2(rng) * 2.0f - 1.0f), .spawn_x = x});
+    c->add_component(e, animation);
 }
 
 void System_Tilemap::spawn_point(int x, int y) {
 
-    Entity e = c.create_entity();
+    Entity e = c->create_entity();
 
     Vector2 pos = { static_cast<float>(x) + 0.5f, static_cast<float>(map_height - 1 - y) + 0.5f };
-    Asset_Texture* texture = &manager_texture.get("assets/misc_assets/yellowCrystal.png");
+    Asset_Texture* texture = &manager_texture->get("assets/misc_assets/yellowCrystal.png");
 
-    c.add_component(e, Component_Transform{ .position{ pos } });
-    c.add_component(e, Component_Sprite{ .position{ -0.5f, -0.5f }, .z = 1.0f, .texture = texture });
-    c.add_component(e, Component_Collision{ .bounds{ -0.5f, -0.5f, 1.0f, 1.0f }});
-    c.add_component(e, Component_Point{});
+    c->add_component(e, Component_Transform{ .position{ pos } });
+    c->add_component(e, Component_Sprite{ .position{ -0.5f, -0.5f }, .z = 1.0f, .texture = texture });
+    c->add_component(e, Component_Collision{ .bounds{ -0.5f, -0.5f, 1.0f, 1.0f }});
+    c->add_component(e, Component_Point{});
 }
 
 
 // Main map generation
 void System_Tilemap::regenerate(std::mt19937 &rng, const Config &cfg) {
+    layer.invalidate();
+
     const int main_width = 20;
     const int main_height = 64;
     const float max_jump = 1.5f;
@@ -171,9 +173,32 @@ void System_Tilemap::regenerate(std::mt19937 &rng, const Config &cfg) {
     }
 }
 
+Asset_Texture* System_Tilemap::get_tile_texture(int x, int y, int theme) {
+    Tile_ID id = get(x, map_height - 1 - y);
+
+    if (id == empty)
+        return nullptr;
+
+    if (id >= id_to_textures.size() || id_to_textures[id].empty())
+        return nullptr;
+
+    return &id_to_textures[id][theme];
+}
+
 void System_Tilemap::render(int theme) {
-    Rectangle camera_aabb{ (gr.camera_position.x - gr.camera_size.x * 0.5f / gr.camera_scale) * pixels_to_unit, (gr.camera_position.y - gr.camera_size.y * 0.5f / gr.camera_scale) * pixels_to_unit,
-        gr.camera_size.x * pixels_to_unit / gr.camera_scale, gr.camera_size.y * pixels_to_unit / gr.camera_scale };
+    if (gr->rendering_obs) {
+        if (theme != layer_theme) {
+            layer.invalidate();
+            layer_theme = theme;
+        }
+
+        layer.render(map_width, map_height, [&](int x, int y) { return get_tile_texture(x, y, theme); });
+
+        return;
+    }
+
+    Rectangle camera_aabb{ (gr->camera_position.x - gr->camera_size.x * 0.5f / gr->camera_scale) * pixels_to_unit, (gr->camera_position.y - gr->camera_size.y * 0.5f / gr->camera_scale) * pixels_to_unit,
+        gr->camera_size.x * pixels_to_unit / gr->camera_scale, gr->camera_size.y * pixels_to_unit / gr->camera_scale };
 
     int lower_x = std::floor(camera_aabb.x);
     int lower_y = std::floor(camera_aabb.y);
@@ -182,21 +207,16 @@ void System_Tilemap::render(int theme) {
     
     for (int y = lower_y; y <= upper_y; y++)
         for (int x = lower_x; x <= upper_x; x++) {
-            Tile_ID id = get(x, map_height - 1 - y);
-
-            if (id == empty)
-                continue;
+            Asset_Texture* tex = get_tile_texture(x, y, theme);
 
-            if (id >= id_to_textures.size() || id_to_textures[id].empty())
+            if (tex == nullptr)
                 continue;
 
-            Asset_Texture* tex = &id_to_textures[id][theme];
-
-            gr.render_texture(tex, (Vector2){ x * unit_to_pixels, y * unit_to_pixels }, unit_to_pixels / tex->width);
+            gr->render_texture(tex, (Vector2){ x * unit_to_pixels, y * unit_to_pixels }, unit_to_pixels / tex->width);
         }
 }
 
-std::pair<Vector2, bool> System_Tilemap::get_collision(Rectangle rectangle, const std::function<Collision_Type(Tile_ID)> &collision_id_func) {
+std::pair<Vector2, bool> System_Tilemap::get_collision(Rectangle rectangle, const Collision_Mask &collision_mask) {
     bool collided = false;
 
     int lower_x = std::floor(rectangle.x);
@@ -214,7 +234,7 @@ std::pair<Vector2, bool> System_Tilemap::get_collision(Rectangle rectangle, cons
         for (int x = lower_x; x <= upper_x; x++) {
             Tile_ID id = get(x, map_height - 1 - y);
 
-            Collision_Type type = collision_id_func(id);
+            Collision_Type type = collision_mask[id];
 
             if (type != none) {
                 tile.x = x;
@@ -237,7 +257,7 @@ std::pair<Vector2, bool> System_Tilemap::get_collision(Rectangle rectangle, cons
         for (int x = lower_x; x <= upper_x; x++) {
             Tile_ID id = get(x, map_height - 1 - y);
 
-            Collision_Type type = collision_id_func(id);
+            Collision_Type type = collision_mask[id];
 
             if (type != none) {
                 tile.x = x;
@@ -258,3 +278,48 @@ std::pair<Vector2, bool> System_Tilemap::get_collision(Rectangle rectangle, cons
 
     return std::make_pair(Vector2{ rectangle.x, rectangle.y }, collided);
 }
+
+void System_Tilemap::save_state(State_Writer &writer) const {
+    writer.write(map_width);
+    writer.write(map_height);
+    writer.write(tile_ids);
+}
+
+void System_Tilemap::load_state(State_Reader &reader) {
+    int loaded_width = -1, loaded_height = -1;
+
+    reader.read(loaded_width);
+    reader.read(loaded_height);
+
+    // Map size is fixed per instance
+    if (loaded_width != map_width || loaded_height != map_height) {
+        reader.fail();
+
+        return;
+    }
+
+    loaded_tile_ids.resize(tile_ids.size());
+
+    reader.read(loaded_tile_ids);
+
+    if (reader.failed())
+        return;
+
+    set_tiles(loaded_tile_ids);
+}
+
+void System_Tilemap::copy_state(const System &other) {
+    const System_Tilemap &other_tilemap = static_cast<const System_Tilemap&>(other);
+
+    // Map size is fixed per instance, cenv_clone checks that it matches
+    assert(other_tilemap.map_width == map_width && other_tilemap.map_height == map_height);
+
+    set_tiles(other_tilemap.tile_ids);
+}
+
+void System_Tilemap::set_tiles(const std::vector<Tile_ID> &ids) {
+    for (int i = 0; i < static_cast<int>(tile_ids.size()); i++) {
+        if (ids[i] != tile_ids[i])
+            set(i / map_height, i % map_height, ids[i]);
+    }
+}
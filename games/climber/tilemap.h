@@ -4,11 +4,13 @@
 #include "common_assets.h"
 #include "helpers.h"
 #include "ecs.h"
+#include "tile_layer.h"
 
 #include <cmath>
 #include <algorithm>
 #include <random>
-#include <functional>
+#include <array>
+#include <initializer_list>
 
 enum Tile_ID {
     empty = 0,
@@ -22,6 +24,21 @@ enum Collision_Type {
     full
 };
 
+// Collision type by tile id, see System_Tilemap::get_collision
+typedef std::array<Collision_Type, num_ids> Collision_Mask;
+
+// Mask with the given types, none for the other ids
+inline Collision_Mask make_collision_mask(std::initializer_list<std::pair<Tile_ID, Collision_Type>> types) {
+    Collision_Mask mask;
+
+    mask.fill(none);
+
+    for (auto const &type : types)
+        mask[type.first] = type.second;
+
+    return mask;
+}
+
 // Tile map system
 class System_Tilemap : public System {
 public:
@@ -38,7 +55,14 @@ private:
 
     std::vector<std::vector<Asset_Texture>> id_to_textures;
 
+    Tile_Layer layer; // Baked map for observations
+    int layer_theme = -1; // Theme the layer was baked with
+
     std::vector<Tile_ID> tile_ids;
+    std::vector<Tile_ID> loaded_tile_ids; // Compared against the current tiles to only re-bake what changed
+
+    // Set all tiles, only re-baking the ones that changed
+    void set_tiles(const std::vector<Tile_ID> &ids);
 
     void spawn_enemy_mob(int x, int y, std::mt19937 &rng);
     void spawn_point(int x, int y);
@@ -56,6 +80,8 @@ public:
             return;
 
         tile_ids[y + x * map_height] = id;
+
+        layer.invalidate(x, map_height - 1 - y);
     }
 
     // Top left corner x y, size, id to fill
@@ -70,10 +96,13 @@ public:
         return tile_ids[y + x * map_height];
     }
 
+    // Texture of the tile at render coordinates (y flipped), nullptr if empty
+    Asset_Texture* get_tile_texture(int x, int y, int theme);
+
     void render(int theme);
 
     // General collision detection, returns new rectangle position and a collision flag
-    std::pair<Vector2, bool> get_collision(Rectangle rectangle, const std::function<Collision_Type(Tile_ID)> &collision_id_func);
+    std::pair<Vector2, bool> get_collision(Rectangle rectangle, const Collision_Mask &collision_mask);
 
     int get_width() const {
         return map_width;
@@ -82,4 +111,8 @@ public:
     int get_height() const {
         return map_height;
     }
+
+    void save_state(State_Writer &writer) const override;
+    void load_state(State_Reader &reader) override;
+    void copy_state(const System &other) override;
 };
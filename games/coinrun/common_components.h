@@ -2,6 +2,11 @@
 
 #include "ecs.h"
 #include "common_assets.h"
+#include "inline_vector.h"
+
+// Capacities of the inline storage in components
+const int max_animation_frames = 4;
+const int max_particles = 16;
 
 // General
 struct Component_Transform {
@@ -34,7 +39,7 @@ struct Component_Sprite {
 };
 
 struct Component_Animation { // Requires a Component_Sprite as well in order to function
-    std::vector<Asset_Texture*> frames;
+    Inline_Vector<Asset_Texture*, max_animation_frames> frames;
 
     int frame_index = 0;
     float rate = 0.1f;
@@ -67,10 +72,24 @@ struct Particle {
 };
 
 struct Component_Particles {
-    std::vector<Particle> particles;
+    Inline_Vector<Particle, max_particles> particles;
 
     Vector2 offset{ 0.0f, 0.0f };
     float lifespan = 5.0f;
     float spawn_timer = 0.0f;
     float spawn_time = 0.5f;
 };
+
+// Component types of the game, in signature bit order
+struct Component_List : Type_List<
+    Component_Transform,
+    Component_Collision,
+    Component_Dynamics,
+    Component_Sprite,
+    Component_Animation,
+    Component_Hazard,
+    Component_Goal,
+    Component_Mob_AI,
+    Component_Agent,
+    Component_Particles
+> {};
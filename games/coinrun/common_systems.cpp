@@ -4,33 +4,37 @@
 
 #include "helpers.h"
 
-void System_Sprite_Render::update(float dt) {
-    if (render_entities.size() != entities.size())
-        render_entities.resize(entities.size());
+// Walls
+static const Collision_Mask wall_mask = make_collision_mask({ { wall_top, full }, { wall_mid, full } });
+// Gaps in the floor (for mobs turning at ledges)
+static const Collision_Mask floor_mask = make_collision_mask({ { empty, full } });
+// Walls, and crates from above
+static const Collision_Mask agent_mask = make_collision_mask({ { wall_top, full }, { wall_mid, full }, { crate, down_only } });
+// Lava
+static const Collision_Mask lava_mask = make_collision_mask({ { lava_top, full }, { lava_mid, full } });
 
-    int index = 0;
+void System_Sprite_Render::update(float dt) {
+    render_entities.clear();
 
-    for (auto const &e : entities) {
-        auto &sprite = c.get_component<Component_Sprite>(e);
+    // Optional
+    Component_Array<Component_Animation>* animations = c->get_component_array<Component_Animation>();
 
-        // If also has animation
-        if (c.entity_manager.get_signature(e)[c.component_manager.get_component_type<Component_Animation>()]) {
-            // Has animation component
-            auto &animation = c.get_component<Component_Animation>(e);
+    c->view<Component_Sprite>().each([&](Entity e, Component_Sprite &sprite) {
+        Component_Animation* animation = animations->try_get(e);
 
-            animation.t += dt;
+        if (animation != nullptr) {
+            animation->t += dt;
 
-            int frames_advance = animation.t * animation.rate;
-            animation.t -= frames_advance / animation.rate; 
+            int frames_advance = animation->t * animation->rate;
+            animation->t -= frames_advance / animation->rate; 
                 
-            animation.frame_index = (animation.frame_index + frames_advance) % animation.frames.size();
+            animation->frame_index = (animation->frame_index + frames_advance) % animation->frames.size();
 
-            sprite.texture = animation.frames[animation.frame_index];
+            sprite.texture = animation->frames[animation->frame_index];
         }
 
-        render_entities[index] = std::make_pair(sprite.z, e);
-        index++;
-    }
+        render_entities.push_back(std::make_pair(sprite.z, e));
+    });
     
     // Sort sprites
     std::sort(render_entities.begin(), render_entities.end(), [](const std::pair<float, Entity> &left, const std::pair<float, Entity> &right) {
@@ -43,8 +47,8 @@ void System_Sprite_Render::render(Sprite_Render_Mode mode) {
     for (size_t i = 0; i < render_entities.size(); i++) {
         Entity e = render_entities[i].second;
 
-        auto const &sprite = c.get_component<Component_Sprite>(e);
-        auto const &transform = c.get_component<Component_Transform>(e);
+        auto const &sprite = c->get_component<Component_Sprite>(e);
+        auto const &transform = c->get_component<Component_Transform>(e);
 
         if (sprite.texture == nullptr)
             continue;
@@ -58,18 +62,64 @@ void System_Sprite_Render::render(Sprite_Render_Mode mode) {
         float scale = transform.scale * sprite.scale;
 
         // If visible
-        gr.render_texture(sprite.texture, (Vector2){ (transform.position.x + sprite.position.x) * unit_to_pixels, (transform.position.y + sprite.position.y) * unit_to_pixels }, scale * unit_to_pixels / sprite.texture->width, 1.0f, sprite.flip_x);
+        gr->render_texture(sprite.texture, (Vector2){ (transform.position.x + sprite.position.x) * unit_to_pixels, (transform.position.y + sprite.position.y) * unit_to_pixels }, scale * unit_to_pixels / sprite.texture->width, 1.0f, sprite.flip_x);
+    }
+}
+
+void System_Hazard::hash_entities() {
+    static_hash.clear();
+    moving.clear();
+
+    // Optional
+    Component_Array<Component_Mob_AI>* mob_ais = c->get_component_array<Component_Mob_AI>();
+
+    for (Entity h : entities) {
+        if (mob_ais->has(h)) {
+            moving.push_back(h);
+
+            continue;
+        }
+
+        const Component_Transform &hazard_transform = c->get_component<Component_Transform>(h);
+        const Component_Collision &hazard_collision = c->get_component<Component_Collision>(h);
+
+        static_hash.insert(h, Rectangle{ hazard_transform.position.x + hazard_collision.bounds.x, hazard_transform.position.y + hazard_collision.bounds.y, hazard_collision.bounds.width, hazard_collision.bounds.height });
+    }
+
+    hashed = true;
+}
+
+bool System_Hazard::overlaps(const Rectangle &rectangle) {
+    if (!hashed)
+        hash_entities();
+
+    static_hash.query(rectangle, hits);
+
+    if (!hits.empty())
+        return true;
+
+    for (Entity h : moving) {
+        const Component_Transform &hazard_transform = c->get_component<Component_Transform>(h);
+        const Component_Collision &hazard_collision = c->get_component<Component_Collision>(h);
+
+        // World space
+        Rectangle hazard_world_collision{ hazard_transform.position.x + hazard_collision.bounds.x, hazard_transform.position.y + hazard_collision.bounds.y, hazard_collision.bounds.width, hazard_collision.bounds.height };
+
+        if (check_collision(rectangle, hazard_world_collision))
+            return true;
     }
+
+    return false;
 }
 
 void System_Mob_AI::update(float dt) {
     // Get tile map system
-    std::shared_ptr<System_Tilemap> tilemap = c.system_manager.get_system<System_Tilemap>();
+    std::shared_ptr<System_Tilemap> tilemap = c->system_manager.get_system<System_Tilemap>();
 
     for (auto const &e : entities) {
-        auto &mob_ai = c.get_component<Component_Mob_AI>(e);
+        auto &mob_ai = c->get_component<Component_Mob_AI>(e);
 
-        auto &transform = c.get_component<Component_Transform>(e);
+        auto &transform = c->get_component<Component_Transform>(e);
 
         // Move
         transform.position.x += mob_ai.velocity_x * dt;
@@ -77,13 +127,9 @@ void System_Mob_AI::update(float dt) {
         Rectangle wall_sensor{ transform.position.x - 0.5f, transform.position.y - 0.6f, 1.0f, 0.5f };
         Rectangle floor_sensor{ transform.position.x - 0.5f, transform.position.y + 0.6f, 1.0f, 0.5f };
 
-        std::pair<Vector2, bool> wall_collision_data = tilemap->get_collision(wall_sensor, [](Tile_ID id) -> Collision_Type {
-            return (id == wall_mid || id == wall_top ? full : none);
-        });
+        std::pair<Vector2, bool> wall_collision_data = tilemap->get_collision(wall_sensor, wall_mask);
 
-        std::pair<Vector2, bool> floor_collision_data = tilemap->get_collision(floor_sensor, [](Tile_ID id) -> Collision_Type {
-            return (id == empty ? full : none);
-        });
+        std::pair<Vector2, bool> floor_collision_data = tilemap->get_collision(floor_sensor, floor_mask);
 
         float new_x = wall_collision_data.first.x + 0.5f;
 
@@ -98,24 +144,29 @@ void System_Mob_AI::update(float dt) {
             mob_ai.velocity_x *= -1.0f; // Rebound
 
         // Flip sprite if needed
-        auto &sprite = c.get_component<Component_Sprite>(e);
+        auto &sprite = c->get_component<Component_Sprite>(e);
 
         sprite.flip_x = mob_ai.velocity_x > 0.0f;
     }
 }
 
-void System_Agent::init() {
-    stand_textures.resize(agent_themes.size());
-    jump_textures.resize(agent_themes.size());
-    walk1_textures.resize(agent_themes.size());
-    walk2_textures.resize(agent_themes.size());
+void System_Agent::init(bool lazy_assets) {
+    std::vector<std::string> stand_names;
+    std::vector<std::string> jump_names;
+    std::vector<std::string> walk1_names;
+    std::vector<std::string> walk2_names;
 
     for (int i = 0; i < agent_themes.size(); i++) {
-        stand_textures[i].load("assets/kenney/Players/128x256/" + agent_themes[i] + "/alien" + agent_themes[i] + "_stand.png");
-        jump_textures[i].load("assets/kenney/Players/128x256/" + agent_themes[i] + "/alien" + agent_themes[i] + "_jump.png");
-        walk1_textures[i].load("assets/kenney/Players/128x256/" + agent_themes[i] + "/alien" + agent_themes[i] + "_walk1.png");
-        walk2_textures[i].load("assets/kenney/Players/128x256/" + agent_themes[i] + "/alien" + agent_themes[i] + "_walk2.png");
+        stand_names.push_back("assets/kenney/Players/128x256/" + agent_themes[i] + "/alien" + agent_themes[i] + "_stand.png");
+        jump_names.push_back("assets/kenney/Players/128x256/" + agent_themes[i] + "/alien" + agent_themes[i] + "_jump.png");
+        walk1_names.push_back("assets/kenney/Players/128x256/" + agent_themes[i] + "/alien" + agent_themes[i] + "_walk1.png");
+        walk2_names.push_back("assets/kenney/Players/128x256/" + agent_themes[i] + "/alien" + agent_themes[i] + "_walk2.png");
     }
+
+    stand_textures.init(stand_names, lazy_assets);
+    jump_textures.init(jump_names, lazy_assets);
+    walk1_textures.init(walk1_names, lazy_assets);
+    walk2_textures.init(walk2_names, lazy_assets);
 }
 
 std::pair<bool, bool> System_Agent::update(float dt, const std::shared_ptr<System_Hazard> &hazard, const std::shared_ptr<System_Goal> &goal, int action) {
@@ -130,20 +181,20 @@ std::pair<bool, bool> System_Agent::update(float dt, const std::shared_ptr<Syste
     const float air_control = 0.15f;
 
     // Get tile map system
-    std::shared_ptr<System_Tilemap> tilemap = c.system_manager.get_system<System_Tilemap>();
+    std::shared_ptr<System_Tilemap> tilemap = c->system_manager.get_system<System_Tilemap>();
 
     assert(entities.size() == 1); // Only one player
 
     for (auto const &e : entities) {
-        auto &agent = c.get_component<Component_Agent>(e);
+        auto &agent = c->get_component<Component_Agent>(e);
 
         // Set action
         agent.action = action;
 
-        auto &transform = c.get_component<Component_Transform>(e);
-        auto &dynamics = c.get_component<Component_Dynamics>(e);
+        auto &transform = c->get_component<Component_Transform>(e);
+        auto &dynamics = c->get_component<Component_Dynamics>(e);
 
-        const auto &collision = c.get_component<Component_Collision>(e);
+        const auto &collision = c->get_component<Component_Collision>(e);
 
         float movement_x = (agent.action == 6 || agent.action == 7 || agent.action == 8) - (agent.action == 0 || agent.action == 1 || agent.action == 2);
         bool jump = (agent.action == 2 || agent.action == 5 || agent.action == 8);
@@ -173,9 +224,7 @@ std::pair<bool, bool> System_Agent::update(float dt, const std::shared_ptr<Syste
         // World space collision
         Rectangle world_collision{ transform.position.x + collision.bounds.x, transform.position.y + collision.bounds.y, collision.bounds.width, collision.bounds.height };
 
-        std::pair<Vector2, bool> collision_data = tilemap->get_collision(world_collision, [](Tile_ID id) -> Collision_Type {
-            return (id == wall_mid || id == wall_top ? full : (id == crate ? down_only : none));
-        }, fallthrough, dynamics.velocity.y * dt);
+        std::pair<Vector2, bool> collision_data = tilemap->get_collision(world_collision, agent_mask, fallthrough, dynamics.velocity.y * dt);
 
         // If was moved up, on ground
         Vector2 delta_position{ collision_data.first.x - world_collision.x, collision_data.first.y - world_collision.y };
@@ -196,33 +245,19 @@ std::pair<bool, bool> System_Agent::update(float dt, const std::shared_ptr<Syste
         if (agent.on_ground)
             dynamics.velocity.y = 0.0f;
 
-        // Go through all hazards
-        for (auto const &h : hazard->get_entities()) {
-            auto const &hazard_transform = c.get_component<Component_Transform>(h);
-            auto const &hazard_collision = c.get_component<Component_Collision>(h);
-
-            // World space
-            Rectangle hazard_world_collision{ hazard_transform.position.x + hazard_collision.bounds.x, hazard_transform.position.y + hazard_collision.bounds.y, hazard_collision.bounds.width, hazard_collision.bounds.height };
-
-            if (check_collision(world_collision, hazard_world_collision)) {
-                alive = false;
-
-                break;
-            }
-        }
+        if (hazard->overlaps(world_collision))
+            alive = false;
 
         // Lava
-        std::pair<Vector2, bool> lava_collision = tilemap->get_collision(world_collision, [](Tile_ID id) -> Collision_Type {
-            return (id == lava_mid || id == lava_top ? full : none);
-        });
+        std::pair<Vector2, bool> lava_collision = tilemap->get_collision(world_collision, lava_mask);
 
         if (lava_collision.second)
             alive = false;
 
-        // Go through all goals
+        // Go through all goals (a level has a single coin, so not worth hashing)
         for (auto const &g : goal->get_entities()) {
-            auto const &goal_transform = c.get_component<Component_Transform>(g);
-            auto const &goal_collision = c.get_component<Component_Collision>(g);
+            auto const &goal_transform = c->get_component<Component_Transform>(g);
+            auto const &goal_collision = c->get_component<Component_Collision>(g);
 
             // World space
             Rectangle goal_world_collision{ goal_transform.position.x + goal_collision.bounds.x, goal_transform.position.y + goal_collision.bounds.y, goal_collision.bounds.width, goal_collision.bounds.height };
@@ -235,8 +270,8 @@ std::pair<bool, bool> System_Agent::update(float dt, const std::shared_ptr<Syste
         }
 
         // Camera follows the agent
-        gr.camera_position.x = transform.position.x * unit_to_pixels;
-        gr.camera_position.y = (transform.position.y - 0.5f) * unit_to_pixels;
+        gr->camera_position.x = transform.position.x * unit_to_pixels;
+        gr->camera_position.y = (transform.position.y - 0.5f) * unit_to_pixels;
 
         // Animation cycle
         agent.t += agent.rate * dt;
@@ -255,25 +290,25 @@ void System_Agent::render(int theme) {
     assert(entities.size() == 1); // Only one player
 
     for (auto const &e : entities) {
-        auto const &agent = c.get_component<Component_Agent>(e);
-        auto const &transform = c.get_component<Component_Transform>(e);
-        auto const &dynamics = c.get_component<Component_Dynamics>(e);
+        auto const &agent = c->get_component<Component_Agent>(e);
+        auto const &transform = c->get_component<Component_Transform>(e);
+        auto const &dynamics = c->get_component<Component_Dynamics>(e);
 
         // Select the correct texture
         Asset_Texture* texture;
 
         if (std::abs(dynamics.velocity.x) < 0.01f && agent.on_ground)
-            texture = &stand_textures[theme];
+            texture = &stand_textures.get(theme);
         else if (!agent.on_ground) 
-            texture = &jump_textures[theme];
+            texture = &jump_textures.get(theme);
         else if (agent.t > 0.5f)
-            texture = &walk2_textures[theme];
+            texture = &walk2_textures.get(theme);
         else
-            texture = &walk1_textures[theme];
+            texture = &walk1_textures.get(theme);
 
         Vector2 position{ transform.position.x - 0.5f, transform.position.y - 2.0f };
 
-        gr.render_texture(texture, (Vector2){ position.x * unit_to_pixels, position.y * unit_to_pixels }, unit_to_pixels / texture->width, 1.0f, !agent.face_forward);
+        gr->render_texture(texture, (Vector2){ position.x * unit_to_pixels, position.y * unit_to_pixels }, unit_to_pixels / texture->width, 1.0f, !agent.face_forward);
     }
 }
 
@@ -282,10 +317,7 @@ void System_Particles::init() {
 }
 
 void System_Particles::update(float dt) {
-    for (auto const &e : entities) {
-        auto const &transform = c.get_component<Component_Transform>(e);
-        auto &particles = c.get_component<Component_Particles>(e);
-
+    c->view<Component_Particles, Component_Transform>().each([&](Entity, Component_Particles &particles, const Component_Transform &transform) {
         int dead_index = -1;
     
         for (int i = 0; i < particles.particles.size(); i++) {
@@ -309,7 +341,7 @@ void System_Particles::update(float dt) {
             p.position.x = transform.position.x + particles.offset.x;
             p.position.y = transform.position.y + particles.offset.y;
         }
-    }
+    });
 }
 
 void System_Particles::render() {
@@ -317,7 +349,7 @@ void System_Particles::render() {
     const float base_scale = 0.45f;
 
     for (auto const &e : entities) {
-        auto const &particles = c.get_component<Component_Particles>(e);
+        auto const &particles = c->get_component<Component_Particles>(e);
 
         for (int i = 0; i < particles.particles.size(); i++) {
             const Particle &p = particles.particles[i];
@@ -331,7 +363,7 @@ void System_Particles::render() {
             float scale = base_scale * (0.4f * life_ratio + 0.6f);
             float offset_y = -life_ratio * 0.17f;
 
-            gr.render_texture(&particle_texture, (Vector2){ p.position.x * unit_to_pixels - 0.5f * particle_texture.width * scale, (p.position.y + offset_y) * unit_to_pixels - 0.5f * particle_texture.height * scale }, scale * unit_to_pixels / particle_texture.width, alpha);
+            gr->render_texture(&particle_texture, (Vector2){ p.position.x * unit_to_pixels - 0.5f * particle_texture.width * scale, (p.position.y + offset_y) * unit_to_pixels - 0.5f * particle_texture.height * scale }, scale * unit_to_pixels / particle_texture.width, alpha);
         }
     }
 }
@@ -2,6 +2,7 @@
 
 #include "common_components.h"
 #include "common_assets.h"
+#include "helpers.h"
 #include "ecs.h"
 
 #include <cmath>
@@ -28,6 +29,20 @@ public:
     void clear_render() {
         render_entities.clear();
     }
+
+    void save_state(State_Writer &writer) const override {
+        writer.write(render_entities, max_entities);
+    }
+
+    void load_state(State_Reader &reader) override {
+        reader.read(render_entities, max_entities);
+    }
+
+    void copy_state(const System &other) override {
+        const System_Sprite_Render &other_system = static_cast<const System_Sprite_Render&>(other);
+
+        render_entities = other_system.render_entities;
+    }
 };
 
 // --------------------- Mob AI --------------------
@@ -41,10 +56,36 @@ public:
 
 // Empty mostly, since just need it to collect hazards for agent system
 class System_Hazard : public System {
+private:
+    // Saws never move, so they are hashed once per level; the few mobs are checked directly
+    Spatial_Hash static_hash{ 1.0f };
+    std::vector<Entity> moving;
+    bool hashed = false;
+
+    std::vector<int> hits;
+
+    void hash_entities();
+
 public:
-    std::unordered_set<Entity> &get_entities() {
+    const Entity_List &get_entities() const {
         return entities;
     }
+
+    // After the hazards changed (new level or loaded state), rehashed on the next query
+    void invalidate() {
+        hashed = false;
+    }
+
+    // If any hazard overlaps the world space rectangle
+    bool overlaps(const Rectangle &rectangle);
+
+    void load_state(State_Reader &) override {
+        invalidate();
+    }
+
+    void copy_state(const System &) override {
+        invalidate();
+    }
 };
 
 // -------------------- Goals --------------------
@@ -52,7 +93,7 @@ public:
 // Empty mostly, since just need it to collect goals for agent system
 class System_Goal : public System {
 public:
-    std::unordered_set<Entity> &get_entities() {
+    const Entity_List &get_entities() const {
         return entities;
     }
 };
@@ -63,14 +104,14 @@ static const std::vector<std::string> agent_themes = { "Beige", "Blue", "Green",
 
 class System_Agent : public System {
 private:
-    // Agent textures
-    std::vector<Asset_Texture> stand_textures;
-    std::vector<Asset_Texture> jump_textures;
-    std::vector<Asset_Texture> walk1_textures;
-    std::vector<Asset_Texture> walk2_textures;
+    // Agent textures, by theme
+    Texture_Set stand_textures;
+    Texture_Set jump_textures;
+    Texture_Set walk1_textures;
+    Texture_Set walk2_textures;
 
 public:
-    void init(); // Needs to load sprites
+    void init(bool lazy_assets = false); // Needs to load sprites, lazy_assets defers loading them to the first use of their theme
 
     // Returns alive status (false if touched hazard), and whether touched a goal (coin)
     std::pair<bool, bool> update(float dt, const std::shared_ptr<System_Hazard> &hazard, const std::shared_ptr<System_Goal> &goal, int action);
@@ -1,13 +1,18 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <bitset>
-#include <queue>
+#include <tuple>
 #include <memory>
+#include <type_traits>
 #include <unordered_map>
-#include <unordered_set>
+#include <utility>
+#include <vector>
 #include <assert.h>
 
+#include "state.h"
+
 // ECS based on https://austinmorlan.com/posts/entity_component_system/
 
 // Handles and types
@@ -21,18 +26,142 @@ const int max_components = 16;
 // Bitset that tells us which components an entity has
 typedef std::bitset<max_components> Signature;
 
+// Compile-time list of types
+template<typename... Ts>
+struct Type_List {
+    static constexpr int size = sizeof...(Ts);
+
+    // Position of T in the list, -1 if not present
+    template<typename T>
+    static constexpr int index_of() {
+        constexpr bool matches[] = { false, std::is_same<T, Ts>::value... }; // Leading entry so that empty lists compile
+
+        for (int i = 1; i <= size; i++) {
+            if (matches[i])
+                return i - 1;
+        }
+
+        return -1;
+    }
+};
+
+// All component types of the game, defined in common_components.h as
+// struct Component_List : Type_List<Component_Transform, ...> {};
+// A component's type (signature bit) is its position in this list
+struct Component_List;
+
+// Component type of T. List is only a parameter so that the lookup waits until Component_List is complete
+template<typename T, typename List = Component_List>
+struct Component_Index {
+    static constexpr int value = List::template index_of<T>();
+
+    static_assert(value != -1, "Component is missing from Component_List");
+    static_assert(List::size <= max_components, "Component_List is longer than max_components");
+};
+
+// Dense list of entities with an index map, iterated contiguously in insertion order (erasing swaps in the last entity)
+class Entity_List {
+private:
+    std::vector<Entity> entities;
+    std::array<int, max_entities> entity_to_index; // -1 if not in the list
+
+public:
+    Entity_List() {
+        entities.reserve(max_entities);
+        entity_to_index.fill(-1);
+    }
+
+    bool contains(Entity e) const {
+        assert(e >= 0 && e < max_entities);
+
+        return entity_to_index[e] != -1;
+    }
+
+    void insert(Entity e) {
+        if (contains(e))
+            return;
+
+        entity_to_index[e] = entities.size();
+        entities.push_back(e);
+    }
+
+    void erase(Entity e) {
+        if (!contains(e))
+            return;
+
+        int index_removed = entity_to_index[e];
+
+        Entity e_last = entities.back();
+        entities[index_removed] = e_last;
+        entity_to_index[e_last] = index_removed;
+
+        entity_to_index[e] = -1;
+        entities.pop_back();
+    }
+
+    void clear() {
+        for (Entity e : entities)
+            entity_to_index[e] = -1;
+
+        entities.clear();
+    }
+
+    void save_state(State_Writer &writer) const {
+        writer.write(entities, max_entities);
+    }
+
+    void load_state(State_Reader &reader) {
+        clear();
+
+        reader.read(entities, max_entities);
+
+        for (size_t i = 0; i < entities.size(); i++) {
+            if (entities[i] < 0 || entities[i] >= max_entities) {
+                reader.fail();
+                entities.clear();
+
+                return;
+            }
+
+            entity_to_index[entities[i]] = i;
+        }
+    }
+
+    void copy_state(const Entity_List &other) {
+        clear();
+
+        entities = other.entities;
+
+        for (size_t i = 0; i < entities.size(); i++)
+            entity_to_index[entities[i]] = i;
+    }
+
+    size_t size() const {
+        return entities.size();
+    }
+
+    std::vector<Entity>::const_iterator begin() const {
+        return entities.begin();
+    }
+
+    std::vector<Entity>::const_iterator end() const {
+        return entities.end();
+    }
+};
+
 class Entity_Manager {
 private:
-    std::queue<Entity> available_entities;
-    std::unordered_set<Entity> entities_in_use;
+    // Free entities are handed out in order: never used ones first (from next_unused), then destroyed ones, oldest first
+    Entity next_unused = 0;
+    std::array<Entity, max_entities> destroyed_entities; // Ring buffer
+    int destroyed_front = 0;
+    int num_destroyed = 0;
 
-    std::array<Signature, max_entities> signatures;
+    Entity_List entities_in_use;
 
-    int num_living_entities = 0;
+    std::array<Signature, max_entities> signatures;
 
 public:
-    Entity_Manager();
-
     Entity create_entity();
 
     void destroy_entity(Entity e);
@@ -49,15 +178,19 @@ public:
         return signatures[e];
     }
 
-    bool in_use(Entity e) {
-        return entities_in_use.find(e) != entities_in_use.end();
+    bool in_use(Entity e) const {
+        return entities_in_use.contains(e);
     };
 
     int get_num_living_entities() const {
-        return num_living_entities;
+        return entities_in_use.size();
     }
 
     void clear_entities();
+
+    void save_state(State_Writer &writer) const;
+    void load_state(State_Reader &reader);
+    void copy_state(const Entity_Manager &other);
 };
 
 class Interface_Component_Array {
@@ -65,119 +198,196 @@ public:
     virtual ~Interface_Component_Array() = default;
     virtual void entity_destroyed(Entity e) = 0;
     virtual void clear_entities() = 0;
+    virtual void save_state(State_Writer &writer) const = 0;
+    virtual void load_state(State_Reader &reader) = 0;
+    virtual void copy_state(const Interface_Component_Array &other) = 0; // other holds the same component type
 };
 
 template<typename T>
 class Component_Array : public Interface_Component_Array {
-private:
-    std::array<T, max_entities> components;
+    // Components are data only (use Inline_Vector instead of std::vector), so they can be copied around freely
+    static_assert(std::is_trivially_copyable<T>::value, "Components must be trivially copyable");
 
-    std::unordered_map<Entity, int> entity_to_index;
-    std::unordered_map<int, Entity> index_to_entity;
+private:
+    // Sparse set, components are kept dense (in insertion order, apart from removals swapping in the last one).
+    // Everything grows with use, so that components few entities have don't take room for all of them in every instance
+    std::vector<T> components;
+    std::vector<Entity> index_to_entity;
 
-    int size = 0;
+    std::vector<int> entity_to_index; // -1 if the entity doesn't have the component, up to the highest entity that had it
 
 public:
+    bool has(Entity e) const {
+        assert(e >= 0 && e < max_entities);
+
+        return e < static_cast<int>(entity_to_index.size()) && entity_to_index[e] != -1;
+    }
+
     void insert(Entity e, T component) {
         // Make sure doesn't already exist
-        assert(entity_to_index.find(e) == entity_to_index.end());
+        assert(!has(e));
 
-        int new_index = size;
+        if (e >= static_cast<int>(entity_to_index.size()))
+            entity_to_index.resize(e + 1, -1);
 
-        entity_to_index[e] = new_index;
-        index_to_entity[new_index] = e;
-        components[new_index] = component;
-
-        size++;
+        entity_to_index[e] = components.size();
+        index_to_entity.push_back(e);
+        components.push_back(std::move(component));
     }
 
     void remove(Entity e) {
         // Make sure exists
-        assert(entity_to_index.find(e) != entity_to_index.end());
+        assert(has(e));
 
         // Maintain density
         int index_removed = entity_to_index[e];
-        int index_last = size - 1;
 
-        components[index_removed] = components[index_last];
+        components[index_removed] = std::move(components.back());
 
         // Update mappings
-        Entity e_last = index_to_entity[index_last];
+        Entity e_last = index_to_entity.back();
         entity_to_index[e_last] = index_removed;
         index_to_entity[index_removed] = e_last;
 
-        entity_to_index.erase(e);
-        index_to_entity.erase(index_last);
+        entity_to_index[e] = -1;
 
-        size--;
+        components.pop_back();
+        index_to_entity.pop_back();
     }
 
     T &get(Entity e) {
         // Make sure exists
-        assert(entity_to_index.find(e) != entity_to_index.end());
+        assert(has(e));
 
         return components[entity_to_index[e]];
     }
+
+    // nullptr if the entity doesn't have the component
+    T* try_get(Entity e) {
+        return has(e) ? &components[entity_to_index[e]] : nullptr;
+    }
+
+    // Dense access, index in [0, get_size())
+    int get_size() const {
+        return components.size();
+    }
+
+    Entity get_entity_at(int index) const {
+        return index_to_entity[index];
+    }
+
+    T &get_at(int index) {
+        return components[index];
+    }
     
     // Inherited
     void entity_destroyed(Entity e) override {
         // Remove if exists
-        if (entity_to_index.find(e) != entity_to_index.end())
+        if (has(e))
             remove(e);
     }
 
+    // Keeps the memory for the next episode
     void clear_entities() override {
-        entity_to_index.clear();
+        for (Entity e : index_to_entity)
+            entity_to_index[e] = -1;
+
+        components.clear();
         index_to_entity.clear();
+    }
 
-        size = 0;
+    void save_state(State_Writer &writer) const override {
+        writer.write(index_to_entity, max_entities);
+        writer.write(components, max_entities);
+    }
+
+    void load_state(State_Reader &reader) override {
+        clear_entities();
+
+        reader.read(index_to_entity, max_entities);
+        reader.read(components, max_entities);
+
+        if (components.size() != index_to_entity.size())
+            reader.fail();
+
+        for (Entity e : index_to_entity) {
+            if (e < 0 || e >= max_entities)
+                reader.fail();
+        }
+
+        if (reader.failed()) {
+            components.clear();
+            index_to_entity.clear();
+
+            return;
+        }
+
+        for (size_t i = 0; i < index_to_entity.size(); i++) {
+            Entity e = index_to_entity[i];
+
+            if (e >= static_cast<int>(entity_to_index.size()))
+                entity_to_index.resize(e + 1, -1);
+
+            entity_to_index[e] = i;
+        }
+    }
+
+    void copy_state(const Interface_Component_Array &other) override {
+        const Component_Array<T> &other_array = static_cast<const Component_Array<T>&>(other);
+
+        clear_entities();
+
+        // Only the dense part, assigning keeps the memory
+        components = other_array.components;
+        index_to_entity = other_array.index_to_entity;
+
+        if (entity_to_index.size() < other_array.entity_to_index.size())
+            entity_to_index.resize(other_array.entity_to_index.size(), -1);
+
+        for (size_t i = 0; i < index_to_entity.size(); i++)
+            entity_to_index[index_to_entity[i]] = i;
     }
 };
 
 class Component_Manager {
 private:
-    std::unordered_map<size_t, Component_Type> component_types;
-    std::unordered_map<size_t, std::shared_ptr<Interface_Component_Array>> component_arrays;
-
-    Component_Type next_component_type = 0;
+    // Indexed by component type, nullptr if not registered
+    std::array<std::unique_ptr<Interface_Component_Array>, max_components> component_arrays;
 
+public:
     template<typename T>
-    std::shared_ptr<Component_Array<T>> get_component_array() {
-        size_t id = typeid(T).hash_code();
+    Component_Array<T>* get_component_array() {
+        Component_Type type = Component_Index<T>::value;
 
         // Make sure component is registered
-        assert(component_types.find(id) != component_types.end());
+        assert(component_arrays[type] != nullptr);
 
-        return std::static_pointer_cast<Component_Array<T>>(component_arrays[id]);
+        return static_cast<Component_Array<T>*>(component_arrays[type].get());
     }
 
-public:
     template<typename T>
     void register_component() {
-        size_t id = typeid(T).hash_code();
+        Component_Type type = Component_Index<T>::value;
 
         // Make sure not already registered
-        assert(component_types.find(id) == component_types.end());
+        assert(component_arrays[type] == nullptr);
 
-        component_types[id] = next_component_type;
-        component_arrays[id] = std::make_shared<Component_Array<T>>();
-
-        next_component_type++;
+        component_arrays[type].reset(new Component_Array<T>());
     }
 
     template<typename T>
     Component_Type get_component_type() {
-        size_t id = typeid(T).hash_code();
+        Component_Type type = Component_Index<T>::value;
 
         // Make sure exists
-        assert(component_types.find(id) != component_types.end());
+        assert(component_arrays[type] != nullptr);
 
-        return component_types[id];
+        return type;
     }
 
     template<typename T>
     void add_component(Entity e, T component) {
-        get_component_array<T>()->insert(e, component);
+        get_component_array<T>()->insert(e, std::move(component));
     }
 
     template<typename T>
@@ -192,26 +402,91 @@ public:
 
     void entity_destroyed(Entity e) {
         // Notify all
-        for (auto const &pair : component_arrays) {
-            auto const &component = pair.second;
-
-            component->entity_destroyed(e);
+        for (auto const &component : component_arrays) {
+            if (component != nullptr)
+                component->entity_destroyed(e);
         }
     }
 
     void clear_entities() {
         // Notify all
-        for (auto const &pair : component_arrays) {
-            auto const &component = pair.second;
+        for (auto const &component : component_arrays) {
+            if (component != nullptr)
+                component->clear_entities();
+        }
+    }
 
-            component->clear_entities();
+    void save_state(State_Writer &writer) const {
+        for (auto const &component : component_arrays) {
+            if (component != nullptr)
+                component->save_state(writer);
+        }
+    }
+
+    void load_state(State_Reader &reader) {
+        for (auto const &component : component_arrays) {
+            if (component != nullptr)
+                component->load_state(reader);
+        }
+    }
+
+    // other must have the same components registered
+    void copy_state(const Component_Manager &other) {
+        for (int i = 0; i < max_components; i++) {
+            if (component_arrays[i] != nullptr)
+                component_arrays[i]->copy_state(*other.component_arrays[i]);
+        }
+    }
+};
+
+// Query over all entities that have every component in T, Ts...
+// Walks the dense array of the first component, so list the rarest component first
+template<typename T, typename... Ts>
+class View {
+private:
+    Component_Array<T>* first;
+    std::tuple<Component_Array<Ts>*...> rest;
+
+    bool has_rest(Entity e) const {
+        static_cast<void>(e); // Unused for a view of a single component
+
+        bool has[] = { true, std::get<Component_Array<Ts>*>(rest)->has(e)... };
+
+        for (bool h : has) {
+            if (!h)
+                return false;
+        }
+
+        return true;
+    }
+
+public:
+    View(Component_Array<T>* first, Component_Array<Ts>*... rest)
+    : first(first), rest(rest...)
+    {}
+
+    // Calls f(Entity, T&, Ts&...) per matching entity. Components must not be added or removed during iteration
+    template<typename F>
+    void each(F f) {
+        for (int i = 0; i < first->get_size(); i++) {
+            Entity e = first->get_entity_at(i);
+
+            if (has_rest(e))
+                f(e, first->get_at(i), std::get<Component_Array<Ts>*>(rest)->get(e)...);
         }
     }
 };
 
 class System {
 public:
-    std::unordered_set<Entity> entities;
+    Entity_List entities;
+
+    virtual ~System() = default;
+
+    // State of systems that keep more than their entities, see state.h
+    virtual void save_state(State_Writer &) const {}
+    virtual void load_state(State_Reader &) {}
+    virtual void copy_state(const System &) {} // Given the same system of another instance
 };
 
 class System_Manager {
@@ -258,6 +533,10 @@ public:
     void clear_entities();
 
     void entity_signature_changed(Entity e, Signature s);
+
+    void save_state(State_Writer &writer) const;
+    void load_state(State_Reader &reader);
+    void copy_state(const System_Manager &other);
 };
 
 class Coordinator {
@@ -273,6 +552,11 @@ public:
     void destroy_entity(Entity e);
     void clear_entities();
 
+    // All entities and components, and the systems' state
+    void save_state(State_Writer &writer) const;
+    void load_state(State_Reader &reader);
+    void copy_state(const Coordinator &other); // From another instance of the same game, without going through a buffer
+
     template<typename T>
     void register_component() {
         component_manager.register_component<T>();
@@ -280,7 +564,7 @@ public:
 
     template<typename T>
     void add_component(Entity e, T component) {
-        component_manager.add_component<T>(e, component);
+        component_manager.add_component<T>(e, std::move(component));
 
         auto s = entity_manager.get_signature(e);
         s.set(component_manager.get_component_type<T>(), true);
@@ -310,6 +594,17 @@ public:
         return component_manager.get_component_type<T>();
     }
 
+    // For looking up optional components, resolve once outside of loops
+    template<typename T>
+    Component_Array<T>* get_component_array() {
+        return component_manager.get_component_array<T>();
+    }
+
+    template<typename T, typename... Ts>
+    View<T, Ts...> view() {
+        return View<T, Ts...>(component_manager.get_component_array<T>(), component_manager.get_component_array<Ts>()...);
+    }
+
     template<typename T>
     std::shared_ptr<T> register_system() {
         return system_manager.register_system<T>();
@@ -321,4 +616,4 @@ public:
     }
 };
 
-extern Coordinator c;
+extern thread_local Coordinator* c; // Coordinator of the environment bound to the calling thread
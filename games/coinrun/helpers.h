@@ -4,6 +4,7 @@
 #include <string>
 #include <algorithm>
 #include <cstdint>
+#include <vector>
 
 const float unit_to_pixels = 16.0f;
 const float pixels_to_unit = 1.0f / unit_to_pixels;
@@ -27,3 +28,45 @@ bool check_collision(const Rectangle &r1, const Rectangle &r2);
 Rectangle get_collision_overlap(const Rectangle &r1, const Rectangle &r2);
 
 std::string to_lower(std::string s);
+
+// Uniform grid of rectangles with the cells hashed into buckets, for finding the rectangles overlapping another without testing all of them.
+// Cleared and filled again whenever the rectangles move
+class Spatial_Hash {
+private:
+    struct Entry {
+        int item;
+        int next; // In the same bucket, -1 for none
+    };
+
+    float cell_size;
+
+    std::vector<int> buckets; // First entry, -1 for none
+    std::vector<Entry> entries;
+
+    std::vector<int> ids;
+    std::vector<Rectangle> rectangles;
+    std::vector<bool> removed;
+
+    std::vector<int> items_by_id; // Item of each id, -1 for none
+
+    std::vector<int> candidates; // Items in the cells of a query
+
+    int get_bucket(int cell_x, int cell_y) const {
+        return ((static_cast<uint32_t>(cell_x) * 73856093u) ^ (static_cast<uint32_t>(cell_y) * 19349663u)) & (buckets.size() - 1);
+    }
+
+    int get_cell(float position) const {
+        return static_cast<int>(std::floor(position / cell_size));
+    }
+
+public:
+    // Cells are best about the size of the rectangles, num_buckets must be a power of 2
+    Spatial_Hash(float cell_size = 1.0f, int num_buckets = 256);
+
+    void clear();
+    void insert(int id, const Rectangle &rectangle); // Ids are small non-negative numbers (like entities), each inserted once
+    void remove(int id); // Not found by later queries
+
+    // Ids of the rectangles overlapping rectangle (as in check_collision), in the order they were inserted
+    void query(const Rectangle &rectangle, std::vector<int> &result);
+};
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+// Environment state is saved as raw copies of plain data (the ECS, system and context members), so saving and loading are mostly memcpys.
+// Pointers (textures) are saved as is, which ties a state to the environment instance that saved it
+
+// Whether values of T can be saved and loaded by copying their bytes (std::pair has a non-trivial assignment, but is still fine)
+template<typename T>
+struct Is_Raw_State {
+    static constexpr bool value = std::is_trivially_copy_constructible<T>::value && std::is_trivially_destructible<T>::value;
+};
+
+// Writes state to a buffer. Without a buffer it only measures, counting variable length data at its maximum length,
+// which gives a size any state of the instance fits in
+class State_Writer {
+private:
+    uint8_t* buffer;
+    size_t capacity;
+    size_t size = 0;
+    bool overflow = false;
+
+    void write_bytes(const void* bytes, size_t num_bytes) {
+        if (buffer != nullptr) {
+            if (size + num_bytes > capacity) {
+                overflow = true;
+
+                return;
+            }
+
+            memcpy(buffer + size, bytes, num_bytes);
+        }
+
+        size += num_bytes;
+    }
+
+public:
+    // Measuring writer
+    State_Writer()
+    : buffer(nullptr), capacity(0)
+    {}
+
+    State_Writer(uint8_t* buffer, size_t capacity)
+    : buffer(buffer), capacity(capacity)
+    {}
+
+    template<typename T>
+    void write(const T &value) {
+        static_assert(Is_Raw_State<T>::value, "State must be plain data");
+
+        write_bytes(&value, sizeof(T));
+    }
+
+    // Count followed by the values, at most max_count of them
+    template<typename T>
+    void write_array(const T* values, int count, int max_count) {
+        static_assert(Is_Raw_State<T>::value, "State must be plain data");
+
+        write(count);
+
+        if (buffer == nullptr)
+            size += max_count * sizeof(T);
+        else
+            write_bytes(values, count * sizeof(T));
+    }
+
+    template<typename T>
+    void write(const std::vector<T> &values, int max_count) {
+        write_array(values.data(), values.size(), max_count);
+    }
+
+    template<typename T>
+    void write(const std::vector<T> &values) {
+        write(values, values.size());
+    }
+
+    size_t get_size() const {
+        return size;
+    }
+
+    bool failed() const {
+        return overflow;
+    }
+};
+
+// Reads state written by State_Writer, in the same order
+class State_Reader {
+private:
+    const uint8_t* buffer;
+    size_t size;
+    size_t position = 0;
+    bool error = false;
+
+    void read_bytes(void* bytes, size_t num_bytes) {
+        if (error || position + num_bytes > size) {
+            error = true;
+
+            return;
+        }
+
+        memcpy(bytes, buffer + position, num_bytes);
+
+        position += num_bytes;
+    }
+
+public:
+    State_Reader(const uint8_t* buffer, size_t size)
+    : buffer(buffer), size(size)
+    {}
+
+    template<typename T>
+    void read(T &value) {
+        static_assert(Is_Raw_State<T>::value, "State must be plain data");
+
+        read_bytes(&value, sizeof(T));
+    }
+
+    // Returns the number of values read, at most max_count
+    template<typename T>
+    int read_array(T* values, int max_count) {
+        static_assert(Is_Raw_State<T>::value, "State must be plain data");
+
+        int count = 0;
+
+        read(count);
+
+        if (count < 0 || count > max_count) {
+            error = true;
+
+            return 0;
+        }
+
+        read_bytes(values, count * sizeof(T));
+
+        return error ? 0 : count;
+    }
+
+    template<typename T>
+    void read(std::vector<T> &values, int max_count) {
+        int count = 0;
+
+        read(count);
+
+        if (count < 0 || count > max_count) {
+            error = true;
+
+            return;
+        }
+
+        values.resize(count);
+
+        read_bytes(values.data(), count * sizeof(T));
+    }
+
+    // Fixed length vectors, the length must match
+    template<typename T>
+    void read(std::vector<T> &values) {
+        int count = 0;
+
+        read(count);
+
+        if (count != static_cast<int>(values.size())) {
+            error = true;
+
+            return;
+        }
+
+        read_bytes(values.data(), count * sizeof(T));
+    }
+
+    // For invalid values found by the caller
+    void fail() {
+        error = true;
+    }
+
+    bool failed() const {
+        return error;
+    }
+};
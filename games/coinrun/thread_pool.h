@@ -0,0 +1,93 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for running loops in parallel. Each worker starts with an even share of the loop,
+// and workers that run out steal from the others, so that uneven work (e.g. long and short episodes) keeps all cores busy
+class Thread_Pool {
+private:
+    // Loop indices still to be done by a worker. The owner takes from the front, thieves take from the back
+    struct Work_Queue {
+        std::mutex mutex;
+        int begin = 0;
+        int end = 0;
+    };
+
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<Work_Queue>> queues; // One per worker, index 0 is the thread calling parallel_for
+
+    std::mutex loop_mutex; // Only one loop at a time
+
+    std::mutex mutex;
+    std::condition_variable start_condition;
+    std::condition_variable done_condition;
+
+    const std::function<void(int)>* job = nullptr;
+    int generation = 0; // Incremented to start a loop
+    int num_busy = 0; // Threads still working on the current loop
+    bool stopping = false;
+
+    bool pinned;
+
+    bool pop(int worker_index, int &index);
+    void work(int worker_index);
+    void run(int worker_index);
+
+public:
+    // num_threads includes the calling thread, <= 0 for one per core. Pinning places the worker threads on separate cores (Linux only)
+    Thread_Pool(int num_threads = 1, bool pin_threads = false);
+    ~Thread_Pool();
+
+    int get_num_threads() const {
+        return queues.size();
+    }
+
+    // Whether the pool was made with these constructor arguments
+    bool matches(int num_threads, bool pin_threads) const;
+
+    // Call f(i) for all i in [0, n) across the threads, returns once all calls are done
+    void parallel_for(int n, const std::function<void(int)> &f);
+};
+
+// Single thread running jobs in the background, in the order they were started. For stepping while the caller does other work,
+// without starting a thread per step
+class Background_Worker {
+public:
+    class Job {
+        friend class Background_Worker;
+
+    private:
+        bool done = true;
+
+    public:
+        virtual ~Job() = default;
+
+        virtual void run() = 0;
+    };
+
+private:
+    std::thread thread;
+
+    std::mutex mutex;
+    std::condition_variable start_condition;
+    std::condition_variable done_condition;
+
+    std::vector<Job*> queue; // Started jobs from next_job on, reused once empty
+    size_t next_job = 0;
+    bool stopping = false;
+
+    void run();
+
+public:
+    Background_Worker();
+    ~Background_Worker();
+
+    // The job belongs to the worker until waited for
+    void start(Job* job);
+    void wait(Job* job);
+};
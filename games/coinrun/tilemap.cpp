@@ -1,39 +1,42 @@
 #include "tilemap.h"
 
-void System_Tilemap::init() {
+void System_Tilemap::init(bool lazy_assets) {
     id_to_textures.resize(num_ids);
 
     // Load textures
-    id_to_textures[wall_top].resize(wall_themes.size());
-    id_to_textures[wall_mid].resize(wall_themes.size());
+    std::vector<std::string> wall_top_names;
+    std::vector<std::string> wall_mid_names;
 
     for (int i = 0; i < wall_themes.size(); i++) {
-        id_to_textures[wall_top][i].load("assets/kenney/Ground/" + wall_themes[i] + "/" + to_lower(wall_themes[i]) + "Mid.png");
-        id_to_textures[wall_mid][i].load("assets/kenney/Ground/" + wall_themes[i] + "/" + to_lower(wall_themes[i]) + "Center.png");
+        wall_top_names.push_back("assets/kenney/Ground/" + wall_themes[i] + "/" + to_lower(wall_themes[i]) + "Mid.png");
+        wall_mid_names.push_back("assets/kenney/Ground/" + wall_themes[i] + "/" + to_lower(wall_themes[i]) + "Center.png");
     }
 
-    id_to_textures[lava_top].resize(1);
-    id_to_textures[lava_top][0].load("assets/kenney/Tiles/lavaTop_low.png");
+    // Only the walls are themed
+    id_to_textures[wall_top].init(wall_top_names, lazy_assets);
+    id_to_textures[wall_mid].init(wall_mid_names, lazy_assets);
 
-    id_to_textures[lava_mid].resize(1);
-    id_to_textures[lava_mid][0].load("assets/kenney/Tiles/lava.png");
+    id_to_textures[lava_top].init({ "assets/kenney/Tiles/lavaTop_low.png" }, false);
+    id_to_textures[lava_mid].init({ "assets/kenney/Tiles/lava.png" }, false);
 
-    id_to_textures[crate].resize(crate_types.size());
+    std::vector<std::string> crate_names;
 
     for (int i = 0; i < crate_types.size(); i++)
-        id_to_textures[crate][i].load("assets/kenney/Tiles/" + crate_types[i] + ".png");
+        crate_names.push_back("assets/kenney/Tiles/" + crate_types[i] + ".png");
+
+    id_to_textures[crate].init(crate_names, false);
 
     // Preload enemies
     for (int i = 0; i < walking_enemies.size(); i++) {
-        manager_texture.get("assets/kenney/Enemies/" + walking_enemies[i] + ".png");
-        manager_texture.get("assets/kenney/Enemies/" + walking_enemies[i] + "_move.png");
+        manager_texture->get("assets/kenney/Enemies/" + walking_enemies[i] + ".png");
+        manager_texture->get("assets/kenney/Enemies/" + walking_enemies[i] + "_move.png");
     }
 
-    manager_texture.get("assets/kenney/Enemies/sawHalf.png");
-    manager_texture.get("assets/kenney/Enemies/sawHalf_move.png");
+    manager_texture->get("assets/kenney/Enemies/sawHalf.png");
+    manager_texture->get("assets/kenney/Enemies/sawHalf_move.png");
 
     // Pre-load coin
-    manager_texture.get("assets/kenney/Items/coinGold.png");
+    manager_texture->get("assets/kenney/Items/coinGold.png");
 }
 
 // Tile manipulation
@@ -50,27 +53,27 @@ void System_Tilemap::set_area_with_top(int x, int y, int width, int height, Tile
 
 // Spawning helpers
 void System_Tilemap::spawn_enemy_saw(int x, int y) {
-    Entity e = c.create_entity();
+    Entity e = c->create_entity();
 
     Vector2 pos = { static_cast<float>(x) + 0.5f, static_cast<float>(map_height - 1 - y) + 0.5f };
 
     Component_Animation animation;
     animation.frames.resize(2);
-    animation.frames[0] = &manager_texture.get("assets/kenney/Enemies/sawHalf.png");
-    animation.frames[1] = &manager_texture.get("assets/kenney/Enemies/sawHalf_move.png");
+    animation.frames[0] = &manager_texture->get("assets/kenney/Enemies/sawHalf.png");
+    animation.frames[1] = &manager_texture->get("assets/kenney/Enemies/sawHalf_move.png");
     animation.rate = 1.0f; // Every frame
 
-    c.add_component(e, Component_Transform{ .position{ pos } });
-    c.add_component(e, Component_Sprite{ .position{ -0.5f, -0.5f }, .z = 1.0f });
-    c.add_component(e, Component_Hazard{});
-    c.add_component(e, Component_Collision{ .bounds{ -0.5f, -0.5f, 1.0f, 1.0f }});
-    c.add_component(e, animation);
+    c->add_component(e, Component_Transform{ .position{ pos } });
+    c->add_component(e, Component_Sprite{ .position{ -0.5f, -0.5f }, .z = 1.0f });
+    c->add_component(e, Component_Hazard{});
+    c->add_component(e, Component_Collision{ .bounds{ -0.5f, -0.5f, 1.0f, 1.0f }});
+    c->add_component(e, animation);
 }
 
 void System_Tilemap::spawn_enemy_mob(int x, int y, std::mt19937 &rng) {
     std::uniform_real_distribution<float> dist01(0.0f, 1.0f);
 
-    Entity e = c.create_entity();
+    Entity e = c->create_entity();
 
     Vector2 pos = { static_cast<float>(x) + 0.5f, static_cast<float>(map_height - 1 - y) + 0.5f };
 
@@ -80,21 +83,23 @@ void System_Tilemap::spawn_enemy_mob(int x, int y, std::mt19937 &rng) {
 
     Component_Animation animation;
     animation.frames.resize(2);
-    animation.frames[0] = &manager_texture.get("assets/kenney/Enemies/" + walking_enemies[enemy_index] + ".png");
-    animation.frames[1] = &manager_texture.get("assets/kenney/Enemies/" + walking_enemies[enemy_index] + "_move.png");
+    animation.frames[0] = &manager_texture->get("assets/kenney/Enemies/" + walking_enemies[enemy_index] + ".png");
+    animation.frames[1] = &manager_texture->get("assets/kenney/Enemies/" + walking_enemies[enemy_index] + "_move.png");
     animation.rate = 0.2f;
 
-    c.add_component(e, Component_Transform{ .position{ pos } });
-    c.add_component(e, Component_Sprite{ .position{ -0.5f, -0.5f }, .z = 1.0f });
-    c.add_component(e, Component_Hazard{});
-    c.add_component(e, Component_Collision{ .bounds{ -0.5f, -0.48f, 1.0f, 0.98f }});
-    c.add_component(e, Component_Mob_AI{ .velocity_x = 0.15f * ((dist01(rng) < 0.5f) * 2.0f - 1.0f) });
-    c.add_component(e, Component_Particles{ .particles = std::vector<Particle>(10), .offset{ 0.0f, 0.34f } });
-    c.add_component(e, animation);
+    c->add_component(e, Component_Transform{ .position{ pos } });
+    c->add_component(e, Component_Sprite{ .position{ -0.5f, -0.5f }, .z = 1.0f });
+    c->add_component(e, Component_Hazard{});
+    c->add_component(e, Component_Collision{ .bounds{ -0.5f, -0.48f, 1.0f, 0.98f }});
+    c->add_component(e, Component_Mob_AI{ .velocity_x = 0.15f * ((dist01(rng) < 0.5f) * 2.0f - 1.0f) });
+    c->add_component(e, Component_Particles{ .particles = Inline_Vector<Particle, max_particles>(10), .offset{ 0.0f, 0.34f } });
+    c->add_component(e, animation);
 }
 
 // Main map generation
 void System_Tilemap::regenerate(std::mt19937 &rng, const Config &cfg) {
+    layer.invalidate();
+
     const int main_width = 64;
     const int main_height = 64;
     const float max_jump = 1.5f;
@@ -277,23 +282,47 @@ void System_Tilemap::regenerate(std::mt19937 &rng, const Config &cfg) {
     }
 
     // Spawn the coin
-    Entity coin = c.create_entity();
+    Entity coin = c->create_entity();
 
     Vector2 pos = { static_cast<float>(curr_x) + 0.5f, static_cast<float>(map_height - 1 - curr_y) + 0.5f };
 
-    c.add_component(coin, Component_Transform{ .position{ pos } });
-    c.add_component(coin, Component_Sprite{ .position{ -0.5f, -0.5f }, .z = 1.0f, .texture = &manager_texture.get("assets/kenney/Items/coinGold.png") });
-    c.add_component(coin, Component_Goal{});
-    c.add_component(coin, Component_Collision{ .bounds{ -0.5f, -0.5f, 1.0f, 1.0f }});
+    c->add_component(coin, Component_Transform{ .position{ pos } });
+    c->add_component(coin, Component_Sprite{ .position{ -0.5f, -0.5f }, .z = 1.0f, .texture = &manager_texture->get("assets/kenney/Items/coinGold.png") });
+    c->add_component(coin, Component_Goal{});
+    c->add_component(coin, Component_Collision{ .bounds{ -0.5f, -0.5f, 1.0f, 1.0f }});
 
     set_area_with_top(curr_x, 0, 1, curr_y, wall_mid, wall_top);
 
     set_area(curr_x + 1, 0, main_width - curr_x, main_height, wall_mid);
 }
 
+Asset_Texture* System_Tilemap::get_tile_texture(int x, int y, int theme) {
+    Tile_ID id = get(x, map_height - 1 - y);
+
+    if (id == wall_mid || id == wall_top)
+        return &id_to_textures[id].get(theme);
+    else if (id == lava_mid || id == lava_top)
+        return &id_to_textures[id].get(0);
+    else if (id == crate)
+        return &id_to_textures[id].get(crate_type_indices[map_height - 1 - y + x * map_height]);
+
+    return nullptr; // Empty
+}
+
 void System_Tilemap::render(int theme) {
-    Rectangle camera_aabb{ (gr.camera_position.x - gr.camera_size.x * 0.5f / gr.camera_scale) * pixels_to_unit, (gr.camera_position.y - gr.camera_size.y * 0.5f / gr.camera_scale) * pixels_to_unit,
-        gr.camera_size.x * pixels_to_unit / gr.camera_scale, gr.camera_size.y * pixels_to_unit / gr.camera_scale };
+    if (gr->rendering_obs) {
+        if (theme != layer_theme) {
+            layer.invalidate();
+            layer_theme = theme;
+        }
+
+        layer.render(map_width, map_height, [&](int x, int y) { return get_tile_texture(x, y, theme); });
+
+        return;
+    }
+
+    Rectangle camera_aabb{ (gr->camera_position.x - gr->camera_size.x * 0.5f / gr->camera_scale) * pixels_to_unit, (gr->camera_position.y - gr->camera_size.y * 0.5f / gr->camera_scale) * pixels_to_unit,
+        gr->camera_size.x * pixels_to_unit / gr->camera_scale, gr->camera_size.y * pixels_to_unit / gr->camera_scale };
 
     int lower_x = std::floor(camera_aabb.x);
     int lower_y = std::floor(camera_aabb.y);
@@ -302,25 +331,16 @@ void System_Tilemap::render(int theme) {
     
     for (int y = lower_y; y <= upper_y; y++)
         for (int x = lower_x; x <= upper_x; x++) {
-            Tile_ID id = get(x, map_height - 1 - y);
+            Asset_Texture* tex = get_tile_texture(x, y, theme);
 
-            if (id == 0) // Empty
+            if (tex == nullptr)
                 continue;
 
-            Asset_Texture* tex;
-
-            if (id == wall_mid || id == wall_top)
-                tex = &id_to_textures[id][theme];
-            else if (id == lava_mid || id == lava_top)
-                tex = &id_to_textures[id][0];
-            else if (id == crate)
-                tex = &id_to_textures[id][crate_type_indices[map_height - 1 - y + x * map_height]];
-
-            gr.render_texture(tex, (Vector2){ x * unit_to_pixels, y * unit_to_pixels }, unit_to_pixels / tex->width);
+            gr->render_texture(tex, (Vector2){ x * unit_to_pixels, y * unit_to_pixels }, unit_to_pixels / tex->width);
         }
 }
 
-std::pair<Vector2, bool> System_Tilemap::get_collision(Rectangle rectangle, const std::function<Collision_Type(Tile_ID)> &collision_id_func, bool fallthrough, float step_y) {
+std::pair<Vector2, bool> System_Tilemap::get_collision(Rectangle rectangle, const Collision_Mask &collision_mask, bool fallthrough, float step_y) {
     bool collided = false;
 
     int lower_x = std::floor(rectangle.x);
@@ -338,7 +358,7 @@ std::pair<Vector2, bool> System_Tilemap::get_collision(Rectangle rectangle, cons
         for (int x = lower_x; x <= upper_x; x++) {
             Tile_ID id = get(x, map_height - 1 - y);
 
-            Collision_Type type = collision_id_func(id);
+            Collision_Type type = collision_mask[id];
 
             if (type != none) {
                 tile.x = x;
@@ -371,7 +391,7 @@ std::pair<Vector2, bool> System_Tilemap::get_collision(Rectangle rectangle, cons
         for (int x = lower_x; x <= upper_x; x++) {
             Tile_ID id = get(x, map_height - 1 - y);
 
-            Collision_Type type = collision_id_func(id);
+            Collision_Type type = collision_mask[id];
 
             if (type != none) {
                 tile.x = x;
@@ -394,3 +414,57 @@ std::pair<Vector2, bool> System_Tilemap::get_collision(Rectangle rectangle, cons
 
     return std::make_pair(Vector2{ rectangle.x, rectangle.y }, collided);
 }
+
+void System_Tilemap::save_state(State_Writer &writer) const {
+    writer.write(map_width);
+    writer.write(map_height);
+    writer.write(tile_ids);
+    writer.write(crate_type_indices);
+}
+
+void System_Tilemap::load_state(State_Reader &reader) {
+    int loaded_width = -1, loaded_height = -1;
+
+    reader.read(loaded_width);
+    reader.read(loaded_height);
+
+    // Map size is fixed per instance
+    if (loaded_width != map_width || loaded_height != map_height) {
+        reader.fail();
+
+        return;
+    }
+
+    loaded_tile_ids.resize(tile_ids.size());
+    loaded_crate_type_indices.resize(crate_type_indices.size());
+
+    reader.read(loaded_tile_ids);
+    reader.read(loaded_crate_type_indices);
+
+    if (reader.failed())
+        return;
+
+    set_tiles(loaded_tile_ids, loaded_crate_type_indices);
+}
+
+void System_Tilemap::copy_state(const System &other) {
+    const System_Tilemap &other_tilemap = static_cast<const System_Tilemap&>(other);
+
+    // Map size is fixed per instance, cenv_clone checks that it matches
+    assert(other_tilemap.map_width == map_width && other_tilemap.map_height == map_height);
+
+    set_tiles(other_tilemap.tile_ids, other_tilemap.crate_type_indices);
+}
+
+void System_Tilemap::set_tiles(const std::vector<Tile_ID> &ids, const std::vector<int> &crate_indices) {
+    for (int i = 0; i < static_cast<int>(tile_ids.size()); i++) {
+        if (ids[i] != tile_ids[i] || crate_indices[i] != crate_type_indices[i]) {
+            int x = i / map_height;
+            int y = i % map_height;
+
+            crate_type_indices[i] = crate_indices[i];
+
+            set(x, y, ids[i]);
+        }
+    }
+}
@@ -4,11 +4,13 @@
 #include "common_assets.h"
 #include "helpers.h"
 #include "ecs.h"
+#include "tile_layer.h"
 
 #include <cmath>
 #include <algorithm>
 #include <random>
-#include <functional>
+#include <array>
+#include <initializer_list>
 
 enum Tile_ID {
     empty = 0,
@@ -26,6 +28,21 @@ enum Collision_Type {
     down_only
 };
 
+// Collision type by tile id, see System_Tilemap::get_collision
+typedef std::array<Collision_Type, num_ids> Collision_Mask;
+
+// Mask with the given types, none for the other ids
+inline Collision_Mask make_collision_mask(std::initializer_list<std::pair<Tile_ID, Collision_Type>> types) {
+    Collision_Mask mask;
+
+    mask.fill(none);
+
+    for (auto const &type : types)
+        mask[type.first] = type.second;
+
+    return mask;
+}
+
 static const std::vector<std::string> wall_themes = { "Dirt", "Grass", "Planet", "Sand", "Snow", "Stone" };
 static const std::vector<std::string> walking_enemies = { "slimeBlock", "slimePurple", "slimeBlue", "slimeGreen", "mouse", "snail", "ladybug", "wormGreen", "wormPink" };
 static const std::vector<std::string> crate_types = { "boxCrate", "boxCrate_double", "boxCrate_single", "boxCrate_warning" };
@@ -48,17 +65,27 @@ public:
 private:
     int map_width, map_height;
 
-    std::vector<std::vector<Asset_Texture>> id_to_textures;
+    std::vector<Texture_Set> id_to_textures;
+
+    Tile_Layer layer; // Baked map for observations
+    int layer_theme = -1; // Theme the layer was baked with
 
     std::vector<Tile_ID> tile_ids;
     std::vector<int> crate_type_indices;
 
+    // Loaded tiles, compared against the current ones to only re-bake what changed
+    std::vector<Tile_ID> loaded_tile_ids;
+    std::vector<int> loaded_crate_type_indices;
+
+    // Set all tiles, only re-baking the ones that changed
+    void set_tiles(const std::vector<Tile_ID> &ids, const std::vector<int> &crate_indices);
+
     void spawn_enemy_saw(int x, int y);
     void spawn_enemy_mob(int x, int y, std::mt19937 &rng);
 
 public:
-    // Initialize the tilemap
-    void init();
+    // Initialize the tilemap, lazy_assets defers loading the wall themes to their first use
+    void init(bool lazy_assets = false);
 
     // Generate a new random map
     void regenerate(std::mt19937 &rng, const Config &cfg);
@@ -69,6 +96,8 @@ public:
             return;
 
         tile_ids[y + x * map_height] = id;
+
+        layer.invalidate(x, map_height - 1 - y);
     }
 
     // Top left corner x y, size, id to fill
@@ -83,10 +112,13 @@ public:
         return tile_ids[y + x * map_height];
     }
 
+    // Texture of the tile at render coordinates (y flipped), nullptr if empty
+    Asset_Texture* get_tile_texture(int x, int y, int theme);
+
     void render(int theme);
 
     // General collision detection, returns new rectangle position and a collision flag
-    std::pair<Vector2, bool> get_collision(Rectangle rectangle, const std::function<Collision_Type(Tile_ID)> &collision_id_func, bool fallthrough = false, float step_y = 0.0f);
+    std::pair<Vector2, bool> get_collision(Rectangle rectangle, const Collision_Mask &collision_mask, bool fallthrough = false, float step_y = 0.0f);
 
     int get_width() const {
         return map_width;
@@ -95,4 +127,8 @@ public:
     int get_height() const {
         return map_height;
     }
+
+    void save_state(State_Writer &writer) const override;
+    void load_state(State_Reader &reader) override;
+    void copy_state(const System &other) override;
 };
@@ -0,0 +1,104 @@
+#include "asset_pack.h"
+
+#include <sys/stat.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MAPPED_ASSET_PACK
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+bool get_asset_source_info(const std::string &name, int64_t &size, int64_t &mtime) {
+    struct stat file_stat;
+
+    if (stat(name.c_str(), &file_stat) != 0)
+        return false;
+
+    size = file_stat.st_size;
+    mtime = file_stat.st_mtime;
+
+    return true;
+}
+
+#ifdef MAPPED_ASSET_PACK
+std::shared_ptr<Asset_Pack> Asset_Pack::open(const std::string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+
+    if (fd < 0)
+        return nullptr;
+
+    struct stat file_stat;
+
+    void* file = MAP_FAILED;
+
+    if (fstat(fd, &file_stat) == 0 && file_stat.st_size >= static_cast<off_t>(sizeof(Asset_Pack_Header)))
+        file = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+    close(fd);
+
+    if (file == MAP_FAILED)
+        return nullptr;
+
+    std::shared_ptr<Asset_Pack> pack = std::make_shared<Asset_Pack>();
+
+    pack->mapping = file;
+    pack->mapping_size = file_stat.st_size;
+
+    const uint8_t* data = static_cast<const uint8_t*>(file);
+    const Asset_Pack_Header* header = reinterpret_cast<const Asset_Pack_Header*>(data);
+
+    if (header->magic != asset_pack_magic || header->version != asset_pack_version ||
+        sizeof(Asset_Pack_Header) + static_cast<uint64_t>(header->num_entries) * sizeof(Asset_Pack_Entry) > pack->mapping_size)
+        return nullptr;
+
+    const Asset_Pack_Entry* entries = reinterpret_cast<const Asset_Pack_Entry*>(header + 1);
+
+    for (uint32_t i = 0; i < header->num_entries; i++) {
+        const Asset_Pack_Entry &entry = entries[i];
+
+        // Everything has to be within the file, it could be truncated
+        uint64_t pixels_size = static_cast<uint64_t>(entry.width) * entry.height * sizeof(uint32_t);
+
+        if (entry.width <= 0 || entry.height <= 0 || entry.name_offset + entry.name_size > pack->mapping_size ||
+            entry.pixels_offset % asset_pack_alignment != 0 || entry.pixels_offset + pixels_size > pack->mapping_size)
+            return nullptr;
+
+        pack->entries[std::string(reinterpret_cast<const char*>(data + entry.name_offset), entry.name_size)] = &entry;
+    }
+
+    return pack;
+}
+
+Asset_Pack::~Asset_Pack() {
+    if (mapping != nullptr)
+        munmap(mapping, mapping_size);
+}
+#else
+std::shared_ptr<Asset_Pack> Asset_Pack::open(const std::string &path) {
+    return nullptr;
+}
+
+Asset_Pack::~Asset_Pack() {
+}
+#endif
+
+const uint32_t* Asset_Pack::find(const std::string &name, int &width, int &height) const {
+    auto it = entries.find(name);
+
+    if (it == entries.end())
+        return nullptr;
+
+    const Asset_Pack_Entry &entry = *it->second;
+
+    // Packs can be used without the PNGs, but if they are there they must not have changed
+    int64_t source_size, source_mtime;
+
+    if (get_asset_source_info(name, source_size, source_mtime) && (source_size != entry.source_size || source_mtime != entry.source_mtime))
+        return nullptr;
+
+    width = entry.width;
+    height = entry.height;
+
+    return reinterpret_cast<const uint32_t*>(static_cast<const uint8_t*>(mapping) + entry.pixels_offset);
+}
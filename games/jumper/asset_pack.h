@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+// Pre-decoded textures of the assets directory in a single file (made by tools/asset_pack), mapped instead of decoding the PNGs.
+// Layout: Asset_Pack_Header, the entries, their names, then the pixels of each entry (RGBA32, aligned to asset_pack_alignment)
+const uint32_t asset_pack_magic = 0x4B503250; // "P2PK"
+const uint32_t asset_pack_version = 1;
+const uint64_t asset_pack_alignment = 64;
+
+struct Asset_Pack_Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_entries;
+    uint32_t reserved;
+};
+
+struct Asset_Pack_Entry {
+    uint64_t name_offset; // From the start of the file
+    uint32_t name_size;
+    int32_t width;
+    int32_t height;
+    uint32_t reserved;
+    uint64_t pixels_offset;
+
+    // Of the PNG when it was packed, files changed since are decoded instead
+    int64_t source_size;
+    int64_t source_mtime;
+};
+
+class Asset_Pack {
+private:
+    void* mapping = nullptr;
+    size_t mapping_size = 0;
+
+    std::unordered_map<std::string, const Asset_Pack_Entry*> entries;
+
+public:
+    // nullptr if there is no (valid) pack at the path
+    static std::shared_ptr<Asset_Pack> open(const std::string &path);
+
+    // Packed pixels of the file, nullptr if it isn't in the pack or changed since
+    const uint32_t* find(const std::string &name, int &width, int &height) const;
+
+    ~Asset_Pack();
+};
+
+// Size and modification time of a file as recorded in the pack, false if it doesn't exist
+bool get_asset_source_info(const std::string &name, int64_t &size, int64_t &mtime);
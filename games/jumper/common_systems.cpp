@@ -4,18 +4,15 @@
 
 #include "helpers.h"
 
-void System_Sprite_Render::update(float dt) {
-    if (render_entities.size() != entities.size())
-        render_entities.resize(entities.size());
-
-    int index = 0;
+// Walls
+static const Collision_Mask wall_mask = make_collision_mask({ { wall_top, full }, { wall_mid, full } });
 
-    for (auto const &e : entities) {
-        auto &sprite = c.get_component<Component_Sprite>(e);
+void System_Sprite_Render::update(float dt) {
+    render_entities.clear();
 
-        render_entities[index] = std::make_pair(sprite.z, e);
-        index++;
-    }
+    c->view<Component_Sprite>().each([&](Entity e, Component_Sprite &sprite) {
+        render_entities.push_back(std::make_pair(sprite.z, e));
+    });
     
     // Sort sprites
     std::sort(render_entities.begin(), render_entities.end(), [](const std::pair<float, Entity> &left, const std::pair<float, Entity> &right) {
@@ -28,8 +25,8 @@ void System_Sprite_Render::render(Sprite_Render_Mode mode) {
     for (size_t i = 0; i < render_entities.size(); i++) {
         Entity e = render_entities[i].second;
 
-        auto const &sprite = c.get_component<Component_Sprite>(e);
-        auto const &transform = c.get_component<Component_Transform>(e);
+        auto const &sprite = c->get_component<Component_Sprite>(e);
+        auto const &transform = c->get_component<Component_Transform>(e);
 
         if (sprite.texture == nullptr)
             continue;
@@ -43,7 +40,7 @@ void System_Sprite_Render::render(Sprite_Render_Mode mode) {
         float scale = transform.scale * sprite.scale;
 
         // If visible
-        gr.render_texture(sprite.texture, (Vector2){ (transform.position.x + sprite.position.x) * unit_to_pixels, (transform.position.y + sprite.position.y) * unit_to_pixels }, scale * unit_to_pixels / sprite.texture->width, 1.0f, sprite.flip_x);
+        gr->render_texture(sprite.texture, (Vector2){ (transform.position.x + sprite.position.x) * unit_to_pixels, (transform.position.y + sprite.position.y) * unit_to_pixels }, scale * unit_to_pixels / sprite.texture->width, 1.0f, sprite.flip_x);
     }
 }
 
@@ -67,20 +64,20 @@ std::pair<bool, bool> System_Agent::update(float dt, const std::shared_ptr<Syste
     const float jump_cooldown = 3.0f;
 
     // Get tile map system
-    std::shared_ptr<System_Tilemap> tilemap = c.system_manager.get_system<System_Tilemap>();
+    std::shared_ptr<System_Tilemap> tilemap = c->system_manager.get_system<System_Tilemap>();
 
     assert(entities.size() == 1); // Only one player
 
     for (auto const &e : entities) {
-        auto &agent = c.get_component<Component_Agent>(e);
+        auto &agent = c->get_component<Component_Agent>(e);
 
         // Set action
         agent.action = action;
 
-        auto &transform = c.get_component<Component_Transform>(e);
-        auto &dynamics = c.get_component<Component_Dynamics>(e);
+        auto &transform = c->get_component<Component_Transform>(e);
+        auto &dynamics = c->get_component<Component_Dynamics>(e);
 
-        const auto &collision = c.get_component<Component_Collision>(e);
+        const auto &collision = c->get_component<Component_Collision>(e);
 
         float movement_x = (agent.action == 6 || agent.action == 7 || agent.action == 8) - (agent.action == 0 || agent.action == 1 || agent.action == 2);
         bool jump = (agent.action == 2 || agent.action == 5 || agent.action == 8);
@@ -119,9 +116,7 @@ std::pair<bool, bool> System_Agent::update(float dt, const std::shared_ptr<Syste
         // World space collision
         Rectangle world_collision{ transform.position.x + collision.bounds.x, transform.position.y + collision.bounds.y, collision.bounds.width, collision.bounds.height };
 
-        std::pair<Vector2, bool> collision_data = tilemap->get_collision(world_collision, [](Tile_ID id) -> Collision_Type {
-            return (id == wall_mid || id == wall_top ? full : none);
-        });
+        std::pair<Vector2, bool> collision_data = tilemap->get_collision(world_collision, wall_mask);
 
         // If was moved up, on ground
         Vector2 delta_position{ collision_data.first.x - world_collision.x, collision_data.first.y - world_collision.y };
@@ -148,8 +143,8 @@ std::pair<bool, bool> System_Agent::update(float dt, const std::shared_ptr<Syste
 
         // Go through all hazards
         for (auto const &h : hazard->get_entities()) {
-            auto const &hazard_transform = c.get_component<Component_Transform>(h);
-            auto const &hazard_collision = c.get_component<Component_Collision>(h);
+            auto const &hazard_transform = c->get_component<Component_Transform>(h);
+            auto const &hazard_collision = c->get_component<Component_Collision>(h);
 
             // World space
             Rectangle hazard_world_collision{ hazard_transform.position.x + hazard_collision.bounds.x, hazard_transform.position.y + hazard_collision.bounds.y, hazard_collision.bounds.width, hazard_collision.bounds.height };
@@ -163,8 +158,8 @@ std::pair<bool, bool> System_Agent::update(float dt, const std::shared_ptr<Syste
 
         // Go through all goals
         for (auto const &g : goal->get_entities()) {
-            auto const &goal_transform = c.get_component<Component_Transform>(g);
-            auto const &goal_collision = c.get_component<Component_Collision>(g);
+            auto const &goal_transform = c->get_component<Component_Transform>(g);
+            auto const &goal_collision = c->get_component<Component_Collision>(g);
 
             // World space
             Rectangle goal_world_collision{ goal_transform.position.x + goal_collision.bounds.x, goal_transform.position.y + goal_collision.bounds.y, goal_collision.bounds.width, goal_collision.bounds.height };
@@ -177,8 +172,8 @@ std::pair<bool, bool> System_Agent::update(float dt, const std::shared_ptr<Syste
         }
 
         // Camera follows the agent
-        gr.camera_position.x = transform.position.x * unit_to_pixels;
-        gr.camera_position.y = (transform.position.y - 0.5f) * unit_to_pixels;
+        gr->camera_position.x = transform.position.x * unit_to_pixels;
+        gr->camera_position.y = (transform.position.y - 0.5f) * unit_to_pixels;
 
         // Animation cycle
         agent.t += agent.rate * dt;
@@ -193,7 +188,7 @@ std::pair<bool, bool> System_Agent::update(float dt, const std::shared_ptr<Syste
         info.to_goal = Vector2{ tilemap->getInfo().goal_pos.x - transform.position.x, tilemap->getInfo().goal_pos.y - transform.position.y };
 
         // Enable particles on jump
-        auto &particles = c.get_component<Component_Particles>(e);
+        auto &particles = c->get_component<Component_Particles>(e);
 
         particles.enabled = !agent.on_ground || abs(dynamics.velocity.x) > 0.01f;
     }
@@ -205,9 +200,9 @@ void System_Agent::render() {
     assert(entities.size() == 1); // Only one player
 
     for (auto const &e : entities) {
-        auto const &agent = c.get_component<Component_Agent>(e);
-        auto const &transform = c.get_component<Component_Transform>(e);
-        auto const &dynamics = c.get_component<Component_Dynamics>(e);
+        auto const &agent = c->get_component<Component_Agent>(e);
+        auto const &transform = c->get_component<Component_Transform>(e);
+        auto const &dynamics = c->get_component<Component_Dynamics>(e);
 
         // Select the correct texture
         Asset_Texture* texture;
@@ -239,7 +234,7 @@ void System_Agent::render() {
 
         Vector2 position{ transform.position.x - 0.25f, transform.position.y - 1.0f };
 
-        gr.render_texture(texture, (Vector2){ (position.x + agent_offset.x) * unit_to_pixels, (position.y + agent_offset.y) * unit_to_pixels }, unit_to_pixels / texture->width * agent_scale, 1.0f, !agent.face_forward);
+        gr->render_texture(texture, (Vector2){ (position.x + agent_offset.x) * unit_to_pixels, (position.y + agent_offset.y) * unit_to_pixels }, unit_to_pixels / texture->width * agent_scale, 1.0f, !agent.face_forward);
     }
 }
 
@@ -248,10 +243,7 @@ void System_Particles::init() {
 }
 
 void System_Particles::update(float dt) {
-    for (auto const &e : entities) {
-        auto const &transform = c.get_component<Component_Transform>(e);
-        auto &particles = c.get_component<Component_Particles>(e);
-
+    c->view<Component_Particles, Component_Transform>().each([&](Entity, Component_Particles &particles, const Component_Transform &transform) {
         int dead_index = -1;
     
         for (int i = 0; i < particles.particles.size(); i++) {
@@ -275,7 +267,7 @@ void System_Particles::update(float dt) {
             p.position.x = transform.position.x + particles.offset.x;
             p.position.y = transform.position.y + particles.offset.y;
         }
-    }
+    });
 }
 
 void System_Particles::render() {
@@ -283,7 +275,7 @@ void System_Particles::render() {
     const float base_scale = 0.45f;
 
     for (auto const &e : entities) {
-        auto const &particles = c.get_component<Component_Particles>(e);
+        auto const &particles = c->get_component<Component_Particles>(e);
 
         for (int i = 0; i < particles.particles.size(); i++) {
             const Particle &p = particles.particles[i];
@@ -297,7 +289,7 @@ void System_Particles::render() {
             float scale = base_scale * (0.4f * life_ratio + 0.6f);
             float offset_y = -life_ratio * 0.17f;
 
-            gr.render_texture(&particle_texture, (Vector2){ p.position.x * unit_to_pixels - 0.5f * particle_texture.width * scale, (p.position.y + offset_y) * unit_to_pixels - 0.5f * particle_texture.height * scale }, scale * unit_to_pixels / particle_texture.width, alpha);
+            gr->render_texture(&particle_texture, (Vector2){ p.position.x * unit_to_pixels - 0.5f * particle_texture.width * scale, (p.position.y + offset_y) * unit_to_pixels - 0.5f * particle_texture.height * scale }, scale * unit_to_pixels / particle_texture.width, alpha);
         }
     }
 }
@@ -28,6 +28,20 @@ public:
     void clear_render() {
         render_entities.clear();
     }
+
+    void save_state(State_Writer &writer) const override {
+        writer.write(render_entities, max_entities);
+    }
+
+    void load_state(State_Reader &reader) override {
+        reader.read(render_entities, max_entities);
+    }
+
+    void copy_state(const System &other) override {
+        const System_Sprite_Render &other_system = static_cast<const System_Sprite_Render&>(other);
+
+        render_entities = other_system.render_entities;
+    }
 };
 
 // -------------------- Hazards --------------------
@@ -35,7 +49,7 @@ public:
 // Empty mostly, since just need it to collect hazards for agent system
 class System_Hazard : public System {
 public:
-    std::unordered_set<Entity> &get_entities() {
+    const Entity_List &get_entities() const {
         return entities;
     }
 };
@@ -45,7 +59,7 @@ public:
 // Empty mostly, since just need it to collect goals for agent system
 class System_Goal : public System {
 public:
-    std::unordered_set<Entity> &get_entities() {
+    const Entity_List &get_entities() const {
         return entities;
     }
 };
@@ -77,6 +91,20 @@ public:
     const Agent_Info &getInfo() const {
         return info;
     }
+
+    void save_state(State_Writer &writer) const override {
+        writer.write(info);
+    }
+
+    void load_state(State_Reader &reader) override {
+        reader.read(info);
+    }
+
+    void copy_state(const System &other) override {
+        const System_Agent &other_system = static_cast<const System_Agent&>(other);
+
+        info = other_system.info;
+    }
 };
 
 // ------------------- Particles ------------------
@@ -1,18 +1,630 @@
 #include "common_assets.h"
 
-void Asset_Texture::load(const std::string &name) {
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <numeric>
+#include <unordered_map>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define SHARED_MEMORY_TEXTURES
+#include <cerrno>
+#include <ctime>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Texture ids by file name, shared by all instances
+std::mutex texture_ids_mutex;
+std::unordered_map<std::string, int> texture_ids;
+std::vector<std::string> texture_names;
+
+int get_texture_id(const std::string &name) {
+    std::lock_guard<std::mutex> lock(texture_ids_mutex);
+
+    auto it = texture_ids.find(name);
+
+    if (it != texture_ids.end())
+        return it->second;
+
+    int id = texture_names.size();
+
+    texture_ids[name] = id;
+    texture_names.push_back(name);
+
+    return id;
+}
+
+std::string get_texture_name(int id) {
+    std::lock_guard<std::mutex> lock(texture_ids_mutex);
+
+    return texture_names[id];
+}
+
+#ifdef SHARED_MEMORY_TEXTURES
+// Start of a shared memory segment, followed by the pixels
+struct Shared_Texture_Header {
+    uint32_t magic;
+    std::atomic<uint32_t> ready; // Set by the process that made the segment once the pixels are in
+    std::atomic<uint32_t> users; // Processes with the segment mapped, the last one to unmap it removes it. Once 0 it stays 0
+    std::atomic<int32_t> creator_pid; // Of the process that made the segment, 0 until it is written
+    int32_t width;
+    int32_t height;
+    int32_t num_regions; // Of the files in an atlas, stored after the pixels. 0 for a single file
+};
+
+const uint32_t shared_texture_magic = 0x50473256; // Change when the layout or pixel format changes
+
+// Seconds after which a segment that still isn't ready counts as abandoned, even if a process with the creator's pid runs (pids get reused)
+const time_t shared_texture_write_timeout = 60;
+
+// Segment name for a file (num_regions 0) or an atlas of the files in order, changes with any of the files
+std::string get_shared_memory_key(const std::vector<std::string> &names, int num_regions) {
+    // FNV-1a, stable across processes
+    uint64_t hash = 14695981039346656037ULL;
+
+    auto add = [&](const void* data, size_t size) {
+        for (size_t i = 0; i < size; i++)
+            hash = (hash ^ static_cast<const uint8_t*>(data)[i]) * 1099511628211ULL;
+    };
+
+    for (const std::string &name : names) {
+        struct stat file_stat;
+
+        if (stat(name.c_str(), &file_stat) != 0)
+            return "";
+
+        add(name.data(), name.size() + 1); // With the terminator, so that names don't run into each other
+        add(&file_stat.st_size, sizeof(file_stat.st_size));
+        add(&file_stat.st_mtime, sizeof(file_stat.st_mtime));
+    }
+
+    add(&num_regions, sizeof(num_regions));
+    add(&shared_texture_magic, sizeof(shared_texture_magic));
+
+    char key[32];
+
+    snprintf(key, sizeof(key), "/procgen2_%016llx", static_cast<unsigned long long>(hash));
+
+    return key;
+}
+
+// Remove the segment named key, unless another process already replaced it with a new one
+void unlink_shared(const std::string &key, uint64_t inode) {
+    int fd = shm_open(key.c_str(), O_RDONLY, 0);
+
+    if (fd < 0)
+        return;
+
+    struct stat segment_stat;
+
+    bool same = fstat(fd, &segment_stat) == 0 && static_cast<uint64_t>(segment_stat.st_ino) == inode;
+
+    close(fd);
+
+    if (same)
+        shm_unlink(key.c_str());
+}
+
+// Whether a segment that isn't ready never will be, as the process making it died (or is taking far too long)
+bool is_abandoned(const Shared_Texture_Header* header, const struct stat &segment_stat) {
+    // Writing the pixels updates the modification time
+    if (time(nullptr) - segment_stat.st_mtime > shared_texture_write_timeout)
+        return true;
+
+    pid_t creator_pid = header->creator_pid.load(std::memory_order_relaxed);
+
+    return creator_pid != 0 && kill(creator_pid, 0) != 0 && errno == ESRCH;
+}
+
+bool Texture_Data::attach_shared(const std::string &key, int num_regions) {
+    // Writable for the user count
+    int fd = shm_open(key.c_str(), O_RDWR, 0);
+
+    if (fd < 0)
+        return false;
+
+    struct stat segment_stat;
+
+    void* segment = MAP_FAILED;
+
+    if (fstat(fd, &segment_stat) == 0 && segment_stat.st_size >= static_cast<off_t>(sizeof(Shared_Texture_Header)))
+        segment = mmap(nullptr, segment_stat.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    close(fd);
+
+    if (segment == MAP_FAILED)
+        return false;
+
+    Shared_Texture_Header* header = static_cast<Shared_Texture_Header*>(segment);
+
+    // Still being written, decode privately instead of waiting. If its process died while writing, remove it so that this process makes it anew
+    if (header->ready.load(std::memory_order_acquire) != 1) {
+        if (is_abandoned(header, segment_stat))
+            unlink_shared(key, segment_stat.st_ino);
+
+        munmap(segment, segment_stat.st_size);
+
+        return false;
+    }
+
+    if (header->magic != shared_texture_magic || header->num_regions != num_regions ||
+        static_cast<size_t>(segment_stat.st_size) != sizeof(Shared_Texture_Header) + static_cast<size_t>(header->width) * header->height * sizeof(uint32_t) + num_regions * sizeof(SDL_Rect)) {
+        munmap(segment, segment_stat.st_size);
+
+        return false;
+    }
+
+    // Join the users, unless the last one is already removing the segment
+    uint32_t users = header->users.load(std::memory_order_relaxed);
+
+    do {
+        if (users == 0) {
+            munmap(segment, segment_stat.st_size);
+
+            return false;
+        }
+    } while (!header->users.compare_exchange_weak(users, users + 1, std::memory_order_acq_rel));
+
+    mapping = segment;
+    mapping_size = segment_stat.st_size;
+    mapping_key = key;
+    mapping_inode = segment_stat.st_ino;
+
+    width = header->width;
+    height = header->height;
+    pixels = reinterpret_cast<const uint32_t*>(header + 1);
+
+    const SDL_Rect* segment_regions = reinterpret_cast<const SDL_Rect*>(pixels + static_cast<size_t>(width) * height);
+
+    regions.assign(segment_regions, segment_regions + num_regions);
+
+    return true;
+}
+
+uint32_t* Texture_Data::create_shared(const std::string &key, int width, int height, const std::vector<SDL_Rect> &regions) {
+    // Exclusive, so that only one process writes it
+    int fd = shm_open(key.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+
+    if (fd < 0)
+        return nullptr;
+
+    size_t num_pixels = static_cast<size_t>(width) * height;
+    size_t size = sizeof(Shared_Texture_Header) + num_pixels * sizeof(uint32_t) + regions.size() * sizeof(SDL_Rect);
+
+    struct stat segment_stat;
+
+    void* segment = MAP_FAILED;
+
+    if (ftruncate(fd, size) == 0 && fstat(fd, &segment_stat) == 0)
+        segment = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    close(fd);
+
+    if (segment == MAP_FAILED) {
+        shm_unlink(key.c_str());
+
+        return nullptr;
+    }
+
+    Shared_Texture_Header* header = new (segment) Shared_Texture_Header;
+
+    header->creator_pid.store(getpid(), std::memory_order_relaxed);
+    header->magic = shared_texture_magic;
+    header->width = width;
+    header->height = height;
+    header->num_regions = regions.size();
+
+    uint32_t* segment_pixels = reinterpret_cast<uint32_t*>(header + 1);
+
+    if (!regions.empty())
+        memcpy(segment_pixels + num_pixels, regions.data(), regions.size() * sizeof(SDL_Rect));
+
+    mapping = segment;
+    mapping_size = size;
+    mapping_key = key;
+    mapping_inode = segment_stat.st_ino;
+
+    this->width = width;
+    this->height = height;
+    pixels = segment_pixels;
+
+    return segment_pixels;
+}
+
+void Texture_Data::finish_shared() {
+    Shared_Texture_Header* header = static_cast<Shared_Texture_Header*>(mapping);
+
+    header->users.store(1, std::memory_order_relaxed);
+    header->ready.store(1, std::memory_order_release);
+}
+#else
+std::string get_shared_memory_key(const std::vector<std::string> &names, int num_regions) {
+    return "";
+}
+
+bool Texture_Data::attach_shared(const std::string &key, int num_regions) {
+    return false;
+}
+
+uint32_t* Texture_Data::create_shared(const std::string &key, int width, int height, const std::vector<SDL_Rect> &regions) {
+    return nullptr;
+}
+
+void Texture_Data::finish_shared() {}
+#endif
+
+void Texture_Data::load(const std::string &name, const std::shared_ptr<const Asset_Pack> &pack, bool shared_memory) {
+    if (pack != nullptr) {
+        pixels = pack->find(name, width, height);
+
+        if (pixels != nullptr) {
+            this->pack = pack;
+
+            return;
+        }
+    }
+
+    std::string key = shared_memory ? get_shared_memory_key({ name }, 0) : "";
+
+    if (!key.empty() && attach_shared(key, 0))
+        return;
+
     SDL_Surface* surface = IMG_Load(name.c_str());
 
     if (surface == nullptr)
         throw std::runtime_error("Could not load surface \"" + name + "\"!");
 
-    width = surface->w;
-    height = surface->h;
+    SDL_Surface* converted = SDL_ConvertSurface(surface, SDL_PIXELFORMAT_RGBA32);
+
+    SDL_DestroySurface(surface);
+
+    if (converted == nullptr)
+        throw std::runtime_error("Could not convert surface \"" + name + "\"!");
+
+    uint32_t* loaded_pixels = key.empty() ? nullptr : create_shared(key, converted->w, converted->h, {});
+
+    if (loaded_pixels == nullptr) {
+        width = converted->w;
+        height = converted->h;
+
+        owned_pixels.resize(width * height);
+
+        loaded_pixels = owned_pixels.data();
+        pixels = loaded_pixels;
+    }
+
+    for (int y = 0; y < height; y++)
+        memcpy(&loaded_pixels[y * width], static_cast<uint8_t*>(converted->pixels) + y * converted->pitch, width * 4);
+
+    if (mapping != nullptr)
+        finish_shared();
+
+    SDL_DestroySurface(converted);
+}
+
+void Texture_Data::load_atlas(const std::vector<std::string> &names, const std::shared_ptr<const Asset_Pack> &pack, bool shared_memory) {
+    std::string key = shared_memory ? get_shared_memory_key(names, names.size()) : "";
+
+    if (!key.empty() && attach_shared(key, names.size()))
+        return;
+
+    // Only needed until copied into the atlas, so kept out of shared memory
+    std::vector<std::unique_ptr<Texture_Data>> textures(names.size());
+
+    for (size_t i = 0; i < names.size(); i++) {
+        textures[i] = std::make_unique<Texture_Data>();
+        textures[i]->load(names[i], pack, false);
+    }
+
+    // Shelves of textures, tallest first, in a roughly square atlas
+    std::vector<int> order(names.size());
+
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return textures[a]->height > textures[b]->height; });
+
+    int64_t area = 0;
+    int max_width = 0;
+
+    for (size_t i = 0; i < textures.size(); i++) {
+        area += static_cast<int64_t>(textures[i]->width + 2) * (textures[i]->height + 2);
+        max_width = std::max(max_width, textures[i]->width + 2);
+    }
+
+    width = std::max(max_width, static_cast<int>(std::ceil(std::sqrt(static_cast<double>(area)))));
+
+    regions.resize(names.size());
+
+    int x = 0;
+    int y = 0;
+    int shelf_height = 0;
+
+    for (int i : order) {
+        int cell_width = textures[i]->width + 2;
+        int cell_height = textures[i]->height + 2;
+
+        if (x + cell_width > width) {
+            x = 0;
+            y += shelf_height;
+            shelf_height = 0;
+        }
+
+        regions[i] = SDL_Rect{ x + 1, y + 1, textures[i]->width, textures[i]->height };
+
+        x += cell_width;
+        shelf_height = std::max(shelf_height, cell_height);
+    }
+
+    height = y + shelf_height;
+
+    // Segments start out zeroed, like the private pixels
+    uint32_t* atlas_pixels = key.empty() ? nullptr : create_shared(key, width, height, regions);
 
-    window_texture = SDL_CreateTextureFromSurface(gr.window_renderer, surface);
-    obs_texture = SDL_CreateTextureFromSurface(gr.obs_renderer, surface);
+    if (atlas_pixels == nullptr) {
+        owned_pixels.assign(static_cast<size_t>(width) * height, 0);
+
+        atlas_pixels = owned_pixels.data();
+        pixels = atlas_pixels;
+    }
+
+    for (size_t i = 0; i < textures.size(); i++) {
+        const Texture_Data &texture = *textures[i];
+        const SDL_Rect &region = regions[i];
+
+        // Including the border, which repeats the edge texels
+        for (int py = -1; py <= region.h; py++) {
+            const uint32_t* src_row = &texture.pixels[std::min(region.h - 1, std::max(0, py)) * texture.width];
+            uint32_t* dst_row = &atlas_pixels[region.x + (region.y + py) * width];
+
+            memcpy(dst_row, src_row, region.w * sizeof(uint32_t));
+
+            dst_row[-1] = src_row[0];
+            dst_row[region.w] = src_row[region.w - 1];
+        }
+    }
+
+    if (mapping != nullptr)
+        finish_shared();
+}
+
+uint32_t* Texture_Data::create(int width, int height) {
+    this->width = width;
+    this->height = height;
+
+    owned_pixels.assign(width * height, 0);
+    pixels = owned_pixels.data();
+
+    clear_mips();
+
+    return owned_pixels.data();
+}
+
+void Texture_Data::clear_mips() {
+    std::lock_guard<std::mutex> lock(mips_mutex);
+
+    mips.clear();
+}
+
+const std::vector<uint32_t> &Texture_Data::get_mip(const SDL_Rect &region, int mip_width, int mip_height) {
+    // Built under the lock, entries of the map stay where they are once made
+    std::lock_guard<std::mutex> lock(mips_mutex);
+
+    std::vector<uint32_t> &mip = mips[{ region.x, region.y, mip_width, mip_height }];
+
+    if (!mip.empty())
+        return mip;
+
+    mip.resize(mip_width * mip_height);
+
+    for (int y = 0; y < mip_height; y++) {
+        int y0 = y * region.h / mip_height;
+        int y1 = std::max(y0 + 1, (y + 1) * region.h / mip_height);
+
+        for (int x = 0; x < mip_width; x++) {
+            int x0 = x * region.w / mip_width;
+            int x1 = std::max(x0 + 1, (x + 1) * region.w / mip_width);
+
+            // Colors are weighted by alpha so that transparent texels don't bleed into the edges
+            uint64_t sums[3] = { 0, 0, 0 };
+            uint64_t sum_alpha = 0;
+
+            for (int sy = y0; sy < y1; sy++)
+                for (int sx = x0; sx < x1; sx++) {
+                    const uint8_t* texel = reinterpret_cast<const uint8_t*>(&pixels[region.x + sx + (region.y + sy) * width]);
+
+                    for (int c = 0; c < 3; c++)
+                        sums[c] += texel[c] * texel[3];
+
+                    sum_alpha += texel[3];
+                }
+
+            uint64_t count = (x1 - x0) * (y1 - y0);
+
+            uint8_t* mip_texel = reinterpret_cast<uint8_t*>(&mip[x + y * mip_width]);
+
+            for (int c = 0; c < 3; c++)
+                mip_texel[c] = sum_alpha > 0 ? (sums[c] + sum_alpha / 2) / sum_alpha : 0;
+
+            mip_texel[3] = (sum_alpha + count / 2) / count;
+        }
+    }
+
+    return mip;
+}
+
+Texture_Data::~Texture_Data() {
+#ifdef SHARED_MEMORY_TEXTURES
+    if (mapping != nullptr) {
+        // The last process using the segment removes it
+        if (static_cast<Shared_Texture_Header*>(mapping)->users.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            unlink_shared(mapping_key, mapping_inode);
+
+        munmap(mapping, mapping_size);
+    }
+#endif
+}
+
+std::shared_ptr<Texture_Data> Texture_Store::get(const std::string &name, SDL_Rect &region) {
+    std::shared_ptr<Texture_Data> data;
+    std::shared_ptr<const Asset_Pack> use_pack;
+    bool use_shared_memory;
+
+    Atlas* atlas = nullptr;
+    int atlas_index = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        // Relative to the working directory, like the asset names
+        if (!pack_opened) {
+            pack = Asset_Pack::open("assets.pack");
+            pack_opened = true;
+        }
+
+        // Atlases are stored like the files
+        auto member = atlas_members.find(name);
+
+        if (member != atlas_members.end()) {
+            atlas = &atlases[member->second.first];
+            atlas_index = member->second.second;
+        }
+
+        std::weak_ptr<Texture_Data> &entry = atlas != nullptr ? atlas->data : textures[name];
+
+        data = entry.lock();
+
+        if (data == nullptr) {
+            data = std::make_shared<Texture_Data>();
+            entry = data;
+        }
+
+        use_pack = pack;
+        use_shared_memory = shared_memory;
+    }
+
+    // Decoded outside of the store lock, threads asking for the same file meanwhile wait here
+    if (atlas != nullptr) {
+        std::call_once(data->loaded, [&] { data->load_atlas(atlas->names, use_pack, use_shared_memory); });
+
+        region = data->regions[atlas_index];
+    }
+    else {
+        std::call_once(data->loaded, [&] { data->load(name, use_pack, use_shared_memory); });
+
+        region = SDL_Rect{ 0, 0, data->width, data->height };
+    }
+
+    return data;
+}
+
+void Texture_Store::add_atlas(const std::vector<std::string> &names) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Each file in one atlas, so adding the same atlas again (for another instance) leaves it as is
+    Atlas atlas;
+
+    for (size_t i = 0; i < names.size(); i++) {
+        if (atlas_members.count(names[i]) == 0) {
+            atlas_members[names[i]] = std::make_pair(static_cast<int>(atlases.size()), static_cast<int>(atlas.names.size()));
+            atlas.names.push_back(names[i]);
+        }
+    }
+
+    if (!atlas.names.empty())
+        atlases.push_back(std::move(atlas));
+}
+
+void Texture_Store::set_shared_memory(bool shared_memory) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    this->shared_memory = shared_memory;
+}
+
+SDL_Texture* create_sdl_texture(SDL_Renderer* renderer, const uint32_t* pixels, int width, int height) {
+    SDL_Surface* surface = SDL_CreateSurfaceFrom(width, height, SDL_PIXELFORMAT_RGBA32, const_cast<uint32_t*>(pixels), width * 4);
+
+    if (surface == nullptr)
+        throw std::runtime_error("Could not create surface!");
+
+    SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
 
     SDL_DestroySurface(surface);
+
+    return texture;
+}
+
+SDL_Texture* Asset_Texture::get_obs_texture() {
+    if (!data->regions.empty())
+        return gr->get_atlas_texture(data, true);
+
+    if (obs_texture == nullptr)
+        obs_texture = create_sdl_texture(gr->obs_renderer, data->pixels, width, height);
+
+    return obs_texture;
+}
+
+SDL_Texture* Asset_Texture::get_window_texture() {
+    if (!data->regions.empty())
+        return gr->get_atlas_texture(data, false);
+
+    if (window_texture == nullptr)
+        window_texture = create_sdl_texture(gr->window_renderer, data->pixels, width, height);
+
+    return window_texture;
+}
+
+void Asset_Texture::load(const std::string &name) {
+    data = store_texture.get(name, region);
+
+    width = region.w;
+    height = region.h;
+
+    id = get_texture_id(name);
+
+    if (table_texture != nullptr)
+        table_texture->add(this);
+}
+
+void Asset_Texture::create(int width, int height) {
+    // Loaded data belongs to the store
+    if (data == nullptr || id != -1) {
+        data = std::make_shared<Texture_Data>();
+        id = -1;
+    }
+
+    data->create(width, height);
+
+    mips.clear();
+
+    region = SDL_Rect{ 0, 0, width, height };
+
+    this->width = width;
+    this->height = height;
+}
+
+uint32_t* Asset_Texture::edit_pixels() {
+    assert(id == -1);
+
+    data->clear_mips();
+    mips.clear();
+
+    return const_cast<uint32_t*>(data->pixels);
+}
+
+const uint32_t* Asset_Texture::add_mip(int mip_width, int mip_height) {
+    const uint32_t* pixels = data->get_mip(region, mip_width, mip_height).data();
+
+    mips.push_back(Mip{ mip_width, mip_height, pixels });
+
+    return pixels;
 }
 
 Asset_Texture::~Asset_Texture() {
@@ -23,4 +635,86 @@ Asset_Texture::~Asset_Texture() {
         SDL_DestroyTexture(obs_texture);
 }
 
-Asset_Manager<Asset_Texture> manager_texture;
+void Texture_Table::add(Asset_Texture* texture) {
+    assert(texture->id >= 0);
+
+    if (texture->id >= static_cast<int>(textures.size()))
+        textures.resize(texture->id + 1, nullptr);
+
+    if (textures[texture->id] == nullptr)
+        textures[texture->id] = texture;
+}
+
+void Texture_Table::remove(Asset_Texture* texture) {
+    if (texture->id >= 0 && texture->id < static_cast<int>(textures.size()) && textures[texture->id] == texture)
+        textures[texture->id] = nullptr;
+}
+
+Asset_Texture* Texture_Table::translate(const Asset_Texture* texture) {
+    if (texture == nullptr)
+        return nullptr;
+
+    // Created rather than loaded from a file, this instance has no counterpart
+    if (texture->id < 0)
+        return nullptr;
+
+    if (texture->id < static_cast<int>(textures.size()) && textures[texture->id] != nullptr)
+        return textures[texture->id];
+
+    // Loaded lazily by the other instance, loading adds it to the table
+    return &manager_texture->get(get_texture_name(texture->id));
+}
+
+void Texture_Set::init(const std::vector<std::string> &names, bool lazy, int max_loaded) {
+    this->names = names;
+    this->max_loaded = max_loaded;
+
+    textures.clear();
+    textures.resize(names.size());
+
+    recently_used.clear();
+
+    if (!lazy && max_loaded <= 0) {
+        for (size_t i = 0; i < names.size(); i++)
+            get(i);
+    }
+}
+
+Asset_Texture &Texture_Set::get(int index) {
+    std::unique_ptr<Asset_Texture> &texture = textures[index];
+
+    if (texture == nullptr) {
+        std::unique_ptr<Asset_Texture> loaded = std::make_unique<Asset_Texture>();
+
+        loaded->load(names[index]); // Left unloaded if this throws
+
+        texture = std::move(loaded);
+
+        if (max_loaded > 0) {
+            recently_used.push_back(index);
+
+            if (static_cast<int>(recently_used.size()) > max_loaded) {
+                std::unique_ptr<Asset_Texture> &dropped = textures[recently_used.front()];
+
+                // Its pixels are freed once no other instance uses the file either
+                if (table_texture != nullptr)
+                    table_texture->remove(dropped.get());
+
+                dropped.reset();
+
+                recently_used.erase(recently_used.begin());
+            }
+        }
+    }
+    else if (max_loaded > 0 && recently_used.back() != index) {
+        recently_used.erase(std::find(recently_used.begin(), recently_used.end(), index));
+        recently_used.push_back(index);
+    }
+
+    return *texture;
+}
+
+Texture_Store store_texture;
+
+thread_local Asset_Manager<Asset_Texture>* manager_texture = nullptr;
+thread_local Texture_Table* table_texture = nullptr;
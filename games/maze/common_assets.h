@@ -2,27 +2,212 @@
 #define COMMON_ASSETS_H
 
 #include "asset_manager.h"
+#include "asset_pack.h"
 
 #include "renderer.h"
 
+#include <array>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+// Decoded pixels of an image file (or of an atlas of files), shared by all textures loaded from the file (in any instance, see Texture_Store).
+// Immutable once loaded, apart from the mip cache
+class Texture_Data {
+    friend class Texture_Store;
+
+private:
+    std::vector<uint32_t> owned_pixels; // Unless mapped from the asset pack or shared memory
+
+    std::shared_ptr<const Asset_Pack> pack; // Keeps packed pixels mapped
+
+    void* mapping = nullptr; // Shared memory segment
+    size_t mapping_size = 0;
+    std::string mapping_key;
+    uint64_t mapping_inode = 0; // Tells the segment apart from a newer one of the same name
+
+    std::once_flag loaded; // See Texture_Store::get
+
+    std::mutex mips_mutex;
+    std::map<std::array<int, 4>, std::vector<uint32_t>> mips; // Box-filtered copies of regions of pixels, by region position and size
+
+    // Shared memory segment of the file (or atlas of num_regions files), false if there is none (or it isn't complete)
+    bool attach_shared(const std::string &key, int num_regions);
+
+    // Make the segment and return its pixels to write, nullptr if it couldn't be made. Other processes attach once finish_shared is called
+    uint32_t* create_shared(const std::string &key, int width, int height, const std::vector<SDL_Rect> &regions);
+    void finish_shared();
+
+public:
+    int width = 0;
+    int height = 0;
+
+    const uint32_t* pixels = nullptr; // RGBA in the byte order of the render targets, for the observation blitter
+
+    std::vector<SDL_Rect> regions; // Of the files packed into an atlas, in the order given to load_atlas. Empty for a single file
+
+    // Map the pixels from the pack if it has the file. Otherwise decode the file, in a shared memory segment (named after the file) if requested,
+    // or attach to the segment if another process already made it
+    void load(const std::string &name, const std::shared_ptr<const Asset_Pack> &pack, bool shared_memory);
+
+    // Load the files like load and pack them into one image, each with a border repeating its edge so that filtered draws don't bleed.
+    // With shared memory the atlas (not the files) gets a segment, named after all of the files
+    void load_atlas(const std::vector<std::string> &names, const std::shared_ptr<const Asset_Pack> &pack, bool shared_memory);
+
+    // Private (unshared) blank pixels, see Asset_Texture::create
+    uint32_t* create(int width, int height);
+    void clear_mips();
+
+    // Pixels of the region box filtered down to the given size, built on first use. Thread safe
+    const std::vector<uint32_t> &get_mip(const SDL_Rect &region, int mip_width, int mip_height);
+
+    ~Texture_Data();
+};
+
+// Decoded textures of the process by file name. Instances hold on to the data of the textures they loaded, which is freed once none does
+class Texture_Store {
+private:
+    struct Atlas {
+        std::vector<std::string> names;
+        std::weak_ptr<Texture_Data> data;
+    };
+
+    std::mutex mutex;
+    std::unordered_map<std::string, std::weak_ptr<Texture_Data>> textures;
+
+    std::deque<Atlas> atlases; // Names stay where they are while atlases are loaded outside of the lock
+    std::unordered_map<std::string, std::pair<int, int>> atlas_members; // Atlas and index in it by file name
+
+    std::shared_ptr<const Asset_Pack> pack; // Opened with the first texture, nullptr if there is none
+    bool pack_opened = false;
+
+    bool shared_memory = false;
 
-class Asset_Texture {
 public:
-    // SDL requires different textures for different renders for some reason
+    // Data holding the file's pixels and where in it they are
+    std::shared_ptr<Texture_Data> get(const std::string &name, SDL_Rect &region);
+
+    // Load the files into one atlas from now on (files of earlier atlases stay in theirs). Meant for the sprites of a game, which are then drawn from one image
+    void add_atlas(const std::vector<std::string> &names);
+
+    // Decode textures into shared memory segments from now on, so that processes on the same machine share a single copy
+    void set_shared_memory(bool shared_memory);
+};
+
+extern Texture_Store store_texture;
+
+class Asset_Texture {
+private:
+    std::shared_ptr<Texture_Data> data;
+    SDL_Rect region{ 0, 0, 0, 0 }; // Of the texture in data
+
+    // Made from the pixels on first use, unless the texture is in an atlas (see Renderer::get_atlas_texture). SDL requires different textures for different renders for some reason
     SDL_Texture* obs_texture = nullptr;
     SDL_Texture* window_texture = nullptr;
 
+    struct Mip {
+        int width;
+        int height;
+        const uint32_t* pixels;
+    };
+
+    // Mips of data drawn before, so that drawing at the same size again skips the lock of Texture_Data::get_mip. Textures belong to one instance
+    std::vector<Mip> mips;
+
+    const uint32_t* add_mip(int mip_width, int mip_height);
+
+public:
     int width = 0;
     int height = 0;
 
+    int id = -1; // Shared by all textures loaded from the same file, in any instance
+
+    // Top left pixel, rows are get_pitch pixels apart
+    const uint32_t* get_pixels() const {
+        return data->pixels + region.x + region.y * data->width;
+    }
+
+    int get_pitch() const {
+        return data->width;
+    }
+
+    // Pixels box filtered down to the given size, built on first use. Rows are mip_width pixels apart
+    const uint32_t* get_mip(int mip_width, int mip_height) {
+        for (const Mip &mip : mips) {
+            if (mip.width == mip_width && mip.height == mip_height)
+                return mip.pixels;
+        }
+
+        return add_mip(mip_width, mip_height);
+    }
+
+    // For SDL draws with the renderers bound to the calling thread (window, rotated).
+    // Textures in an atlas share the atlas' SDL texture, draw get_region of it
+    SDL_Texture* get_obs_texture();
+    SDL_Texture* get_window_texture();
+
+    const SDL_Rect &get_region() const {
+        return region;
+    }
+
     // Required
     void load(const std::string &name);
 
+    // Blank texture of its own (not shared), to draw into through edit_pixels
+    void create(int width, int height);
+
+    // Pixels of a created texture, drops the mips made from the old ones
+    uint32_t* edit_pixels();
+
     ~Asset_Texture();
 };
 
-// Manager for all textures
-extern Asset_Manager<Asset_Texture> manager_texture;
+// SDL texture of pixels (copied), for a renderer
+SDL_Texture* create_sdl_texture(SDL_Renderer* renderer, const uint32_t* pixels, int width, int height);
+
+// Manager for all textures of the environment bound to the calling thread
+extern thread_local Asset_Manager<Asset_Texture>* manager_texture;
+
+// Textures of an environment instance by id, for pointing components copied from another instance at this instance's textures
+class Texture_Table {
+private:
+    std::vector<Asset_Texture*> textures; // First loaded texture per id, nullptr if none
+
+public:
+    void add(Asset_Texture* texture); // Loaded from a file (id >= 0)
+    void remove(Asset_Texture* texture); // Before it is destroyed
+
+    // The texture of this instance loaded from the same file as texture (from any instance), loaded through manager_texture if missing.
+    // nullptr for created textures (see Asset_Texture::create), which belong to one instance
+    Asset_Texture* translate(const Asset_Texture* texture);
+};
+
+// Table of the environment bound to the calling thread, textures add themselves on load
+extern thread_local Texture_Table* table_texture;
+
+// Textures of a list of files of which an episode uses few (backgrounds, themes). Lazy sets load each texture on first use.
+// With a limit, the least recently used textures beyond it are dropped again, so nothing may keep pointers to them
+class Texture_Set {
+private:
+    std::vector<std::string> names;
+    std::vector<std::unique_ptr<Asset_Texture>> textures; // nullptr until loaded
+
+    int max_loaded = 0; // 0 for no limit
+    std::vector<int> recently_used; // Loaded indices, most recent last. Only kept with a limit
+
+public:
+    // Loads all textures right away unless lazy or limited
+    void init(const std::vector<std::string> &names, bool lazy, int max_loaded = 0);
+
+    Asset_Texture &get(int index);
+
+    size_t size() const {
+        return names.size();
+    }
+};
 
 #endif
@@ -3,6 +3,11 @@
 
 #include "ecs.h"
 #include "common_assets.h"
+#include "inline_vector.h"
+
+// Capacities of the inline storage in components
+const int max_animation_frames = 4;
+const int max_particles = 16;
 
 // General
 struct Component_Transform {
@@ -35,7 +40,7 @@ struct Component_Sprite {
 };
 
 struct Component_Animation { // Requires a Component_Sprite as well in order to function
-    std::vector<Asset_Texture*> frames;
+    Inline_Vector<Asset_Texture*, max_animation_frames> frames;
 
     int frame_index = 0;
     float rate = 0.1f;
@@ -66,7 +71,7 @@ struct Particle {
 };
 
 struct Component_Particles {
-    std::vector<Particle> particles;
+    Inline_Vector<Particle, max_particles> particles;
 
     Vector2 offset{ 0.0f, 0.0f };
     float lifespan = 5.0f;
@@ -74,4 +79,17 @@ struct Component_Particles {
     float spawn_time = 0.5f;
 };
 
+// Component types of the game, in signature bit order
+struct Component_List : Type_List<
+    Component_Transform,
+    Component_Collision,
+    Component_Dynamics,
+    Component_Sprite,
+    Component_Animation,
+    Component_Hazard,
+    Component_Goal,
+    Component_Agent,
+    Component_Particles
+> {};
+
 #endif
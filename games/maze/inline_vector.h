@@ -0,0 +1,82 @@
+#pragma once
+
+#include <array>
+#include <assert.h>
+
+// Vector with a fixed capacity stored in place. Never allocates, and is trivially copyable if T is, so components can hold one
+template<typename T, int N>
+class Inline_Vector {
+private:
+    std::array<T, N> elements{}; // Value initialized, as std::vector does for new elements
+    int count = 0;
+
+public:
+    Inline_Vector() = default;
+
+    explicit Inline_Vector(int count)
+    : count(count)
+    {
+        assert(count >= 0 && count <= N);
+    }
+
+    int size() const {
+        return count;
+    }
+
+    static constexpr int capacity() {
+        return N;
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+
+    void resize(int new_count) {
+        assert(new_count >= 0 && new_count <= N);
+
+        // Reset removed elements so that a later resize gives fresh ones
+        for (int i = new_count; i < count; i++)
+            elements[i] = T{};
+
+        count = new_count;
+    }
+
+    void push_back(const T &element) {
+        assert(count < N);
+
+        elements[count] = element;
+        count++;
+    }
+
+    void clear() {
+        resize(0);
+    }
+
+    T &operator[](int index) {
+        assert(index >= 0 && index < count);
+
+        return elements[index];
+    }
+
+    const T &operator[](int index) const {
+        assert(index >= 0 && index < count);
+
+        return elements[index];
+    }
+
+    T* begin() {
+        return elements.data();
+    }
+
+    T* end() {
+        return elements.data() + count;
+    }
+
+    const T* begin() const {
+        return elements.data();
+    }
+
+    const T* end() const {
+        return elements.data() + count;
+    }
+};
@@ -0,0 +1,68 @@
+#include "tile_layer.h"
+
+#include <cstring>
+
+void Tile_Layer::bake_tile(int x, int y, const Tile_Texture_Func &get_texture) {
+    // Pixel span of the tile in the layer
+    int x0 = std::lround((x + margin) * tile_size);
+    int y0 = std::lround((y + margin) * tile_size);
+    int x1 = std::lround((x + margin + 1) * tile_size);
+    int y1 = std::lround((y + margin + 1) * tile_size);
+
+    if (x0 < 0 || y0 < 0 || x1 > texture.width || y1 > texture.height || x0 >= x1 || y0 >= y1)
+        return;
+
+    Asset_Texture* tile = get_texture(x, y);
+
+    // Tiles are square and don't overlap, so they are copied (not blended) at the span size
+    const uint32_t* pixels = nullptr;
+    int pitch = x1 - x0;
+
+    if (tile != nullptr) {
+        if (tile->width == x1 - x0 && tile->height == y1 - y0) {
+            pixels = tile->get_pixels();
+            pitch = tile->get_pitch();
+        }
+        else
+            pixels = tile->get_mip(x1 - x0, y1 - y0);
+    }
+
+    uint32_t* layer_pixels = texture.edit_pixels();
+
+    for (int py = y0; py < y1; py++) {
+        uint32_t* row = &layer_pixels[x0 + py * texture.width];
+
+        if (pixels == nullptr)
+            std::fill(row, row + (x1 - x0), 0);
+        else
+            memcpy(row, pixels + (py - y0) * pitch, (x1 - x0) * sizeof(uint32_t));
+    }
+}
+
+void Tile_Layer::render(int map_width, int map_height, const Tile_Texture_Func &get_texture) {
+    float current_tile_size = unit_to_pixels * gr->camera_scale;
+
+    if (current_tile_size != tile_size) {
+        tile_size = current_tile_size;
+
+        // Enough to cover the camera when centered on an edge tile
+        margin = std::ceil(gr->camera_size.x * 0.5f / tile_size) + 1;
+
+        texture.create(std::lround((map_width + 2 * margin) * tile_size), std::lround((map_height + 2 * margin) * tile_size));
+
+        for (int y = -margin; y < map_height + margin; y++)
+            for (int x = -margin; x < map_width + margin; x++)
+                bake_tile(x, y, get_texture);
+
+        dirty_tiles.clear();
+    }
+    else if (!dirty_tiles.empty()) {
+        for (size_t i = 0; i < dirty_tiles.size(); i++)
+            bake_tile(dirty_tiles[i].first, dirty_tiles[i].second, get_texture);
+
+        dirty_tiles.clear();
+    }
+
+    // 1 layer pixel per screen pixel
+    gr->render_texture(&texture, Vector2{ -margin * unit_to_pixels, -margin * unit_to_pixels }, 1.0f / gr->camera_scale);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "common_assets.h"
+#include "helpers.h"
+
+#include <functional>
+#include <vector>
+
+// Tilemap pre-rendered into a single texture at the observation tile size, so that a frame draws the whole map with one clipped blit.
+// Includes a margin of out-of-bounds tiles around the map, since the camera isn't clamped to it.
+// Baked on first use, re-baked fully after invalidate() (new map or theme) or per tile after invalidate(x, y)
+class Tile_Layer {
+public:
+    // Texture of the tile at render coordinates (x, y), drawn at (x, y) * unit_to_pixels, or nullptr if empty
+    typedef std::function<Asset_Texture*(int, int)> Tile_Texture_Func;
+
+private:
+    Asset_Texture texture;
+
+    float tile_size = 0.0f; // Pixels per tile the layer was baked at, 0 if it needs a full bake
+    int margin = 0; // Tiles baked beyond each side of the map
+    std::vector<std::pair<int, int>> dirty_tiles;
+
+    void bake_tile(int x, int y, const Tile_Texture_Func &get_texture);
+
+public:
+    void invalidate() {
+        tile_size = 0.0f;
+        dirty_tiles.clear();
+    }
+
+    // Render coordinates
+    void invalidate(int x, int y) {
+        if (tile_size != 0.0f)
+            dirty_tiles.push_back(std::make_pair(x, y));
+    }
+
+    // Bake as needed and draw. Observations only, the window is too large to keep baked
+    void render(int map_width, int map_height, const Tile_Texture_Func &get_texture);
+};
@@ -12,7 +12,7 @@ void System_Tilemap::init() {
     id_to_textures[wall].load("assets/kenney/Ground/Sand/sandCenter.png");
 
     // Pre-load
-    manager_texture.get("assets/misc_assets/cheese.png");
+    manager_texture->get("assets/misc_assets/cheese.png");
 }
 
 // Tile manipulation
@@ -29,6 +29,8 @@ void System_Tilemap::set_area_with_top(int x, int y, int width, int height, Tile
 
 // Main map generation
 void System_Tilemap::regenerate(std::mt19937 &rng, const Config &cfg) {
+    layer.invalidate();
+
     int world_dim;
     int visibility;
 
@@ -87,30 +89,45 @@ void System_Tilemap::regenerate(std::mt19937 &rng, const Config &cfg) {
     }
 
     // Spawn the goal
-    Entity goal = c.create_entity();
+    Entity goal = c->create_entity();
 
     Vector2 pos = { static_cast<float>(goal_x) + 0.5f, static_cast<float>(map_height - 1 - goal_y) + 0.5f };
 
-    c.add_component(goal, Component_Transform{ .position{ pos } });
-    c.add_component(goal, Component_Sprite{ .position{ -0.48f, -0.5f }, .scale = 0.95f, .z = 1.0f, .texture = &manager_texture.get("assets/misc_assets/cheese.png") });
-    c.add_component(goal, Component_Goal{});
-    c.add_component(goal, Component_Collision{ .bounds{ -0.5f, -0.5f, 1.0f, 1.0f }});
+    c->add_component(goal, Component_Transform{ .position{ pos } });
+    c->add_component(goal, Component_Sprite{ .position{ -0.48f, -0.5f }, .scale = 0.95f, .z = 1.0f, .texture = &manager_texture->get("assets/misc_assets/cheese.png") });
+    c->add_component(goal, Component_Goal{});
+    c->add_component(goal, Component_Collision{ .bounds{ -0.5f, -0.5f, 1.0f, 1.0f }});
 
     agent_start_x = margin;
     agent_start_y = margin;
     Vector2 agent_pos{ static_cast<float>(agent_start_x) + 0.5f, static_cast<float>(main_height - 1 - agent_start_y) + 0.5f };
 
     // Spawn the player (agent)
-    Entity agent = c.create_entity();
+    Entity agent = c->create_entity();
+
+    c->add_component(agent, Component_Transform{ .position = agent_pos });
+    c->add_component(agent, Component_Collision{ .bounds{ -0.5f, -0.5f, 1.0f, 1.0f } });
+    c->add_component(agent, Component_Agent{});
+}
+
+Asset_Texture* System_Tilemap::get_tile_texture(int x, int y) {
+    Tile_ID id = get(x, map_height - 1 - y);
 
-    c.add_component(agent, Component_Transform{ .position = agent_pos });
-    c.add_component(agent, Component_Collision{ .bounds{ -0.5f, -0.5f, 1.0f, 1.0f } });
-    c.add_component(agent, Component_Agent{});
+    if (id == empty)
+        return nullptr;
+
+    return &id_to_textures[id];
 }
 
 void System_Tilemap::render() {
-    Rectangle camera_aabb{ (gr.camera_position.x - gr.camera_size.x * 0.5f / gr.camera_scale) * pixels_to_unit, (gr.camera_position.y - gr.camera_size.y * 0.5f / gr.camera_scale) * pixels_to_unit,
-        gr.camera_size.x * pixels_to_unit / gr.camera_scale, gr.camera_size.y * pixels_to_unit / gr.camera_scale };
+    if (gr->rendering_obs) {
+        layer.render(map_width, map_height, [&](int x, int y) { return get_tile_texture(x, y); });
+
+        return;
+    }
+
+    Rectangle camera_aabb{ (gr->camera_position.x - gr->camera_size.x * 0.5f / gr->camera_scale) * pixels_to_unit, (gr->camera_position.y - gr->camera_size.y * 0.5f / gr->camera_scale) * pixels_to_unit,
+        gr->camera_size.x * pixels_to_unit / gr->camera_scale, gr->camera_size.y * pixels_to_unit / gr->camera_scale };
 
     int lower_x = std::floor(camera_aabb.x);
     int lower_y = std::floor(camera_aabb.y);
@@ -119,18 +136,16 @@ void System_Tilemap::render() {
 
     for (int y = lower_y; y <= upper_y; y++)
         for (int x = lower_x; x <= upper_x; x++) {
-            Tile_ID id = get(x, map_height - 1 - y);
+            Asset_Texture* tex = get_tile_texture(x, y);
 
-            if (id == empty)
+            if (tex == nullptr)
                 continue;
 
-            Asset_Texture* tex = &id_to_textures[id];
-
-            gr.render_texture(tex, (Vector2){ x * unit_to_pixels, y * unit_to_pixels }, unit_to_pixels / tex->width);
+            gr->render_texture(tex, (Vector2){ x * unit_to_pixels, y * unit_to_pixels }, unit_to_pixels / tex->width);
         }
 }
 
-std::pair<Vector2, bool> System_Tilemap::get_collision(Rectangle rectangle, const std::function<Collision_Type(Tile_ID)> &collision_id_func, bool fallthrough, float step_y) {
+std::pair<Vector2, bool> System_Tilemap::get_collision(Rectangle rectangle, const Collision_Mask &collision_mask, bool fallthrough, float step_y) {
     bool collided = false;
 
     int lower_x = std::floor(rectangle.x);
@@ -148,7 +163,7 @@ std::pair<Vector2, bool> System_Tilemap::get_collision(Rectangle rectangle, cons
         for (int x = lower_x; x <= upper_x; x++) {
             Tile_ID id = get(x, map_height - 1 - y);
 
-            Collision_Type type = collision_id_func(id);
+            Collision_Type type = collision_mask[id];
 
             if (type != none) {
                 tile.x = x;
@@ -171,7 +186,7 @@ std::pair<Vector2, bool> System_Tilemap::get_collision(Rectangle rectangle, cons
         for (int x = lower_x; x <= upper_x; x++) {
             Tile_ID id = get(x, map_height - 1 - y);
 
-            Collision_Type type = collision_id_func(id);
+            Collision_Type type = collision_mask[id];
 
             if (type != none) {
                 tile.x = x;
@@ -192,3 +207,48 @@ std::pair<Vector2, bool> System_Tilemap::get_collision(Rectangle rectangle, cons
 
     return std::make_pair(Vector2{ rectangle.x, rectangle.y }, collided);
 }
+
+void System_Tilemap::save_state(State_Writer &writer) const {
+    writer.write(map_width);
+    writer.write(map_height);
+    writer.write(tile_ids);
+}
+
+void System_Tilemap::load_state(State_Reader &reader) {
+    int loaded_width = -1, loaded_height = -1;
+
+    reader.read(loaded_width);
+    reader.read(loaded_height);
+
+    // Map size is fixed per instance
+    if (loaded_width != map_width || loaded_height != map_height) {
+        reader.fail();
+
+        return;
+    }
+
+    loaded_tile_ids.resize(tile_ids.size());
+
+    reader.read(loaded_tile_ids);
+
+    if (reader.failed())
+        return;
+
+    set_tiles(loaded_tile_ids);
+}
+
+void System_Tilemap::copy_state(const System &other) {
+    const System_Tilemap &other_tilemap = static_cast<const System_Tilemap&>(other);
+
+    // Map size is fixed per instance, cenv_clone checks that it matches
+    assert(other_tilemap.map_width == map_width && other_tilemap.map_height == map_height);
+
+    set_tiles(other_tilemap.tile_ids);
+}
+
+void System_Tilemap::set_tiles(const std::vector<Tile_ID> &ids) {
+    for (int i = 0; i < static_cast<int>(tile_ids.size()); i++) {
+        if (ids[i] != tile_ids[i])
+            set(i / map_height, i % map_height, ids[i]);
+    }
+}
@@ -0,0 +1,147 @@
+// Decodes every PNG under a directory into an asset pack (see asset_pack.h).
+// Usage: AssetPack <assets directory> <output file>, run from the directory the games run in so that the names match
+
+#include <SDL3/SDL.h>
+#include <SDL3/SDL_image.h>
+
+#include "asset_pack.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct Packed_Texture {
+    std::string name;
+    int width;
+    int height;
+    int64_t source_size;
+    int64_t source_mtime;
+    std::vector<uint32_t> pixels;
+};
+
+uint64_t align(uint64_t offset) {
+    return (offset + asset_pack_alignment - 1) / asset_pack_alignment * asset_pack_alignment;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " <assets directory> <output file>" << std::endl;
+
+        return 1;
+    }
+
+    std::vector<std::string> names;
+
+    for (const auto &file : std::filesystem::recursive_directory_iterator(argv[1])) {
+        if (file.is_regular_file() && file.path().extension() == ".png")
+            names.push_back(file.path().generic_string());
+    }
+
+    // Same pack for the same assets
+    std::sort(names.begin(), names.end());
+
+    std::vector<Packed_Texture> textures;
+
+    for (const std::string &name : names) {
+        Packed_Texture texture;
+
+        texture.name = name;
+
+        if (!get_asset_source_info(name, texture.source_size, texture.source_mtime))
+            continue;
+
+        // Decoded like Texture_Data::load does
+        SDL_Surface* surface = IMG_Load(name.c_str());
+
+        if (surface == nullptr) {
+            std::cerr << "Skipping \"" << name << "\", could not load it" << std::endl;
+
+            continue;
+        }
+
+        SDL_Surface* converted = SDL_ConvertSurface(surface, SDL_PIXELFORMAT_RGBA32);
+
+        SDL_DestroySurface(surface);
+
+        if (converted == nullptr) {
+            std::cerr << "Skipping \"" << name << "\", could not convert it" << std::endl;
+
+            continue;
+        }
+
+        texture.width = converted->w;
+        texture.height = converted->h;
+        texture.pixels.resize(texture.width * texture.height);
+
+        for (int y = 0; y < texture.height; y++)
+            memcpy(&texture.pixels[y * texture.width], static_cast<uint8_t*>(converted->pixels) + y * converted->pitch, texture.width * 4);
+
+        SDL_DestroySurface(converted);
+
+        textures.push_back(std::move(texture));
+    }
+
+    // Lay out the file
+    Asset_Pack_Header header{ asset_pack_magic, asset_pack_version, static_cast<uint32_t>(textures.size()), 0 };
+
+    std::vector<Asset_Pack_Entry> entries(textures.size());
+
+    uint64_t offset = sizeof(Asset_Pack_Header) + entries.size() * sizeof(Asset_Pack_Entry);
+
+    for (size_t i = 0; i < textures.size(); i++) {
+        entries[i].name_offset = offset;
+        entries[i].name_size = textures[i].name.size();
+
+        offset += textures[i].name.size();
+    }
+
+    for (size_t i = 0; i < textures.size(); i++) {
+        offset = align(offset);
+
+        entries[i].width = textures[i].width;
+        entries[i].height = textures[i].height;
+        entries[i].reserved = 0;
+        entries[i].pixels_offset = offset;
+        entries[i].source_size = textures[i].source_size;
+        entries[i].source_mtime = textures[i].source_mtime;
+
+        offset += textures[i].pixels.size() * sizeof(uint32_t);
+    }
+
+    // Written next to the output and moved over it, so that running games keep their mapping of the old pack
+    std::string temp_path = std::string(argv[2]) + ".tmp";
+
+    std::ofstream file(temp_path, std::ios::binary);
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(Asset_Pack_Entry));
+
+    for (const Packed_Texture &texture : textures)
+        file.write(texture.name.data(), texture.name.size());
+
+    for (size_t i = 0; i < textures.size(); i++) {
+        std::vector<char> padding(entries[i].pixels_offset - file.tellp(), 0);
+
+        file.write(padding.data(), padding.size());
+        file.write(reinterpret_cast<const char*>(textures[i].pixels.data()), textures[i].pixels.size() * sizeof(uint32_t));
+    }
+
+    file.close();
+
+    if (!file || std::rename(temp_path.c_str(), argv[2]) != 0) {
+        std::cerr << "Could not write \"" << argv[2] << "\"!" << std::endl;
+
+        std::remove(temp_path.c_str());
+
+        return 1;
+    }
+
+    std::cout << "Packed " << textures.size() << " textures into \"" << argv[2] << "\" (" << offset / (1024 * 1024) << " MB)" << std::endl;
+
+    return 0;
+}